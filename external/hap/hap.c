@@ -78,14 +78,36 @@
 /*
  To decode we use a struct to store details of each chunk
  */
-typedef struct HapChunkDecodeInfo {
+struct HapChunkDecodeInfo {
     unsigned int result;
     unsigned int compressor;
     const char *compressed_chunk_data;
     size_t compressed_chunk_size;
     char *uncompressed_chunk_data;
     size_t uncompressed_chunk_size;
-} HapChunkDecodeInfo;
+    size_t uncompressed_chunk_offset;
+};
+
+/*
+ When chunks are passed to a HapDecodeChunkFunction rather than decompressed in place
+ */
+typedef struct HapChunkStreamInfo {
+    HapChunkDecodeInfo *chunks;
+    HapDecodeChunkFunction function;
+    void *info;
+} HapChunkStreamInfo;
+
+/*
+ To encode we use a struct to store details of each chunk
+ */
+typedef struct HapChunkEncodeInfo {
+    unsigned int result;
+    unsigned int compressor;
+    const char *uncompressed_chunk_data;
+    size_t uncompressed_chunk_size;
+    char *compressed_chunk_data;
+    size_t compressed_chunk_size;
+} HapChunkEncodeInfo;
 
 // TODO: rename the defines we use for codes used in stored frames
 // to better differentiate them from the enums used for the API
@@ -238,7 +260,7 @@ static unsigned int hap_texture_format_identifier_for_format_constant(unsigned i
 
 // Returns the length of a decode instructions container of chunk_count chunks
 // not including the section header
-static size_t hap_decode_instructions_length(unsigned int chunk_count)
+static size_t hap_decode_instructions_length(unsigned int chunk_count, unsigned int options)
 {
     /*
      Calculate the size of our Decode Instructions Section
@@ -247,16 +269,24 @@ static size_t hap_decode_instructions_length(unsigned int chunk_count)
      */
     size_t length = (5 * chunk_count) + 8;
 
+    if (options & HapEncodeOptionChunkOffsetTable)
+    {
+        // + Chunk Offset Table + its header
+        length += (4 * chunk_count) + 4;
+    }
+
     return length;
 }
 
-static unsigned int hap_limited_chunk_count_for_frame(size_t input_bytes, unsigned int texture_format, unsigned int chunk_count)
+static unsigned int hap_limited_chunk_count_for_frame(size_t input_bytes, unsigned int texture_format, unsigned int chunk_count, unsigned int options)
 {
     // This is a hard limit due to the 4-byte headers we use for the decode instruction container
-    // (0xFFFFFF == count + (4 x count) + 20)
-    if (chunk_count > 3355431)
+    // (0xFFFFFF == count + (4 x count) + 20, or with a Chunk Offset Table the decode instructions
+    // length, (9 x count) + 12, from hap_decode_instructions_length())
+    unsigned int max_chunk_count = (options & HapEncodeOptionChunkOffsetTable) ? 1864133 : 3355431;
+    if (chunk_count > max_chunk_count)
     {
-        chunk_count = 3355431;
+        chunk_count = max_chunk_count;
     }
     // Divide frame equally on DXT block boundries (8 or 16 bytes)
     unsigned long dxt_block_count;
@@ -275,13 +305,13 @@ static unsigned int hap_limited_chunk_count_for_frame(size_t input_bytes, unsign
     return chunk_count;
 }
 
-static size_t hap_max_encoded_length(size_t input_bytes, unsigned int texture_format, unsigned int compressor, unsigned int chunk_count)
+static size_t hap_max_encoded_length(size_t input_bytes, unsigned int texture_format, unsigned int compressor, unsigned int chunk_count, unsigned int options)
 {
     size_t decode_instructions_length, max_compressed_length;
 
-    chunk_count = hap_limited_chunk_count_for_frame(input_bytes, texture_format, chunk_count);
+    chunk_count = hap_limited_chunk_count_for_frame(input_bytes, texture_format, chunk_count, options);
 
-    decode_instructions_length = hap_decode_instructions_length(chunk_count);
+    decode_instructions_length = hap_decode_instructions_length(chunk_count, options);
 
     if (compressor == HapCompressorSnappy)
     {
@@ -311,16 +341,53 @@ unsigned long HapMaxEncodedLength(unsigned int count,
     }
 
     for (unsigned int i = 0; i < count; i++) {
-        // Assume snappy, the worst case
-        total_length += hap_max_encoded_length(inputBytes[i], textureFormats[i], HapCompressorSnappy, chunkCounts[i]);
+        // Assume snappy and a Chunk Offset Table, the worst case
+        total_length += hap_max_encoded_length(inputBytes[i], textureFormats[i], HapCompressorSnappy, chunkCounts[i], HapEncodeOptionChunkOffsetTable);
     }
 
     return total_length;
 }
 
+/*
+ On entry compressed_chunk_size is the space available at compressed_chunk_data, on return it is the stored length
+ */
+static void hap_encode_chunk(HapChunkEncodeInfo chunks[], unsigned int index)
+{
+    if (chunks)
+    {
+        snappy_status snappy_result = snappy_compress(chunks[index].uncompressed_chunk_data,
+                                                      chunks[index].uncompressed_chunk_size,
+                                                      chunks[index].compressed_chunk_data,
+                                                      &chunks[index].compressed_chunk_size);
+        if (snappy_result != SNAPPY_OK)
+        {
+            chunks[index].result = HapResult_Internal_Error;
+        }
+        else
+        {
+            if (chunks[index].compressed_chunk_size >= chunks[index].uncompressed_chunk_size)
+            {
+                // store the chunk uncompressed
+                memcpy(chunks[index].compressed_chunk_data,
+                       chunks[index].uncompressed_chunk_data,
+                       chunks[index].uncompressed_chunk_size);
+                chunks[index].compressed_chunk_size = chunks[index].uncompressed_chunk_size;
+                chunks[index].compressor = kHapCompressorNone;
+            }
+            else
+            {
+                // ie we used snappy and saved some space
+                chunks[index].compressor = kHapCompressorSnappy;
+            }
+            chunks[index].result = HapResult_No_Error;
+        }
+    }
+}
+
 static unsigned int hap_encode_texture(const void *inputBuffer, unsigned long inputBufferBytes, unsigned int textureFormat,
-                                       unsigned int compressor, unsigned int chunkCount, void *outputBuffer,
-                                       unsigned long outputBufferBytes, unsigned long *outputBufferBytesUsed)
+                                       unsigned int compressor, unsigned int chunkCount, unsigned int options,
+                                       HapEncodeCallback callback, void *info,
+                                       void *outputBuffer, unsigned long outputBufferBytes, unsigned long *outputBufferBytesUsed)
 {
     size_t top_section_header_length;
     size_t top_section_length;
@@ -346,7 +413,7 @@ static unsigned int hap_encode_texture(const void *inputBuffer, unsigned long in
     {
         return HapResult_Bad_Arguments;
     }
-    else if (outputBufferBytes < hap_max_encoded_length(inputBufferBytes, textureFormat, compressor, chunkCount))
+    else if (outputBufferBytes < hap_max_encoded_length(inputBufferBytes, textureFormat, compressor, chunkCount, options))
     {
         return HapResult_Buffer_Too_Small;
     }
@@ -378,11 +445,14 @@ static unsigned int hap_encode_texture(const void *inputBuffer, unsigned long in
         size_t chunk_size, compress_buffer_remaining;
         uint8_t *second_stage_compressor_table;
         void *chunk_size_table;
+        void *chunk_offset_table = NULL;
         char *compressed_data;
+        HapChunkEncodeInfo *chunk_info;
+        unsigned int result = HapResult_No_Error;
         unsigned int i;
 
-        chunkCount = hap_limited_chunk_count_for_frame(inputBufferBytes, textureFormat, chunkCount);
-        decode_instructions_length = hap_decode_instructions_length(chunkCount);
+        chunkCount = hap_limited_chunk_count_for_frame(inputBufferBytes, textureFormat, chunkCount, options);
+        decode_instructions_length = hap_decode_instructions_length(chunkCount, options);
 
         // Check we have space for the Decode Instructions Container
         if ((inputBufferBytes + decode_instructions_length + 4) > kHapUInt24Max)
@@ -401,6 +471,12 @@ static unsigned int hap_encode_texture(const void *inputBuffer, unsigned long in
         hap_write_section_header(((uint8_t *)outputBuffer) + top_section_header_length + 4U, 4U, chunkCount, kHapSectionChunkSecondStageCompressorTable);
         // write the Chunk Size Table section header
         hap_write_section_header(((uint8_t *)outputBuffer) + top_section_header_length + 4U + 4U + chunkCount, 4U, chunkCount * 4U, kHapSectionChunkSizeTable);
+        if (options & HapEncodeOptionChunkOffsetTable)
+        {
+            // write the Chunk Offset Table section header, so decoders can find any chunk without summing the sizes before it
+            chunk_offset_table = ((uint8_t *)chunk_size_table) + (chunkCount * 4U) + 4U;
+            hap_write_section_header(((uint8_t *)chunk_offset_table) - 4U, 4U, chunkCount * 4U, kHapSectionChunkOffsetTable);
+        }
 
         compressed_data = (char *)(((uint8_t *)outputBuffer) + top_section_header_length + 4 + decode_instructions_length);
 
@@ -408,34 +484,79 @@ static unsigned int hap_encode_texture(const void *inputBuffer, unsigned long in
 
         top_section_length = 4 + decode_instructions_length;
 
+        chunk_info = (HapChunkEncodeInfo *)malloc(sizeof(HapChunkEncodeInfo) * chunkCount);
+        if (chunk_info == NULL)
+        {
+            return HapResult_Internal_Error;
+        }
+
         for (i = 0; i < chunkCount; i++) {
-            size_t chunk_packed_length = compress_buffer_remaining;
-            const char *chunk_input_start = (const char *)(((uint8_t *)inputBuffer) + (chunk_size * i));
-            if (compressor == HapCompressorSnappy)
-            {
-                snappy_status result = snappy_compress(chunk_input_start, chunk_size, (char *)compressed_data, &chunk_packed_length);
-                if (result != SNAPPY_OK)
+            chunk_info[i].uncompressed_chunk_data = (const char *)(((uint8_t *)inputBuffer) + (chunk_size * i));
+            chunk_info[i].uncompressed_chunk_size = chunk_size;
+        }
+
+        if (callback == NULL || chunkCount == 1)
+        {
+            // Compress each chunk straight to its final position
+            for (i = 0; i < chunkCount && result == HapResult_No_Error; i++) {
+                chunk_info[i].compressed_chunk_data = compressed_data;
+                chunk_info[i].compressed_chunk_size = compress_buffer_remaining;
+                hap_encode_chunk(chunk_info, i);
+                result = chunk_info[i].result;
+                if (result == HapResult_No_Error)
                 {
-                    return HapResult_Internal_Error;
+                    compressed_data += chunk_info[i].compressed_chunk_size;
+                    compress_buffer_remaining -= chunk_info[i].compressed_chunk_size;
                 }
             }
+        }
+        else
+        {
+            /*
+             Compress each chunk into its own worst-case sized slot in the output buffer, then close the gaps between them.
+             hap_max_encoded_length() allows for this layout.
+             */
+            size_t slot_size = snappy_max_compressed_length(chunk_size);
+            for (i = 0; i < chunkCount; i++) {
+                chunk_info[i].compressed_chunk_data = compressed_data + (slot_size * i);
+                chunk_info[i].compressed_chunk_size = slot_size;
+            }
 
-            if (compressor == HapCompressorNone || chunk_packed_length >= chunk_size)
-            {
-                // store the chunk uncompressed
-                memcpy(compressed_data, chunk_input_start, chunk_size);
-                chunk_packed_length = chunk_size;
-                second_stage_compressor_table[i] = kHapCompressorNone;
+            callback((HapEncodeWorkFunction)hap_encode_chunk, chunk_info, chunkCount, info);
+
+            for (i = 0; i < chunkCount && result == HapResult_No_Error; i++) {
+                result = chunk_info[i].result;
+                if (result == HapResult_No_Error)
+                {
+                    if (chunk_info[i].compressed_chunk_data != compressed_data)
+                    {
+                        memmove(compressed_data, chunk_info[i].compressed_chunk_data, chunk_info[i].compressed_chunk_size);
+                    }
+                    compressed_data += chunk_info[i].compressed_chunk_size;
+                }
             }
-            else
-            {
-                // ie we used snappy and saved some space
-                second_stage_compressor_table[i] = kHapCompressorSnappy;
+        }
+
+        if (result == HapResult_No_Error)
+        {
+            size_t chunk_offset = 0;
+            for (i = 0; i < chunkCount; i++) {
+                second_stage_compressor_table[i] = chunk_info[i].compressor;
+                hap_write_4_byte_uint(((uint8_t *)chunk_size_table) + (i * 4), chunk_info[i].compressed_chunk_size);
+                if (chunk_offset_table)
+                {
+                    hap_write_4_byte_uint(((uint8_t *)chunk_offset_table) + (i * 4), chunk_offset);
+                }
+                chunk_offset += chunk_info[i].compressed_chunk_size;
+                top_section_length += chunk_info[i].compressed_chunk_size;
             }
-            hap_write_4_byte_uint(((uint8_t *)chunk_size_table) + (i * 4), chunk_packed_length);
-            compressed_data += chunk_packed_length;
-            top_section_length += chunk_packed_length;
-            compress_buffer_remaining -= chunk_packed_length;
+        }
+
+        free(chunk_info);
+
+        if (result != HapResult_No_Error)
+        {
+            return result;
         }
 
         if (top_section_length < inputBufferBytes + top_section_header_length)
@@ -473,6 +594,30 @@ unsigned int HapEncode(unsigned int count,
                        unsigned int *chunkCounts,
                        void *outputBuffer, unsigned long outputBufferBytes,
                        unsigned long *outputBufferBytesUsed)
+{
+    return HapEncodeWithOptions(count,
+                                inputBuffers,
+                                inputBuffersBytes,
+                                textureFormats,
+                                compressors,
+                                chunkCounts,
+                                HapEncodeOptionNone,
+                                NULL,
+                                NULL,
+                                outputBuffer,
+                                outputBufferBytes,
+                                outputBufferBytesUsed);
+}
+
+unsigned int HapEncodeWithOptions(unsigned int count,
+                                  const void **inputBuffers, unsigned long *inputBuffersBytes,
+                                  unsigned int *textureFormats,
+                                  unsigned int *compressors,
+                                  unsigned int *chunkCounts,
+                                  unsigned int options,
+                                  HapEncodeCallback callback, void *info,
+                                  void *outputBuffer, unsigned long outputBufferBytes,
+                                  unsigned long *outputBufferBytesUsed)
 {
     size_t top_section_header_length;
     size_t top_section_length;
@@ -499,6 +644,9 @@ unsigned int HapEncode(unsigned int count,
                                   textureFormats[0],
                                   compressors[0],
                                   chunkCounts[0],
+                                  options,
+                                  callback,
+                                  info,
                                   outputBuffer,
                                   outputBufferBytes,
                                   outputBufferBytesUsed);
@@ -518,7 +666,7 @@ unsigned int HapEncode(unsigned int count,
         top_section_length = 0;
         for (unsigned int i = 0; i < count; i++)
         {
-            top_section_length += inputBuffersBytes[i] + hap_decode_instructions_length(chunkCounts[i]) + 4;
+            top_section_length += inputBuffersBytes[i] + hap_decode_instructions_length(chunkCounts[i], options) + 4;
         }
 
         if (top_section_length > kHapUInt24Max)
@@ -540,6 +688,9 @@ unsigned int HapEncode(unsigned int count,
                                                      textureFormats[i],
                                                      compressors[i],
                                                      chunkCounts[i],
+                                                     options,
+                                                     callback,
+                                                     info,
                                                      section,
                                                      outputBufferBytes - (top_section_header_length + top_section_length),
                                                      &section_length);
@@ -596,35 +747,37 @@ static void hap_decode_chunk(HapChunkDecodeInfo chunks[], unsigned int index)
     }
 }
 
-unsigned int hap_decode_single_texture(const void *texture_section, uint32_t texture_section_length,
-                                       unsigned int texture_section_type,
-                                       HapDecodeCallback callback, void *info,
-                                       void *outputBuffer, unsigned long outputBufferBytes,
-                                       unsigned long *outputBufferBytesUsed,
-                                       unsigned int *outputBufferTextureFormat)
+static void hap_stream_chunk(HapChunkStreamInfo *stream, unsigned int index)
 {
-    int result = HapResult_No_Error;
-    unsigned int textureFormat;
-    unsigned int compressor;
-    size_t bytesUsed = 0;
+    HapChunkDecodeInfo *chunk = &stream->chunks[index];
+    chunk->result = stream->function(stream->info, chunk, chunk->uncompressed_chunk_offset, chunk->uncompressed_chunk_size);
+}
 
+/*
+ Fills out texture from a texture section, walking its Decode Instructions Container if it has one
+ */
+static unsigned int hap_parse_texture(const void *texture_section, uint32_t texture_section_length,
+                                      unsigned int texture_section_type,
+                                      HapTexture *texture)
+{
     /*
      One top-level section type describes texture-format and second-stage compression
      Hap compressor/format constants can be unpacked by reading the top and bottom four bits.
      */
-    compressor = hap_top_4_bits(texture_section_type);
-    textureFormat = hap_bottom_4_bits(texture_section_type);
-
-    /*
-     Pass the texture format out
-     */
-    *outputBufferTextureFormat = hap_texture_format_constant_for_format_identifier(textureFormat);
-    if (*outputBufferTextureFormat == 0)
+    texture->compressor = hap_top_4_bits(texture_section_type);
+    texture->textureFormat = hap_texture_format_constant_for_format_identifier(hap_bottom_4_bits(texture_section_type));
+    texture->chunkCompressors = NULL;
+    texture->chunkSizes = NULL;
+    texture->chunkOffsets = NULL;
+    texture->data = texture_section;
+    texture->dataLength = texture_section_length;
+
+    if (texture->textureFormat == 0)
     {
         return HapResult_Bad_Frame;
     }
 
-    if (compressor == kHapCompressorComplex)
+    if (texture->compressor == kHapCompressorComplex)
     {
         /*
          The top-level section should contain a Decode Instructions Container followed by frame data
@@ -633,15 +786,12 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
         uint32_t section_header_length;
         uint32_t section_length;
         unsigned int section_type;
-        const char *frame_data = NULL;
         size_t bytes_remaining = 0;
+        size_t running_compressed_chunk_size = 0;
+        unsigned int chunk_count = 0;
+        unsigned int i;
 
-        int chunk_count = 0;
-        const void *compressors = NULL;
-        const void *chunk_sizes = NULL;
-        const void *chunk_offsets = NULL;
-
-        result = hap_read_section_header(texture_section, texture_section_length, &section_header_length, &section_length, &section_type);
+        int result = hap_read_section_header(texture_section, texture_section_length, &section_header_length, &section_length, &section_type);
 
         if (result == HapResult_No_Error && section_type != kHapSectionDecodeInstructionsContainer)
         {
@@ -656,7 +806,8 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
         /*
          Frame data follows immediately after the Decode Instructions Container
          */
-        frame_data = ((const char *)texture_section) + section_header_length + section_length;
+        texture->data = ((const char *)texture_section) + section_header_length + section_length;
+        texture->dataLength = texture_section_length - (section_header_length + section_length);
 
         /*
          Step through the sections inside the Decode Instructions Container
@@ -674,15 +825,15 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
             section_start = ((uint8_t *)section_start) + section_header_length;
             switch (section_type) {
                 case kHapSectionChunkSecondStageCompressorTable:
-                    compressors = section_start;
+                    texture->chunkCompressors = section_start;
                     section_chunk_count = section_length;
                     break;
                 case kHapSectionChunkSizeTable:
-                    chunk_sizes = section_start;
+                    texture->chunkSizes = section_start;
                     section_chunk_count = section_length / 4;
                     break;
                 case kHapSectionChunkOffsetTable:
-                    chunk_offsets = section_start;
+                    texture->chunkOffsets = section_start;
                     section_chunk_count = section_length / 4;
                     break;
                 default:
@@ -709,21 +860,88 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
         /*
          The Chunk Second-Stage Compressor Table and Chunk Size Table are required
          */
-        if (compressors == NULL || chunk_sizes == NULL)
+        if (texture->chunkCompressors == NULL || texture->chunkSizes == NULL)
         {
             return HapResult_Bad_Frame;
         }
 
+        texture->chunkCount = chunk_count;
+
+        /*
+         Check the chunks lie inside the frame, without reading them
+         */
+        for (i = 0; i < chunk_count; i++)
+        {
+            size_t chunk_size = hap_read_4_byte_uint(texture->chunkSizes + (i * 4));
+            size_t chunk_offset;
+
+            if (texture->chunkOffsets)
+            {
+                chunk_offset = hap_read_4_byte_uint(texture->chunkOffsets + (i * 4));
+            }
+            else
+            {
+                chunk_offset = running_compressed_chunk_size;
+            }
+            running_compressed_chunk_size += chunk_size;
+
+            if (chunk_offset > texture->dataLength || chunk_size > texture->dataLength - chunk_offset)
+            {
+                return HapResult_Bad_Frame;
+            }
+        }
+    }
+    else if (texture->compressor == kHapCompressorSnappy || texture->compressor == kHapCompressorNone)
+    {
+        /*
+         Only one section is present containing a single block of texture data
+         */
+        texture->chunkCount = 1;
+    }
+    else
+    {
+        return HapResult_Bad_Frame;
+    }
+    return HapResult_No_Error;
+}
+
+/*
+ Decodes a texture filled out by hap_parse_texture(). If chunk_function is non-NULL chunks are passed to it rather
+ than decompressed to outputBuffer, which is ignored. The chunk table is kept in scratch if it is long enough, and is
+ otherwise allocated.
+ */
+static unsigned int hap_decode_texture(const HapTexture *texture,
+                                       HapDecodeCallback callback, void *info,
+                                       void *scratch, unsigned long scratch_bytes,
+                                       HapDecodeChunkFunction chunk_function, void *chunk_function_info,
+                                       void *outputBuffer, unsigned long outputBufferBytes,
+                                       unsigned long *outputBufferBytesUsed)
+{
+    int result = HapResult_No_Error;
+    size_t bytesUsed = 0;
+
+    if (texture->compressor == kHapCompressorComplex)
+    {
+        unsigned int chunk_count = texture->chunkCount;
         if (chunk_count > 0)
         {
             /*
              Step through the chunks, storing information for their decompression
              */
-            HapChunkDecodeInfo *chunk_info = (HapChunkDecodeInfo *)malloc(sizeof(HapChunkDecodeInfo) * chunk_count);
+            HapChunkDecodeInfo *chunk_info;
 
             size_t running_compressed_chunk_size = 0;
             size_t running_uncompressed_chunk_size = 0;
-            int i;
+            unsigned int i;
+
+            if (scratch != NULL && scratch_bytes >= HapDecodeScratchLength(chunk_count))
+            {
+                chunk_info = (HapChunkDecodeInfo *)scratch;
+            }
+            else
+            {
+                chunk_info = (HapChunkDecodeInfo *)malloc(sizeof(HapChunkDecodeInfo) * chunk_count);
+            }
 
             if (chunk_info == NULL)
             {
@@ -732,17 +950,17 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
 
             for (i = 0; i < chunk_count; i++) {
 
-                chunk_info[i].compressor = *(((uint8_t *)compressors) + i);
+                chunk_info[i].compressor = texture->chunkCompressors[i];
 
-                chunk_info[i].compressed_chunk_size = hap_read_4_byte_uint(((uint8_t *)chunk_sizes) + (i * 4));
+                chunk_info[i].compressed_chunk_size = hap_read_4_byte_uint(texture->chunkSizes + (i * 4));
 
-                if (chunk_offsets)
+                if (texture->chunkOffsets)
                 {
-                    chunk_info[i].compressed_chunk_data = frame_data + hap_read_4_byte_uint(((uint8_t *)chunk_offsets) + (i * 4));
+                    chunk_info[i].compressed_chunk_data = ((const char *)texture->data) + hap_read_4_byte_uint(texture->chunkOffsets + (i * 4));
                 }
                 else
                 {
-                    chunk_info[i].compressed_chunk_data = frame_data + running_compressed_chunk_size;
+                    chunk_info[i].compressed_chunk_data = ((const char *)texture->data) + running_compressed_chunk_size;
                 }
 
                 running_compressed_chunk_size += chunk_info[i].compressed_chunk_size;
@@ -772,11 +990,19 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
                     chunk_info[i].uncompressed_chunk_size = chunk_info[i].compressed_chunk_size;
                 }
 
-                chunk_info[i].uncompressed_chunk_data = (char *)(((uint8_t *)outputBuffer) + running_uncompressed_chunk_size);
+                chunk_info[i].uncompressed_chunk_offset = running_uncompressed_chunk_size;
+                if (chunk_function == NULL)
+                {
+                    chunk_info[i].uncompressed_chunk_data = (char *)(((uint8_t *)outputBuffer) + running_uncompressed_chunk_size);
+                }
+                else
+                {
+                    chunk_info[i].uncompressed_chunk_data = NULL;
+                }
                 running_uncompressed_chunk_size += chunk_info[i].uncompressed_chunk_size;
             }
 
-            if (result == HapResult_No_Error && running_uncompressed_chunk_size > outputBufferBytes)
+            if (result == HapResult_No_Error && chunk_function == NULL && running_uncompressed_chunk_size > outputBufferBytes)
             {
                 result = HapResult_Buffer_Too_Small;
             }
@@ -788,7 +1014,23 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
                  */
                 bytesUsed = running_uncompressed_chunk_size;
 
-                if (chunk_count == 1)
+                if (chunk_function != NULL)
+                {
+                    HapChunkStreamInfo stream_info;
+                    stream_info.chunks = chunk_info;
+                    stream_info.function = chunk_function;
+                    stream_info.info = chunk_function_info;
+
+                    if (chunk_count == 1)
+                    {
+                        hap_stream_chunk(&stream_info, 0);
+                    }
+                    else
+                    {
+                        callback((HapDecodeWorkFunction)hap_stream_chunk, &stream_info, chunk_count, info);
+                    }
+                }
+                else if (chunk_count == 1)
                 {
                     /*
                      We don't invoke the callback for one chunk, just decode it directly
@@ -813,7 +1055,10 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
                 }
             }
 
-            free(chunk_info);
+            if (chunk_info != scratch)
+            {
+                free(chunk_info);
+            }
 
             if (result != HapResult_No_Error)
             {
@@ -821,12 +1066,38 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
             }
         }
     }
-    else if (compressor == kHapCompressorSnappy)
+    else if (chunk_function != NULL)
     {
         /*
-         Only one section is present containing a single block of snappy-compressed texture data
+         The whole texture is passed on as a single chunk
          */
-        snappy_status snappy_result = snappy_uncompressed_length((const char *)texture_section, texture_section_length, &bytesUsed);
+        HapChunkDecodeInfo chunk;
+        chunk.compressor = texture->compressor;
+        chunk.compressed_chunk_data = (const char *)texture->data;
+        chunk.compressed_chunk_size = texture->dataLength;
+        chunk.uncompressed_chunk_data = NULL;
+        chunk.uncompressed_chunk_offset = 0;
+        if (texture->compressor == kHapCompressorSnappy)
+        {
+            if (snappy_uncompressed_length(chunk.compressed_chunk_data, chunk.compressed_chunk_size, &chunk.uncompressed_chunk_size) != SNAPPY_OK)
+            {
+                return HapResult_Internal_Error;
+            }
+        }
+        else
+        {
+            chunk.uncompressed_chunk_size = texture->dataLength;
+        }
+        bytesUsed = chunk.uncompressed_chunk_size;
+        result = chunk_function(chunk_function_info, &chunk, 0, chunk.uncompressed_chunk_size);
+        if (result != HapResult_No_Error)
+        {
+            return result;
+        }
+    }
+    else if (texture->compressor == kHapCompressorSnappy)
+    {
+        snappy_status snappy_result = snappy_uncompressed_length((const char *)texture->data, texture->dataLength, &bytesUsed);
         if (snappy_result != SNAPPY_OK)
         {
             return HapResult_Internal_Error;
@@ -835,27 +1106,20 @@ unsigned int hap_decode_single_texture(const void *texture_section, uint32_t tex
         {
             return HapResult_Buffer_Too_Small;
         }
-        snappy_result = snappy_uncompress((const char *)texture_section, texture_section_length, (char *)outputBuffer, &bytesUsed);
+        snappy_result = snappy_uncompress((const char *)texture->data, texture->dataLength, (char *)outputBuffer, &bytesUsed);
         if (snappy_result != SNAPPY_OK)
         {
             return HapResult_Internal_Error;
         }
     }
-    else if (compressor == kHapCompressorNone)
+    else
     {
-        /*
-         Only one section is present containing a single block of uncompressed texture data
-         */
-        bytesUsed = texture_section_length;
-        if (texture_section_length > outputBufferBytes)
+        bytesUsed = texture->dataLength;
+        if (bytesUsed > outputBufferBytes)
         {
             return HapResult_Buffer_Too_Small;
         }
-        memcpy(outputBuffer, texture_section, texture_section_length);
-    }
-    else
-    {
-        return HapResult_Bad_Frame;
+        memcpy(outputBuffer, texture->data, texture->dataLength);
     }
     /*
      Fill out the remaining return value
@@ -961,21 +1225,218 @@ unsigned int HapDecode(const void *inputBuffer, unsigned long inputBufferBytes,
     result = hap_get_section_at_index(inputBuffer, inputBufferBytes, index, &section, &section_length, &section_type);
 
     if (result == HapResult_No_Error)
+    {
+        HapTexture texture;
+        result = hap_parse_texture(section, section_length, section_type, &texture);
+        if (result == HapResult_No_Error)
+        {
+            /*
+             Decode the located texture
+             */
+            *outputBufferTextureFormat = texture.textureFormat;
+            result = hap_decode_texture(&texture,
+                                        callback, info,
+                                        NULL, 0,
+                                        NULL, NULL,
+                                        outputBuffer,
+                                        outputBufferBytes,
+                                        outputBufferBytesUsed);
+        }
+    }
+
+    return result;
+}
+
+unsigned int HapDecodeChunks(const void *inputBuffer, unsigned long inputBufferBytes,
+                             unsigned int index,
+                             HapDecodeCallback callback, void *info,
+                             HapDecodeChunkFunction chunkFunction, void *chunkInfo,
+                             unsigned long *outputBufferBytesUsed,
+                             unsigned int *outputBufferTextureFormat)
+{
+    int result = HapResult_No_Error;
+    const void *section;
+    uint32_t section_length;
+    unsigned int section_type;
+
+    /*
+     Check arguments
+     */
+    if (inputBuffer == NULL
+        || index > 1
+        || callback == NULL
+        || chunkFunction == NULL
+        || outputBufferTextureFormat == NULL
+        )
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    result = hap_get_section_at_index(inputBuffer, inputBufferBytes, index, &section, &section_length, &section_type);
+
+    if (result == HapResult_No_Error)
+    {
+        HapTexture texture;
+        result = hap_parse_texture(section, section_length, section_type, &texture);
+        if (result == HapResult_No_Error)
+        {
+            *outputBufferTextureFormat = texture.textureFormat;
+            result = hap_decode_texture(&texture,
+                                        callback, info,
+                                        NULL, 0,
+                                        chunkFunction, chunkInfo,
+                                        NULL,
+                                        0,
+                                        outputBufferBytesUsed);
+        }
+    }
+
+    return result;
+}
+
+unsigned int HapDecodeChunk(const HapChunkDecodeInfo *chunk, void *outputBuffer, unsigned long outputBufferBytes)
+{
+    HapChunkDecodeInfo decode_info;
+
+    if (chunk == NULL || outputBuffer == NULL)
+    {
+        return HapResult_Bad_Arguments;
+    }
+    if (chunk->uncompressed_chunk_size > outputBufferBytes)
+    {
+        return HapResult_Buffer_Too_Small;
+    }
+
+    decode_info = *chunk;
+    decode_info.uncompressed_chunk_data = (char *)outputBuffer;
+    hap_decode_chunk(&decode_info, 0);
+    return decode_info.result;
+}
+
+unsigned int HapParseFrame(const void *inputBuffer, unsigned long inputBufferBytes, HapFrame *outputFrame)
+{
+    int result;
+    uint32_t section_header_length;
+    uint32_t section_length;
+    unsigned int section_type;
+
+    if (inputBuffer == NULL || outputFrame == NULL)
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    outputFrame->textureCount = 0;
+
+    result = hap_read_section_header(inputBuffer, inputBufferBytes, &section_header_length, &section_length, &section_type);
+
+    if (result != HapResult_No_Error)
+    {
+        return result;
+    }
+
+    if (section_type == kHapSectionMultipleImages)
     {
         /*
-         Decode the located texture
+         Step through, parsing each texture section
          */
-        result = hap_decode_single_texture(section,
+        const uint8_t *sections = ((const uint8_t *)inputBuffer) + section_header_length;
+        uint32_t top_section_length = section_length;
+        uint32_t offset = 0;
+        while (offset < top_section_length) {
+            if (outputFrame->textureCount == kHapFrameMaxTextureCount)
+            {
+                return HapResult_Bad_Frame;
+            }
+            result = hap_read_section_header(sections + offset,
+                                             top_section_length - offset,
+                                             &section_header_length,
+                                             &section_length,
+                                             &section_type);
+            if (result == HapResult_No_Error)
+            {
+                result = hap_parse_texture(sections + offset + section_header_length,
                                            section_length,
                                            section_type,
-                                           callback, info,
-                                           outputBuffer,
-                                           outputBufferBytes,
-                                           outputBufferBytesUsed,
-                                           outputBufferTextureFormat);
+                                           &outputFrame->textures[outputFrame->textureCount]);
+            }
+            if (result != HapResult_No_Error)
+            {
+                return result;
+            }
+            offset += section_header_length + section_length;
+            outputFrame->textureCount++;
+        }
+        return HapResult_No_Error;
+    }
+    else
+    {
+        /*
+         A single-texture frame with the texture as the top section.
+         */
+        result = hap_parse_texture(((const uint8_t *)inputBuffer) + section_header_length,
+                                   section_length,
+                                   section_type,
+                                   &outputFrame->textures[0]);
+        if (result == HapResult_No_Error)
+        {
+            outputFrame->textureCount = 1;
+        }
+        return result;
     }
+}
 
-    return result;
+unsigned long HapDecodeScratchLength(unsigned int chunkCount)
+{
+    return sizeof(HapChunkDecodeInfo) * chunkCount;
+}
+
+unsigned int HapDecodeTexture(const HapFrame *frame,
+                              unsigned int index,
+                              HapDecodeCallback callback, void *info,
+                              void *scratch, unsigned long scratchBytes,
+                              void *outputBuffer, unsigned long outputBufferBytes,
+                              unsigned long *outputBufferBytesUsed)
+{
+    if (frame == NULL
+        || index >= frame->textureCount
+        || callback == NULL
+        || outputBuffer == NULL
+        )
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    return hap_decode_texture(&frame->textures[index],
+                              callback, info,
+                              scratch, scratchBytes,
+                              NULL, NULL,
+                              outputBuffer,
+                              outputBufferBytes,
+                              outputBufferBytesUsed);
+}
+
+unsigned int HapDecodeTextureChunks(const HapFrame *frame,
+                                    unsigned int index,
+                                    HapDecodeCallback callback, void *info,
+                                    void *scratch, unsigned long scratchBytes,
+                                    HapDecodeChunkFunction chunkFunction, void *chunkInfo)
+{
+    if (frame == NULL
+        || index >= frame->textureCount
+        || callback == NULL
+        || chunkFunction == NULL
+        )
+    {
+        return HapResult_Bad_Arguments;
+    }
+
+    return hap_decode_texture(&frame->textures[index],
+                              callback, info,
+                              scratch, scratchBytes,
+                              chunkFunction, chunkInfo,
+                              NULL,
+                              0,
+                              NULL);
 }
 
 unsigned int HapGetFrameTextureCount(const void *inputBuffer, unsigned long inputBufferBytes, unsigned int *outputTextureCount)
@@ -49,6 +49,14 @@ enum HapCompressor {
     HapCompressorSnappy
 };
 
+/*
+ Options for HapEncodeWithOptions(), which may be combined
+ */
+enum HapEncodeOption {
+    HapEncodeOptionNone = 0,
+    HapEncodeOptionChunkOffsetTable = 1
+};
+
 enum HapResult {
     HapResult_No_Error = 0,
     HapResult_Bad_Arguments,
@@ -63,12 +71,47 @@ enum HapResult {
 typedef void (*HapDecodeWorkFunction)(void *p, unsigned int index);
 typedef void (*HapDecodeCallback)(HapDecodeWorkFunction function, void *p, unsigned int count, void *info);
 
+/*
+ See HapDecodeChunks for descriptions of these types.
+ */
+typedef struct HapChunkDecodeInfo HapChunkDecodeInfo;
+typedef unsigned int (*HapDecodeChunkFunction)(void *info, const HapChunkDecodeInfo *chunk, unsigned long offset, unsigned long length);
+
+/*
+ See HapParseFrame for descriptions of these types.
+ */
+#define kHapFrameMaxTextureCount 2
+
+typedef struct HapTexture {
+    unsigned int textureFormat;         // a HapTextureFormat
+    unsigned int chunkCount;            // the number of chunks the texture is decompressed in
+    // The remaining members locate the texture's data in the frame, and are for use by hap.c
+    unsigned int compressor;
+    const void *data;
+    unsigned long dataLength;
+    const unsigned char *chunkCompressors;
+    const unsigned char *chunkSizes;
+    const unsigned char *chunkOffsets;
+} HapTexture;
+
+typedef struct HapFrame {
+    unsigned int textureCount;
+    HapTexture textures[kHapFrameMaxTextureCount];
+} HapFrame;
+
+/*
+ See HapEncodeWithOptions for descriptions of these function types.
+ */
+typedef void (*HapEncodeWorkFunction)(void *p, unsigned int index);
+typedef void (*HapEncodeCallback)(HapEncodeWorkFunction function, void *p, unsigned int count, void *info);
+
 /*
  Returns the maximum size of an output buffer for a frame composed of multiple textures.
  count is the number of textures
  lengths is an array of input texture lengths in bytes
  textureFormats is an array of HapTextureFormats
  chunkCounts is an array of chunk counts
+ The length allows for any HapEncodeOption.
  */
 unsigned long HapMaxEncodedLength(unsigned int count,
                                   unsigned long *lengths,
@@ -100,6 +143,28 @@ unsigned int HapEncode(unsigned int count,
                        void *outputBuffer, unsigned long outputBufferBytes,
                        unsigned long *outputBufferBytesUsed);
 
+/*
+ As HapEncode(), with options, a combination of HapEncodeOption values, and a callback.
+
+ HapEncodeOptionChunkOffsetTable adds a Chunk Offset Table to each chunked texture, giving the position of every
+ chunk. Decoders can then go straight to any chunk, for instance to decode part of a frame or to hand chunks to
+ threads, rather than summing the sizes of the chunks before it. This costs four bytes a chunk. Frames remain
+ readable by decoders which don't use the table.
+
+ callback is used to compress the chunks of a texture in parallel in the same way HapDecode() uses its callback
+ to decompress them. If callback is NULL chunks are compressed in turn on the calling thread, as by HapEncode().
+ info is an argument for your own use to pass context to the callback.
+ */
+unsigned int HapEncodeWithOptions(unsigned int count,
+                                  const void **inputBuffers, unsigned long *inputBuffersBytes,
+                                  unsigned int *textureFormats,
+                                  unsigned int *compressors,
+                                  unsigned int *chunkCounts,
+                                  unsigned int options,
+                                  HapEncodeCallback callback, void *info,
+                                  void *outputBuffer, unsigned long outputBufferBytes,
+                                  unsigned long *outputBufferBytesUsed);
+
 /*
  Decodes a texture from inputBuffer which is a Hap frame.
 
@@ -133,6 +198,70 @@ unsigned int HapDecode(const void *inputBuffer, unsigned long inputBufferBytes,
                        unsigned long *outputBufferBytesUsed,
                        unsigned int *outputBufferTextureFormat);
 
+/*
+ Decodes a texture like HapDecode(), but rather than decompressing every chunk into one output buffer, passes each
+ chunk to chunkFunction so it can be decompressed into a small buffer and used while it is still in cache.
+
+ chunkFunction is called once for every chunk in the texture, with offset and length giving the range of bytes of the
+ decompressed texture which the chunk holds. It should decompress the chunk with HapDecodeChunk() and return
+ HapResult_No_Error, or an error to have HapDecodeChunks() fail. A chunk which isn't needed can be skipped by returning
+ without decompressing it. Calls are made in parallel through callback, which is
+ used as it is by HapDecode(), so chunkFunction must be safe to call from several threads at once.
+ chunkInfo is an argument for your own use to pass context to chunkFunction.
+ If outputBufferBytesUsed is not NULL then it will be set to the decoded length of the texture.
+ outputBufferTextureFormat must be non-NULL, and will be set to one of the HapTextureFormat constants.
+ */
+unsigned int HapDecodeChunks(const void *inputBuffer, unsigned long inputBufferBytes,
+                             unsigned int index,
+                             HapDecodeCallback callback, void *info,
+                             HapDecodeChunkFunction chunkFunction, void *chunkInfo,
+                             unsigned long *outputBufferBytesUsed,
+                             unsigned int *outputBufferTextureFormat);
+
+/*
+ Decompresses a chunk passed to a HapDecodeChunkFunction into outputBuffer, which must be at least as long as the
+ length passed with the chunk.
+ */
+unsigned int HapDecodeChunk(const HapChunkDecodeInfo *chunk, void *outputBuffer, unsigned long outputBufferBytes);
+
+/*
+ Reads the section headers and decode instructions of the frame in inputBuffer once into outputFrame, which can then
+ be passed to HapDecodeTexture() and HapDecodeTextureChunks() to decode its textures without the frame being read
+ again. The compressed texture data isn't read. outputFrame points into inputBuffer so is only valid while inputBuffer is.
+ On return outputFrame->textureCount is the number of textures in the frame, and for each texture textureFormat is a
+ HapTextureFormat constant and chunkCount is the number of chunks it will be decompressed in.
+ */
+unsigned int HapParseFrame(const void *inputBuffer, unsigned long inputBufferBytes, HapFrame *outputFrame);
+
+/*
+ Returns the length of a scratch buffer which lets HapDecodeTexture() and HapDecodeTextureChunks() decode textures of
+ up to chunkCount chunks without allocating any memory.
+ */
+unsigned long HapDecodeScratchLength(unsigned int chunkCount);
+
+/*
+ Decodes the texture at index in a frame read by HapParseFrame(), as HapDecode() does.
+ scratch is a buffer of scratchBytes bytes, aligned as malloc() aligns memory, which holds the texture's chunk table
+ while it is decoded. It may be reused for every frame, but not by two decodes at once. If scratch is NULL or shorter
+ than HapDecodeScratchLength() for the texture's chunkCount, the table is allocated for the call.
+ */
+unsigned int HapDecodeTexture(const HapFrame *frame,
+                              unsigned int index,
+                              HapDecodeCallback callback, void *info,
+                              void *scratch, unsigned long scratchBytes,
+                              void *outputBuffer, unsigned long outputBufferBytes,
+                              unsigned long *outputBufferBytesUsed);
+
+/*
+ Passes the chunks of the texture at index in a frame read by HapParseFrame() to chunkFunction, as HapDecodeChunks()
+ does. scratch is used as it is by HapDecodeTexture().
+ */
+unsigned int HapDecodeTextureChunks(const HapFrame *frame,
+                                    unsigned int index,
+                                    HapDecodeCallback callback, void *info,
+                                    void *scratch, unsigned long scratchBytes,
+                                    HapDecodeChunkFunction chunkFunction, void *chunkInfo);
+
 /*
  If this returns HapResult_No_Error then outputTextureCount is set to the count of textures in the frame.
  */
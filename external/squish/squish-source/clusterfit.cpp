@@ -29,8 +29,65 @@
 #include "colourblock.h"
 #include <cfloat>
 
+#if SQUISH_USE_SSE
+#include "clusterfit_avx2.h"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
 namespace squish {
 
+#if SQUISH_USE_SSE
+
+#if defined(_MSC_VER)
+
+#define squish_cpuid( i, t ) __cpuidex( ( i ), ( t ), 0 )
+#define squish_xgetbv() _xgetbv( 0 )
+
+#else
+
+static void squish_cpuid( int info[4], int infoType )
+{
+	__asm__ __volatile__ ( "cpuid" : "=a" ( info[0] ), "=b" ( info[1] ), "=c" ( info[2] ), "=d" ( info[3] ) : "a" ( infoType ), "c" ( 0 ) );
+}
+
+static unsigned long long squish_xgetbv()
+{
+	unsigned int eax, edx;
+	__asm__ __volatile__ ( "xgetbv" : "=a" ( eax ), "=d" ( edx ) : "c" ( 0 ) );
+	return ( ( unsigned long long )edx << 32 ) | eax;
+}
+
+#endif
+
+static bool DetectAVX2()
+{
+	int info[4] = { 0, 0, 0, 0 };
+	squish_cpuid( info, 1 );
+
+	// the OS must save the YMM registers for us to use them
+	bool hasAVX = ( info[2] & ( 1 << 28 ) ) != 0;
+	bool hasOSXSAVE = ( info[2] & ( 1 << 27 ) ) != 0;
+	if( !hasAVX || !hasOSXSAVE || ( squish_xgetbv() & 0x6 ) != 0x6 )
+		return false;
+
+	squish_cpuid( info, 0 );
+	if( info[0] < 7 )
+		return false;
+
+	squish_cpuid( info, 7 );
+	return ( info[1] & ( 1 << 5 ) ) != 0;
+}
+
+bool ClusterFitHasAVX2()
+{
+	static bool const hasAVX2 = DetectAVX2();
+	return hasAVX2;
+}
+
+#endif
+
 ClusterFit::ClusterFit( ColourSet const* colours, int flags, float* metric ) 
   : ColourFit( colours, flags )
 {
@@ -259,6 +316,9 @@ void ClusterFit::Compress4( void* block )
 	Vec4 const half = VEC4_CONST( 0.5f );
 	Vec4 const grid( 31.0f, 63.0f, 31.0f, 0.0f );
 	Vec4 const gridrcp( 1.0f/31.0f, 1.0f/63.0f, 1.0f/31.0f, 0.0f );
+#if SQUISH_USE_SSE
+	bool const useAVX2 = ClusterFitHasAVX2();
+#endif
 
 	// prepare an ordering using the principle axis
 	ConstructOrdering( m_principle, 0 );
@@ -274,80 +334,99 @@ void ClusterFit::Compress4( void* block )
 	// loop over iterations (we avoid the case that all points in first or last cluster)
 	for( int iterationIndex = 0;; )
 	{
-		// first cluster [0,i) is at the start
-		Vec4 part0 = VEC4_CONST( 0.0f );
-		for( int i = 0; i < count; ++i )
+#if SQUISH_USE_SSE
+		if( useAVX2 )
+		{
+			// check eight partitions at a time
+			float error = besterror.GetVec3().X();
+			float start[4], end[4];
+			if( ClusterFitSearch4AVX2( ( float const* )m_points_weights, ( float const* )&m_xsum_wsum, ( float const* )&m_metric, count,
+									   &error, start, end, &besti, &bestj, &bestk ) )
+			{
+				beststart = Vec4( start[0], start[1], start[2], start[3] );
+				bestend = Vec4( end[0], end[1], end[2], end[3] );
+				besterror = Vec4( error );
+				bestiteration = iterationIndex;
+			}
+		}
+		else
+#endif
 		{
-			// second cluster [i,j) is one third along
-			Vec4 part1 = VEC4_CONST( 0.0f );
-			for( int j = i;; )
+			// first cluster [0,i) is at the start
+			Vec4 part0 = VEC4_CONST( 0.0f );
+			for( int i = 0; i < count; ++i )
 			{
-				// third cluster [j,k) is two thirds along
-				Vec4 part2 = ( j == 0 ) ? m_points_weights[0] : VEC4_CONST( 0.0f );
-				int kmin = ( j == 0 ) ? 1 : j;
-				for( int k = kmin;; )
+				// second cluster [i,j) is one third along
+				Vec4 part1 = VEC4_CONST( 0.0f );
+				for( int j = i;; )
 				{
-					// last cluster [k,count) is at the end
-					Vec4 part3 = m_xsum_wsum - part2 - part1 - part0;
+					// third cluster [j,k) is two thirds along
+					Vec4 part2 = ( j == 0 ) ? m_points_weights[0] : VEC4_CONST( 0.0f );
+					int kmin = ( j == 0 ) ? 1 : j;
+					for( int k = kmin;; )
+					{
+						// last cluster [k,count) is at the end
+						Vec4 part3 = m_xsum_wsum - part2 - part1 - part0;
 
-					// compute least squares terms directly
-					Vec4 const alphax_sum = MultiplyAdd( part2, onethird_onethird2, MultiplyAdd( part1, twothirds_twothirds2, part0 ) );
-					Vec4 const alpha2_sum = alphax_sum.SplatW();
+						// compute least squares terms directly
+						Vec4 const alphax_sum = MultiplyAdd( part2, onethird_onethird2, MultiplyAdd( part1, twothirds_twothirds2, part0 ) );
+						Vec4 const alpha2_sum = alphax_sum.SplatW();
 					
-					Vec4 const betax_sum = MultiplyAdd( part1, onethird_onethird2, MultiplyAdd( part2, twothirds_twothirds2, part3 ) );
-					Vec4 const beta2_sum = betax_sum.SplatW();
+						Vec4 const betax_sum = MultiplyAdd( part1, onethird_onethird2, MultiplyAdd( part2, twothirds_twothirds2, part3 ) );
+						Vec4 const beta2_sum = betax_sum.SplatW();
 					
-					Vec4 const alphabeta_sum = twonineths*( part1 + part2 ).SplatW();
-
-					// compute the least-squares optimal points
-					Vec4 factor = Reciprocal( NegativeMultiplySubtract( alphabeta_sum, alphabeta_sum, alpha2_sum*beta2_sum ) );
-					Vec4 a = NegativeMultiplySubtract( betax_sum, alphabeta_sum, alphax_sum*beta2_sum )*factor;
-					Vec4 b = NegativeMultiplySubtract( alphax_sum, alphabeta_sum, betax_sum*alpha2_sum )*factor;
-
-					// clamp to the grid
-					a = Min( one, Max( zero, a ) );
-					b = Min( one, Max( zero, b ) );
-					a = Truncate( MultiplyAdd( grid, a, half ) )*gridrcp;
-					b = Truncate( MultiplyAdd( grid, b, half ) )*gridrcp;
+						Vec4 const alphabeta_sum = twonineths*( part1 + part2 ).SplatW();
+
+						// compute the least-squares optimal points
+						Vec4 factor = Reciprocal( NegativeMultiplySubtract( alphabeta_sum, alphabeta_sum, alpha2_sum*beta2_sum ) );
+						Vec4 a = NegativeMultiplySubtract( betax_sum, alphabeta_sum, alphax_sum*beta2_sum )*factor;
+						Vec4 b = NegativeMultiplySubtract( alphax_sum, alphabeta_sum, betax_sum*alpha2_sum )*factor;
+
+						// clamp to the grid
+						a = Min( one, Max( zero, a ) );
+						b = Min( one, Max( zero, b ) );
+						a = Truncate( MultiplyAdd( grid, a, half ) )*gridrcp;
+						b = Truncate( MultiplyAdd( grid, b, half ) )*gridrcp;
 					
-					// compute the error (we skip the constant xxsum)
-					Vec4 e1 = MultiplyAdd( a*a, alpha2_sum, b*b*beta2_sum );
-					Vec4 e2 = NegativeMultiplySubtract( a, alphax_sum, a*b*alphabeta_sum );
-					Vec4 e3 = NegativeMultiplySubtract( b, betax_sum, e2 );
-					Vec4 e4 = MultiplyAdd( two, e3, e1 );
-
-					// apply the metric to the error term
-					Vec4 e5 = e4*m_metric;
-					Vec4 error = e5.SplatX() + e5.SplatY() + e5.SplatZ();
-
-					// keep the solution if it wins
-					if( CompareAnyLessThan( error, besterror ) )
-					{
-						beststart = a;
-						bestend = b;
-						besterror = error;
-						besti = i;
-						bestj = j;
-						bestk = k;
-						bestiteration = iterationIndex;
+						// compute the error (we skip the constant xxsum)
+						Vec4 e1 = MultiplyAdd( a*a, alpha2_sum, b*b*beta2_sum );
+						Vec4 e2 = NegativeMultiplySubtract( a, alphax_sum, a*b*alphabeta_sum );
+						Vec4 e3 = NegativeMultiplySubtract( b, betax_sum, e2 );
+						Vec4 e4 = MultiplyAdd( two, e3, e1 );
+
+						// apply the metric to the error term
+						Vec4 e5 = e4*m_metric;
+						Vec4 error = e5.SplatX() + e5.SplatY() + e5.SplatZ();
+
+						// keep the solution if it wins
+						if( CompareAnyLessThan( error, besterror ) )
+						{
+							beststart = a;
+							bestend = b;
+							besterror = error;
+							besti = i;
+							bestj = j;
+							bestk = k;
+							bestiteration = iterationIndex;
+						}
+
+						// advance
+						if( k == count )
+							break;
+						part2 += m_points_weights[k];
+						++k;
 					}
 
 					// advance
-					if( k == count )
+					if( j == count )
 						break;
-					part2 += m_points_weights[k];
-					++k;
+					part1 += m_points_weights[j];
+					++j;
 				}
 
 				// advance
-				if( j == count )
-					break;
-				part1 += m_points_weights[j];
-				++j;
+				part0 += m_points_weights[i];
 			}
-
-			// advance
-			part0 += m_points_weights[i];
 		}
 		
 		// stop if we didn't improve in this iteration
@@ -0,0 +1,222 @@
+/* -----------------------------------------------------------------------------
+
+	Copyright (c) 2006 Simon Brown                          si@sjbrown.co.uk
+	Copyright (c) 2007 Ignacio Castano                   icastano@nvidia.com
+
+	Permission is hereby granted, free of charge, to any person obtaining
+	a copy of this software and associated documentation files (the 
+	"Software"), to	deal in the Software without restriction, including
+	without limitation the rights to use, copy, modify, merge, publish,
+	distribute, sublicense, and/or sell copies of the Software, and to 
+	permit persons to whom the Software is furnished to do so, subject to 
+	the following conditions:
+
+	The above copyright notice and this permission notice shall be included
+	in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+	OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+	MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+	CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+	TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+	SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	
+   -------------------------------------------------------------------------- */
+   
+#include "clusterfit_avx2.h"
+#include "config.h"
+
+#if SQUISH_USE_SSE
+
+#include <immintrin.h>
+
+namespace squish {
+
+bool ClusterFitSearch4AVX2( float const* points_weights, float const* xsum_wsum, float const* metric, int count,
+							float* besterror, float* beststart, float* bestend, int* besti, int* bestj, int* bestk )
+{
+	// columns of part2 for each j, indexed by k so that eight successive k load at once
+	float part2[17][4][24];
+	for( int j = 0; j <= count; ++j )
+	{
+		float sum[4];
+		for( int c = 0; c < 4; ++c )
+			sum[c] = ( j == 0 ) ? points_weights[c] : 0.0f;
+		int kmin = ( j == 0 ) ? 1 : j;
+		for( int k = kmin; k < count + 8; ++k )
+		{
+			for( int c = 0; c < 4; ++c )
+			{
+				part2[j][c][k] = ( k <= count ) ? sum[c] : 0.0f;
+				if( k < count )
+					sum[c] += points_weights[4*k + c];
+			}
+		}
+	}
+
+	// declare variables
+	__m256 const two = _mm256_set1_ps( 2.0f );
+	__m256 const one = _mm256_set1_ps( 1.0f );
+	__m256 const onethird = _mm256_set1_ps( 1.0f/3.0f );
+	__m256 const onethird2 = _mm256_set1_ps( 1.0f/9.0f );
+	__m256 const twothirds = _mm256_set1_ps( 2.0f/3.0f );
+	__m256 const twothirds2 = _mm256_set1_ps( 4.0f/9.0f );
+	__m256 const twonineths = _mm256_set1_ps( 2.0f/9.0f );
+	__m256 const zero = _mm256_setzero_ps();
+	__m256 const half = _mm256_set1_ps( 0.5f );
+	__m256 const grid5 = _mm256_set1_ps( 31.0f );
+	__m256 const grid6 = _mm256_set1_ps( 63.0f );
+	__m256 const gridrcp5 = _mm256_set1_ps( 1.0f/31.0f );
+	__m256 const gridrcp6 = _mm256_set1_ps( 1.0f/63.0f );
+	__m256 const metricx = _mm256_set1_ps( metric[0] );
+	__m256 const metricy = _mm256_set1_ps( metric[1] );
+	__m256 const metricz = _mm256_set1_ps( metric[2] );
+	__m256 const xsumx = _mm256_set1_ps( xsum_wsum[0] );
+	__m256 const xsumy = _mm256_set1_ps( xsum_wsum[1] );
+	__m256 const xsumz = _mm256_set1_ps( xsum_wsum[2] );
+	__m256 const xsumw = _mm256_set1_ps( xsum_wsum[3] );
+	__m256i const lanes = _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 );
+
+	bool found = false;
+
+	// first cluster [0,i) is at the start
+	float part0[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+	for( int i = 0; i < count; ++i )
+	{
+		__m256 const p0x = _mm256_set1_ps( part0[0] );
+		__m256 const p0y = _mm256_set1_ps( part0[1] );
+		__m256 const p0z = _mm256_set1_ps( part0[2] );
+		__m256 const p0w = _mm256_set1_ps( part0[3] );
+
+		// second cluster [i,j) is one third along
+		float part1[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for( int j = i;; )
+		{
+			__m256 const p1x = _mm256_set1_ps( part1[0] );
+			__m256 const p1y = _mm256_set1_ps( part1[1] );
+			__m256 const p1z = _mm256_set1_ps( part1[2] );
+			__m256 const p1w = _mm256_set1_ps( part1[3] );
+
+			// third cluster [j,k) is two thirds along, for eight k at a time
+			int kmin = ( j == 0 ) ? 1 : j;
+			for( int k = kmin; k <= count; k += 8 )
+			{
+				__m256 const p2x = _mm256_loadu_ps( &part2[j][0][k] );
+				__m256 const p2y = _mm256_loadu_ps( &part2[j][1][k] );
+				__m256 const p2z = _mm256_loadu_ps( &part2[j][2][k] );
+				__m256 const p2w = _mm256_loadu_ps( &part2[j][3][k] );
+
+				// last cluster [k,count) is at the end
+				__m256 const p3x = _mm256_sub_ps( _mm256_sub_ps( _mm256_sub_ps( xsumx, p2x ), p1x ), p0x );
+				__m256 const p3y = _mm256_sub_ps( _mm256_sub_ps( _mm256_sub_ps( xsumy, p2y ), p1y ), p0y );
+				__m256 const p3z = _mm256_sub_ps( _mm256_sub_ps( _mm256_sub_ps( xsumz, p2z ), p1z ), p0z );
+				__m256 const p3w = _mm256_sub_ps( _mm256_sub_ps( _mm256_sub_ps( xsumw, p2w ), p1w ), p0w );
+
+				// compute least squares terms directly
+				__m256 const alphax = _mm256_add_ps( _mm256_mul_ps( p2x, onethird ), _mm256_add_ps( _mm256_mul_ps( p1x, twothirds ), p0x ) );
+				__m256 const alphay = _mm256_add_ps( _mm256_mul_ps( p2y, onethird ), _mm256_add_ps( _mm256_mul_ps( p1y, twothirds ), p0y ) );
+				__m256 const alphaz = _mm256_add_ps( _mm256_mul_ps( p2z, onethird ), _mm256_add_ps( _mm256_mul_ps( p1z, twothirds ), p0z ) );
+				__m256 const alpha2_sum = _mm256_add_ps( _mm256_mul_ps( p2w, onethird2 ), _mm256_add_ps( _mm256_mul_ps( p1w, twothirds2 ), p0w ) );
+
+				__m256 const betax = _mm256_add_ps( _mm256_mul_ps( p1x, onethird ), _mm256_add_ps( _mm256_mul_ps( p2x, twothirds ), p3x ) );
+				__m256 const betay = _mm256_add_ps( _mm256_mul_ps( p1y, onethird ), _mm256_add_ps( _mm256_mul_ps( p2y, twothirds ), p3y ) );
+				__m256 const betaz = _mm256_add_ps( _mm256_mul_ps( p1z, onethird ), _mm256_add_ps( _mm256_mul_ps( p2z, twothirds ), p3z ) );
+				__m256 const beta2_sum = _mm256_add_ps( _mm256_mul_ps( p1w, onethird2 ), _mm256_add_ps( _mm256_mul_ps( p2w, twothirds2 ), p3w ) );
+
+				__m256 const alphabeta_sum = _mm256_mul_ps( twonineths, _mm256_add_ps( p1w, p2w ) );
+
+				// compute the least-squares optimal points
+				__m256 const denominator = _mm256_sub_ps( _mm256_mul_ps( alpha2_sum, beta2_sum ), _mm256_mul_ps( alphabeta_sum, alphabeta_sum ) );
+				__m256 const estimate = _mm256_rcp_ps( denominator );
+				__m256 const factor = _mm256_add_ps( _mm256_mul_ps( _mm256_sub_ps( one, _mm256_mul_ps( estimate, denominator ) ), estimate ), estimate );
+
+				__m256 ax = _mm256_mul_ps( _mm256_sub_ps( _mm256_mul_ps( alphax, beta2_sum ), _mm256_mul_ps( betax, alphabeta_sum ) ), factor );
+				__m256 ay = _mm256_mul_ps( _mm256_sub_ps( _mm256_mul_ps( alphay, beta2_sum ), _mm256_mul_ps( betay, alphabeta_sum ) ), factor );
+				__m256 az = _mm256_mul_ps( _mm256_sub_ps( _mm256_mul_ps( alphaz, beta2_sum ), _mm256_mul_ps( betaz, alphabeta_sum ) ), factor );
+				__m256 bx = _mm256_mul_ps( _mm256_sub_ps( _mm256_mul_ps( betax, alpha2_sum ), _mm256_mul_ps( alphax, alphabeta_sum ) ), factor );
+				__m256 by = _mm256_mul_ps( _mm256_sub_ps( _mm256_mul_ps( betay, alpha2_sum ), _mm256_mul_ps( alphay, alphabeta_sum ) ), factor );
+				__m256 bz = _mm256_mul_ps( _mm256_sub_ps( _mm256_mul_ps( betaz, alpha2_sum ), _mm256_mul_ps( alphaz, alphabeta_sum ) ), factor );
+
+				// clamp to the grid
+				ax = _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( grid5, _mm256_min_ps( one, _mm256_max_ps( zero, ax ) ) ), half ) ) ), gridrcp5 );
+				ay = _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( grid6, _mm256_min_ps( one, _mm256_max_ps( zero, ay ) ) ), half ) ) ), gridrcp6 );
+				az = _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( grid5, _mm256_min_ps( one, _mm256_max_ps( zero, az ) ) ), half ) ) ), gridrcp5 );
+				bx = _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( grid5, _mm256_min_ps( one, _mm256_max_ps( zero, bx ) ) ), half ) ) ), gridrcp5 );
+				by = _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( grid6, _mm256_min_ps( one, _mm256_max_ps( zero, by ) ) ), half ) ) ), gridrcp6 );
+				bz = _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvttps_epi32( _mm256_add_ps( _mm256_mul_ps( grid5, _mm256_min_ps( one, _mm256_max_ps( zero, bz ) ) ), half ) ) ), gridrcp5 );
+
+				// compute the error (we skip the constant xxsum)
+				__m256 const e1x = _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( ax, ax ), alpha2_sum ), _mm256_mul_ps( _mm256_mul_ps( bx, bx ), beta2_sum ) );
+				__m256 const e1y = _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( ay, ay ), alpha2_sum ), _mm256_mul_ps( _mm256_mul_ps( by, by ), beta2_sum ) );
+				__m256 const e1z = _mm256_add_ps( _mm256_mul_ps( _mm256_mul_ps( az, az ), alpha2_sum ), _mm256_mul_ps( _mm256_mul_ps( bz, bz ), beta2_sum ) );
+				__m256 const e2x = _mm256_sub_ps( _mm256_mul_ps( _mm256_mul_ps( ax, bx ), alphabeta_sum ), _mm256_mul_ps( ax, alphax ) );
+				__m256 const e2y = _mm256_sub_ps( _mm256_mul_ps( _mm256_mul_ps( ay, by ), alphabeta_sum ), _mm256_mul_ps( ay, alphay ) );
+				__m256 const e2z = _mm256_sub_ps( _mm256_mul_ps( _mm256_mul_ps( az, bz ), alphabeta_sum ), _mm256_mul_ps( az, alphaz ) );
+				__m256 const e3x = _mm256_sub_ps( e2x, _mm256_mul_ps( bx, betax ) );
+				__m256 const e3y = _mm256_sub_ps( e2y, _mm256_mul_ps( by, betay ) );
+				__m256 const e3z = _mm256_sub_ps( e2z, _mm256_mul_ps( bz, betaz ) );
+				__m256 const e4x = _mm256_add_ps( _mm256_mul_ps( two, e3x ), e1x );
+				__m256 const e4y = _mm256_add_ps( _mm256_mul_ps( two, e3y ), e1y );
+				__m256 const e4z = _mm256_add_ps( _mm256_mul_ps( two, e3z ), e1z );
+
+				// apply the metric to the error term
+				__m256 const error = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( e4x, metricx ), _mm256_mul_ps( e4y, metricy ) ), _mm256_mul_ps( e4z, metricz ) );
+
+				// keep the first of the best solutions if any win
+				__m256 const valid = _mm256_castsi256_ps( _mm256_cmpgt_epi32( _mm256_set1_epi32( count + 1 - k ), lanes ) );
+				int wins = _mm256_movemask_ps( _mm256_and_ps( _mm256_cmp_ps( error, _mm256_set1_ps( *besterror ), _CMP_LT_OQ ), valid ) );
+				if( wins != 0 )
+				{
+					float errors[8];
+					_mm256_storeu_ps( errors, error );
+					int lane = 0;
+					for( int l = 0; l < 8; ++l )
+					{
+						if( ( wins & ( 1 << l ) ) && errors[l] < *besterror )
+						{
+							*besterror = errors[l];
+							lane = l;
+						}
+					}
+
+					float values[6][8];
+					_mm256_storeu_ps( values[0], ax );
+					_mm256_storeu_ps( values[1], ay );
+					_mm256_storeu_ps( values[2], az );
+					_mm256_storeu_ps( values[3], bx );
+					_mm256_storeu_ps( values[4], by );
+					_mm256_storeu_ps( values[5], bz );
+					for( int c = 0; c < 3; ++c )
+					{
+						beststart[c] = values[c][lane];
+						bestend[c] = values[c + 3][lane];
+					}
+					beststart[3] = 0.0f;
+					bestend[3] = 0.0f;
+					*besti = i;
+					*bestj = j;
+					*bestk = k + lane;
+					found = true;
+				}
+			}
+
+			// advance
+			if( j == count )
+				break;
+			for( int c = 0; c < 4; ++c )
+				part1[c] += points_weights[4*j + c];
+			++j;
+		}
+
+		// advance
+		for( int c = 0; c < 4; ++c )
+			part0[c] += points_weights[4*i + c];
+	}
+
+	return found;
+}
+
+} // namespace squish
+
+#endif // SQUISH_USE_SSE
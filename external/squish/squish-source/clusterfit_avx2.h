@@ -0,0 +1,59 @@
+/* -----------------------------------------------------------------------------
+
+	Copyright (c) 2006 Simon Brown                          si@sjbrown.co.uk
+	Copyright (c) 2007 Ignacio Castano                   icastano@nvidia.com
+
+	Permission is hereby granted, free of charge, to any person obtaining
+	a copy of this software and associated documentation files (the 
+	"Software"), to	deal in the Software without restriction, including
+	without limitation the rights to use, copy, modify, merge, publish,
+	distribute, sublicense, and/or sell copies of the Software, and to 
+	permit persons to whom the Software is furnished to do so, subject to 
+	the following conditions:
+
+	The above copyright notice and this permission notice shall be included
+	in all copies or substantial portions of the Software.
+
+	THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+	OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF 
+	MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.
+	IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY 
+	CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, 
+	TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE 
+	SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+	
+   -------------------------------------------------------------------------- */
+   
+#ifndef SQUISH_CLUSTERFIT_AVX2_H
+#define SQUISH_CLUSTERFIT_AVX2_H
+
+// This header is shared with a file built for AVX2, so declares only plain functions and types.
+
+namespace squish {
+
+//! Returns true if the processor and OS support AVX2.
+bool ClusterFitHasAVX2();
+
+/*! @brief Searches every four-cluster partition of an ordered set of points with AVX2.
+
+	@param points_weights	The weighted points in order, four floats each (x, y, z, w).
+	@param xsum_wsum	The sum of points_weights.
+	@param metric	The error metric, four floats.
+	@param count	The number of points.
+	@param besterror	The error to beat, updated if a partition beats it.
+	@param beststart	Receives the first endpoint of the winning partition, four floats.
+	@param bestend	Receives the second endpoint of the winning partition, four floats.
+	@param besti	Receives the start of the second cluster.
+	@param bestj	Receives the start of the third cluster.
+	@param bestk	Receives the start of the fourth cluster.
+
+	Partitions are tried in the same order and with the same arithmetic as
+	ClusterFit::Compress4() using SSE, so the results are identical.  Returns
+	true if a partition beat besterror.
+*/
+bool ClusterFitSearch4AVX2( float const* points_weights, float const* xsum_wsum, float const* metric, int count,
+							float* besterror, float* beststart, float* bestend, int* besti, int* bestj, int* bestk );
+
+} // namespace squish
+
+#endif // ndef SQUISH_CLUSTERFIT_AVX2_H
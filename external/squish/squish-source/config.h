@@ -32,9 +32,14 @@
 #endif
 
 // Set to 1 or 2 when building squish to use SSE or SSE2 instructions.
+// Defaults to 2 when the compiler targets SSE2.
 #ifndef SQUISH_USE_SSE
+#if !SQUISH_USE_ALTIVEC && ( defined( __SSE2__ ) || defined( _M_X64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 ) )
+#define SQUISH_USE_SSE 2
+#else
 #define SQUISH_USE_SSE 0
 #endif
+#endif
 
 // Internally set SQUISH_USE_SIMD when either Altivec or SSE is available.
 #if SQUISH_USE_ALTIVEC && SQUISH_USE_SSE
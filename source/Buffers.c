@@ -26,11 +26,63 @@
  */
 
 #include "Buffers.h"
-#ifdef __APPLE__
+#include "HapPlatform.h"
+#if defined(__APPLE__)
 #include <libkern/OSAtomic.h>
-#else
+#elif defined(_WIN32)
 #include <Windows.h>
 #include <malloc.h>
+#else
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#if !defined(__APPLE__) && !defined(_WIN32)
+/*
+ Elsewhere the pool is a Treiber stack built on C11 atomics. The head is a tagged
+ pointer: the low bits hold the buffer's address and the high bits a counter which is
+ incremented by every push, so a pop can't succeed against a head which has been
+ popped and pushed again since it was read (the ABA problem). Buffers are only
+ freed when the pool is destroyed, so reading a stale head's next is always safe.
+
+ In front of the stack sit a few small magazines. Each thread is assigned one,
+ and as long as no other thread is using it, buffers are recycled through it without
+ touching the shared head at all.
+ */
+#if UINTPTR_MAX > 0xFFFFFFFFU
+#define kHapCodecBufferPointerBits 48 // user-space addresses fit in 48 bits on x86-64 and ARM64
+#else
+#define kHapCodecBufferPointerBits 32
+#endif
+#define kHapCodecBufferPointerMask ((((uint64_t)1) << kHapCodecBufferPointerBits) - 1)
+#define kHapCodecBufferMagazineCount 16
+#define kHapCodecBufferMagazineCapacity 4
+
+// Each magazine has a cache line to itself, so threads using neighbouring magazines don't contend
+typedef struct HAP_ALIGN_64 HapCodecBufferMagazine {
+    atomic_flag             busy;
+    unsigned int            count;
+    HapCodecBufferRef       buffers[kHapCodecBufferMagazineCapacity];
+} HapCodecBufferMagazine;
+
+static atomic_uint hapCodecBufferNextThreadIndex = ATOMIC_VAR_INIT(0);
+static _Thread_local unsigned int hapCodecBufferThreadIndex = 0; // 0 means not yet assigned
+#endif
+
+/*
+ A pool holds a reference for its owner and one for each buffer which is out of it, so it can be destroyed while
+ buffers are still in use and is freed with the last of them.
+ */
+#if defined(__APPLE__)
+typedef volatile int32_t HapCodecBufferPoolReferences;
+#define HapCodecBufferPoolReferencesAdd(refs, amount) OSAtomicAdd32Barrier((amount), (refs))
+#elif defined(_WIN32)
+typedef volatile LONG HapCodecBufferPoolReferences;
+#define HapCodecBufferPoolReferencesAdd(refs, amount) (InterlockedExchangeAdd((refs), (amount)) + (amount))
+#else
+typedef atomic_int HapCodecBufferPoolReferences;
+#define HapCodecBufferPoolReferencesAdd(refs, amount) (atomic_fetch_add((refs), (amount)) + (amount))
 #endif
 
 typedef struct HapCodecBufferPool {
@@ -38,7 +90,11 @@ typedef struct HapCodecBufferPool {
     OSQueueHead             queue;
 #elif defined(_WIN32)
     PSLIST_HEADER           queue;
+#else
+    _Atomic uint64_t        head;
+    HapCodecBufferMagazine  magazines[kHapCodecBufferMagazineCount];
 #endif
+    HapCodecBufferPoolReferences references;
     long                    size;
 } HapCodecBufferPool;
 
@@ -47,6 +103,8 @@ typedef struct HapCodecBuffer {
     void                    *next;
 #elif defined(_WIN32)
     SLIST_ENTRY             itemEntry;
+#else
+    struct HapCodecBuffer   *next;
 #endif
     void                    *buffer;
     HapCodecBufferPoolRef   pool;
@@ -54,10 +112,22 @@ typedef struct HapCodecBuffer {
 
 HapCodecBufferPoolRef HapCodecBufferPoolCreate(long size)
 {
+#if defined(__APPLE__) || defined(_WIN32)
     HapCodecBufferPoolRef pool = (HapCodecBufferPoolRef)malloc(sizeof(HapCodecBufferPool));
+#else
+    // The magazines are only kept apart if the pool starts on a cache line
+    HapCodecBufferPoolRef pool;
+    if (posix_memalign((void **)&pool, 64, sizeof(HapCodecBufferPool)) != 0)
+        pool = NULL;
+#endif
     if (pool)
     {
         pool->size = size;
+#if defined(__APPLE__) || defined(_WIN32)
+        pool->references = 1;
+#else
+        atomic_init(&pool->references, 1);
+#endif
 #if defined(__APPLE__)
         pool->queue.opaque1 = NULL; // OS_ATOMIC_QUEUE_INIT
         pool->queue.opaque2 = 0; // OS_ATOMIC_QUEUE_INIT
@@ -72,17 +142,85 @@ HapCodecBufferPoolRef HapCodecBufferPoolCreate(long size)
         {
             InitializeSListHead(pool->queue);
         }
+#else
+        int i;
+        atomic_init(&pool->head, 0);
+        for (i = 0; i < kHapCodecBufferMagazineCount; i++)
+        {
+            atomic_flag_clear(&pool->magazines[i].busy);
+            pool->magazines[i].count = 0;
+        }
 #endif
     }
     return pool;
 }
 
+#if !defined(__APPLE__) && !defined(_WIN32)
+static HapCodecBufferMagazine *HapCodecBufferPoolGetMagazine(HapCodecBufferPoolRef pool)
+{
+    if (hapCodecBufferThreadIndex == 0)
+    {
+        hapCodecBufferThreadIndex = atomic_fetch_add_explicit(&hapCodecBufferNextThreadIndex, 1, memory_order_relaxed) + 1;
+    }
+    return &pool->magazines[hapCodecBufferThreadIndex % kHapCodecBufferMagazineCount];
+}
+
+static HapCodecBufferRef HapCodecBufferPoolPop(HapCodecBufferPoolRef pool)
+{
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_acquire);
+    HapCodecBufferRef buffer;
+    do {
+        buffer = (HapCodecBufferRef)(uintptr_t)(head & kHapCodecBufferPointerMask);
+        if (buffer == NULL)
+        {
+            break;
+        }
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head,
+                                                    &head,
+                                                    (head & ~kHapCodecBufferPointerMask) | (uintptr_t)buffer->next,
+                                                    memory_order_acquire,
+                                                    memory_order_acquire));
+    return buffer;
+}
+
+static void HapCodecBufferPoolPush(HapCodecBufferPoolRef pool, HapCodecBufferRef buffer)
+{
+    uint64_t head = atomic_load_explicit(&pool->head, memory_order_relaxed);
+    uint64_t tagged;
+    do {
+        buffer->next = (HapCodecBufferRef)(uintptr_t)(head & kHapCodecBufferPointerMask);
+        tagged = ((head | kHapCodecBufferPointerMask) + 1) | (uintptr_t)buffer;
+    } while (!atomic_compare_exchange_weak_explicit(&pool->head,
+                                                    &head,
+                                                    tagged,
+                                                    memory_order_release,
+                                                    memory_order_relaxed));
+}
+#endif
+
 static HapCodecBufferRef HapCodecBufferPoolTryCopyBuffer(HapCodecBufferPoolRef pool)
 {
 #if defined(__APPLE__)
     return OSAtomicDequeue(&pool->queue, offsetof(HapCodecBuffer, next));
 #elif defined(_WIN32)
     return (HapCodecBufferRef)InterlockedPopEntrySList(pool->queue);
+#else
+    HapCodecBufferRef buffer = NULL;
+    HapCodecBufferMagazine *magazine = HapCodecBufferPoolGetMagazine(pool);
+    if (!atomic_flag_test_and_set_explicit(&magazine->busy, memory_order_acquire))
+    {
+        if (magazine->count > 0)
+        {
+            magazine->count--;
+            buffer = magazine->buffers[magazine->count];
+        }
+        atomic_flag_clear_explicit(&magazine->busy, memory_order_release);
+    }
+    if (buffer == NULL)
+    {
+        buffer = HapCodecBufferPoolPop(pool);
+    }
+    return buffer;
 #endif
 }
 
@@ -94,26 +232,53 @@ static void HapCodecBufferDestroy(HapCodecBufferRef buffer)
 #elif defined(_WIN32)
     if (buffer->buffer) _aligned_free(buffer->buffer);
     _aligned_free(buffer);
+#else
+    free(buffer->buffer);
+    free(buffer);
 #endif
 }
 
-void HapCodecBufferPoolDestroy(HapCodecBufferPoolRef pool)
+static void HapCodecBufferPoolFree(HapCodecBufferPoolRef pool)
 {
-    if (pool)
+    HapCodecBufferRef buffer;
+#if !defined(__APPLE__) && !defined(_WIN32)
+    int i;
+    for (i = 0; i < kHapCodecBufferMagazineCount; i++)
     {
-        HapCodecBufferRef buffer;
-        do
+        while (pool->magazines[i].count > 0)
         {
-            buffer = HapCodecBufferPoolTryCopyBuffer(pool);
-            if (buffer)
-            {
-                HapCodecBufferDestroy(buffer);
-            }
-        } while (buffer != NULL);
+            pool->magazines[i].count--;
+            HapCodecBufferDestroy(pool->magazines[i].buffers[pool->magazines[i].count]);
+        }
+    }
+#endif
+    do
+    {
+        buffer = HapCodecBufferPoolTryCopyBuffer(pool);
+        if (buffer)
+        {
+            HapCodecBufferDestroy(buffer);
+        }
+    } while (buffer != NULL);
 #if defined(_WIN32)
-        _aligned_free(pool->queue);
+    _aligned_free(pool->queue);
 #endif
-        free(pool);
+    free(pool);
+}
+
+static void HapCodecBufferPoolRelease(HapCodecBufferPoolRef pool)
+{
+    if (HapCodecBufferPoolReferencesAdd(&pool->references, -1) == 0)
+    {
+        HapCodecBufferPoolFree(pool);
+    }
+}
+
+void HapCodecBufferPoolDestroy(HapCodecBufferPoolRef pool)
+{
+    if (pool)
+    {
+        HapCodecBufferPoolRelease(pool);
     }
 }
 
@@ -133,21 +298,29 @@ HapCodecBufferRef HapCodecBufferCreate(HapCodecBufferPoolRef pool)
 {
     if (pool)
     {
-        HapCodecBuffer *buffer = HapCodecBufferPoolTryCopyBuffer(pool);
+        HapCodecBuffer *buffer;
+        (void)HapCodecBufferPoolReferencesAdd(&pool->references, 1);
+        buffer = HapCodecBufferPoolTryCopyBuffer(pool);
         if (buffer == NULL)
         {
 #if defined(__APPLE__)
             buffer = malloc(sizeof(HapCodecBuffer));
 #elif defined(_WIN32)
             buffer = (HapCodecBufferRef)_aligned_malloc(sizeof(HapCodecBuffer), MEMORY_ALLOCATION_ALIGNMENT);
+#else
+            buffer = (HapCodecBufferRef)malloc(sizeof(HapCodecBuffer));
 #endif
             if (buffer)
             {
 #if defined(__APPLE__)
                 buffer->next = NULL;
                 buffer->buffer = malloc(pool->size);
-#else
+#elif defined(_WIN32)
                 buffer->buffer = (HapCodecBufferRef)_aligned_malloc(pool->size, 16);
+#else
+                buffer->next = NULL;
+                if (posix_memalign(&buffer->buffer, 16, pool->size) != 0)
+                    buffer->buffer = NULL;
 #endif
                 buffer->pool = pool;
                 if (buffer->buffer == NULL)
@@ -157,6 +330,10 @@ HapCodecBufferRef HapCodecBufferCreate(HapCodecBufferPoolRef pool)
                 }
             }
         }
+        if (buffer == NULL)
+        {
+            HapCodecBufferPoolRelease(pool);
+        }
         return buffer;
     }
     else
@@ -169,11 +346,29 @@ void HapCodecBufferReturn(HapCodecBufferRef buffer)
 {
     if (buffer && buffer->pool)
     {
+        HapCodecBufferPoolRef pool = buffer->pool;
 #if defined(__APPLE__)
-        OSAtomicEnqueue(&buffer->pool->queue, buffer, offsetof(HapCodecBuffer, next));
+        OSAtomicEnqueue(&pool->queue, buffer, offsetof(HapCodecBuffer, next));
 #elif defined(_WIN32)
-        InterlockedPushEntrySList(buffer->pool->queue, &(buffer->itemEntry));
+        InterlockedPushEntrySList(pool->queue, &(buffer->itemEntry));
+#else
+        HapCodecBufferMagazine *magazine = HapCodecBufferPoolGetMagazine(pool);
+        if (!atomic_flag_test_and_set_explicit(&magazine->busy, memory_order_acquire))
+        {
+            if (magazine->count < kHapCodecBufferMagazineCapacity)
+            {
+                magazine->buffers[magazine->count] = buffer;
+                magazine->count++;
+                buffer = NULL;
+            }
+            atomic_flag_clear_explicit(&magazine->busy, memory_order_release);
+        }
+        if (buffer)
+        {
+            HapCodecBufferPoolPush(pool, buffer);
+        }
 #endif
+        HapCodecBufferPoolRelease(pool);
     }
 }
 
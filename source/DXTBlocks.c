@@ -38,11 +38,11 @@ void HapCodecDXTReadBlockRGBA(const uint8_t *copy_src, uint8_t *copy_dst, unsign
     }
 }
 
-#if !defined(HAP_SSSE3_ALWAYS_AVAILABLE)
-
 #if defined(_WIN32)
+#include <intrin.h>
 #include <immintrin.h>
-#define hap_cpuid(i,t)    __cpuid((i),(t))
+#define hap_cpuid(i,t)    __cpuidex((i),(t),0)
+#define hap_xgetbv()      _xgetbv(0)
 
 #else
 
@@ -53,12 +53,54 @@ static void hap_cpuid(int info[4],int infoType){
                           "=b" (info[1]),
                           "=c" (info[2]),
                           "=d" (info[3]) :
-                          "a" (infoType)
+                          "a" (infoType),
+                          "c" (0)
+                          );
+}
+
+static unsigned long long hap_xgetbv(void){
+    unsigned int eax, edx;
+    __asm__ __volatile__ (
+                          "xgetbv":
+                          "=a" (eax),
+                          "=d" (edx) :
+                          "c" (0)
                           );
+    return ((unsigned long long)edx << 32) | eax;
 }
 
 #endif // !defined(_WIN32)
 
+int HapCodecHasSSE41(void)
+{
+    int info[4] = { 0, 0, 0, 0 };
+
+    hap_cpuid(info,0x00000001);
+    return (info[2] & ((int)1 << 19)) != 0;
+}
+
+int HapCodecHasAVX2(void)
+{
+    int info[4] = { 0, 0, 0, 0 };
+    int hasAVX, hasOSXSAVE;
+
+    hap_cpuid(info,0x00000001);
+    hasAVX = (info[2] & ((int)1 << 28)) != 0;
+    hasOSXSAVE = (info[2] & ((int)1 << 27)) != 0;
+    // The OS must save the YMM registers for us to use them
+    if (!hasAVX || !hasOSXSAVE || (hap_xgetbv() & 0x6) != 0x6)
+        return 0;
+
+    hap_cpuid(info,0x00000000);
+    if (info[0] < 7)
+        return 0;
+
+    hap_cpuid(info,0x00000007);
+    return (info[1] & ((int)1 << 5)) != 0;
+}
+
+#if !defined(HAP_SSSE3_ALWAYS_AVAILABLE)
+
 int HapCodecHasSSSE3(void)
 {
     int info[4] = { 0, 0, 0, 0 };
@@ -31,6 +31,13 @@
 #include "HapPlatform.h"
 #include <stdint.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+int HapCodecHasSSE41(void);
+int HapCodecHasAVX2(void);
+
 void HapCodecDXTReadBlockRGBA(const uint8_t *copy_src, uint8_t *copy_dst, unsigned int src_bytes_per_row);
 
 #if !defined(HAP_SSSE3_ALWAYS_AVAILABLE)
@@ -40,4 +47,8 @@ void HapCodecDXTReadBlockBGRAScalar(const uint8_t *copy_src, uint8_t *copy_dst,
 
 void HapCodecDXTReadBlockBGRASSSE3(const uint8_t *copy_src, uint8_t *copy_dst, unsigned int src_bytes_per_row);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
@@ -0,0 +1,235 @@
+/*
+ DXTDecodeAVX2.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DXTDecodeSIMD.h"
+#include <immintrin.h>
+
+// Looks up the alphas of two adjacent DXT5 or RGTC1 alpha blocks, or the lumas of YCoCg-DXT5 blocks, from their
+// palettes widened to pixels with the value in the alpha byte, putting them in the alpha byte of each pixel of the
+// four rows
+static HAP_INLINE void HapCodecDXTDecodeAlphaAVX2(__m256i palette_a, uint64_t indices_a, __m256i palette_b, uint64_t indices_b, __m256i *rows)
+{
+    const __m256i alpha_shifts = _mm256_setr_epi32(0, 3, 6, 9, 12, 15, 18, 21);
+    const __m256i three_bits = _mm256_set1_epi32(0x7);
+    int half;
+    for (half = 0; half < 2; half++)
+    {
+        // Two rows of one block, one row per lane
+        __m256i rows_a = _mm256_set1_epi32((int)((indices_a >> (24 * half)) & 0xFFFFFF));
+        __m256i rows_b = _mm256_set1_epi32((int)((indices_b >> (24 * half)) & 0xFFFFFF));
+        rows_a = _mm256_and_si256(_mm256_srlv_epi32(rows_a, alpha_shifts), three_bits);
+        rows_b = _mm256_and_si256(_mm256_srlv_epi32(rows_b, alpha_shifts), three_bits);
+        rows_a = _mm256_permutevar8x32_epi32(palette_a, rows_a);
+        rows_b = _mm256_permutevar8x32_epi32(palette_b, rows_b);
+        rows[half * 2] = _mm256_permute2x128_si256(rows_a, rows_b, 0x20);
+        rows[half * 2 + 1] = _mm256_permute2x128_si256(rows_a, rows_b, 0x31);
+    }
+}
+
+// An eight-entry alpha or luma palette widened to pixels with the value in the alpha byte
+static HAP_INLINE __m256i HapCodecDXTWidenAlphaPaletteAVX2(const uint8_t *palette)
+{
+    return _mm256_slli_epi32(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)palette)), 24);
+}
+
+// The alphas of two adjacent DXT5 or RGTC1 alpha blocks
+static HAP_INLINE void HapCodecDXTDecodeAlphaBlocksAVX2(const uint8_t *block_a, const uint8_t *block_b, __m256i *rows)
+{
+    uint8_t palette_a[8], palette_b[8];
+    HapCodecDXTAlphaPalette(block_a, palette_a);
+    HapCodecDXTAlphaPalette(block_b, palette_b);
+    HapCodecDXTDecodeAlphaAVX2(HapCodecDXTWidenAlphaPaletteAVX2(palette_a), HapCodecDXTAlphaIndices(block_a),
+                               HapCodecDXTWidenAlphaPaletteAVX2(palette_b), HapCodecDXTAlphaIndices(block_b),
+                               rows);
+}
+
+// Eight CoCg_Y pixels widened to 16 bits, converted as ConvertCoCg_Y8888ToRGB_() does but for alpha
+static HAP_INLINE __m256i HapCodecYCoCgDXTConvertAVX2(__m256i pixels, __m256i co_weights, __m256i cg_weights, __m256i bias)
+{
+    __m256i y = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m256i co = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(0, 0, 0, 0)), _MM_SHUFFLE(0, 0, 0, 0));
+    __m256i cg = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(pixels, _MM_SHUFFLE(1, 1, 1, 1)), _MM_SHUFFLE(1, 1, 1, 1));
+    return _mm256_add_epi16(_mm256_add_epi16(y, bias), _mm256_add_epi16(_mm256_mullo_epi16(co, co_weights), _mm256_mullo_epi16(cg, cg_weights)));
+}
+
+/*
+ Two horizontally adjacent blocks at a time, one per 128-bit lane, so each row of both blocks is one 32-byte
+ store. The two colour palettes fit one register and texels pick from them with a single variable permute,
+ as do the alphas from each block's eight-entry alpha palette. A trailing odd block is left to the SSE2 code.
+ */
+
+void HapCodecDXTDecodeBlocksAVX2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count, int dxt5, int bgra)
+{
+    const __m256i colour_shifts = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const __m256i second_block = _mm256_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4);
+    const __m256i two_bits = _mm256_set1_epi32(0x3);
+    const __m256i opaque = _mm256_set1_epi32((int)0xFF000000U);
+    const __m256i last_colour = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+    unsigned int bytes_per_block = dxt5 ? 16 : 8;
+    unsigned int colour_offset = dxt5 ? 8 : 0;
+    unsigned int pair_count = block_count / 2;
+    unsigned int i;
+    int row;
+
+    for (i = 0; i < pair_count; i++)
+    {
+        const uint8_t *colour_a = src + colour_offset;
+        const uint8_t *colour_b = src + bytes_per_block + colour_offset;
+        __m128i three_colour_a, three_colour_b;
+        __m256i colours, indices;
+        __m256i alpha[4];
+        uint8_t *dst_row = dst;
+
+        colours = _mm256_castsi128_si256(HapCodecDXTColourPaletteSSE2(colour_a, !dxt5, bgra, &three_colour_a));
+        colours = _mm256_inserti128_si256(colours, HapCodecDXTColourPaletteSSE2(colour_b, !dxt5, bgra, &three_colour_b), 1);
+        if (dxt5 == 0)
+        {
+            // Opaque, but for black in three-colour blocks
+            __m256i three_colour = _mm256_inserti128_si256(_mm256_castsi128_si256(three_colour_a), three_colour_b, 1);
+            colours = _mm256_or_si256(colours, _mm256_andnot_si256(_mm256_and_si256(three_colour, last_colour), opaque));
+        }
+        indices = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i *)colour_a)),
+                                          _mm_loadl_epi64((const __m128i *)colour_b),
+                                          1);
+        // Each lane holds its block's 32 bits of indices
+        indices = _mm256_shuffle_epi32(indices, _MM_SHUFFLE(1, 1, 1, 1));
+        indices = _mm256_srlv_epi32(indices, colour_shifts);
+
+        if (dxt5)
+        {
+            HapCodecDXTDecodeAlphaBlocksAVX2(src, src + bytes_per_block, alpha);
+        }
+        else
+        {
+            alpha[0] = alpha[1] = alpha[2] = alpha[3] = _mm256_setzero_si256();
+        }
+
+        for (row = 0; row < 4; row++)
+        {
+            __m256i selection = _mm256_or_si256(_mm256_and_si256(indices, two_bits), second_block);
+            __m256i texels = _mm256_permutevar8x32_epi32(colours, selection);
+            _mm256_storeu_si256((__m256i *)dst_row, _mm256_or_si256(texels, alpha[row]));
+            indices = _mm256_srli_epi32(indices, 8);
+            dst_row += dst_bytes_per_row;
+        }
+
+        src += bytes_per_block * 2;
+        dst += 32;
+    }
+
+    if (block_count & 1)
+    {
+        HapCodecDXTDecodeBlocksSSE2(src, dst, dst_bytes_per_row, 1, dxt5, bgra);
+    }
+}
+
+void HapCodecRGTC1DecodeBlocksAVX2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count)
+{
+    const __m256i colour_mask = _mm256_set1_epi32(0x00FFFFFF);
+    unsigned int pair_count = block_count / 2;
+    unsigned int i;
+    int row;
+
+    for (i = 0; i < pair_count; i++)
+    {
+        __m256i alpha[4];
+        uint8_t *dst_row = dst;
+        HapCodecDXTDecodeAlphaBlocksAVX2(src, src + 8, alpha);
+        for (row = 0; row < 4; row++)
+        {
+            __m256i texels = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)dst_row), colour_mask);
+            _mm256_storeu_si256((__m256i *)dst_row, _mm256_or_si256(texels, alpha[row]));
+            dst_row += dst_bytes_per_row;
+        }
+        src += 16;
+        dst += 32;
+    }
+
+    if (block_count & 1)
+    {
+        HapCodecRGTC1DecodeBlocksSSE2(src, dst, dst_bytes_per_row, 1);
+    }
+}
+
+void HapCodecYCoCgDXTDecodeBlocksAVX2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count, int bgra)
+{
+    const __m256i colour_shifts = _mm256_setr_epi32(0, 2, 4, 6, 0, 2, 4, 6);
+    const __m256i second_block = _mm256_setr_epi32(0, 0, 0, 0, 4, 4, 4, 4);
+    const __m256i two_bits = _mm256_set1_epi32(0x3);
+    const __m256i opaque = _mm256_set1_epi32((int)0xFF000000U);
+    // R = Y + Co - Cg, G = Y + Cg - 128, B = Y - Co - Cg + 256, with Co and Cg still biased by 128
+    const __m256i co_weights = bgra ? _mm256_setr_epi16(-1, 0, 1, 0, -1, 0, 1, 0, -1, 0, 1, 0, -1, 0, 1, 0)
+                                    : _mm256_setr_epi16(1, 0, -1, 0, 1, 0, -1, 0, 1, 0, -1, 0, 1, 0, -1, 0);
+    const __m256i cg_weights = _mm256_setr_epi16(-1, 1, -1, 0, -1, 1, -1, 0, -1, 1, -1, 0, -1, 1, -1, 0);
+    const __m256i bias = bgra ? _mm256_setr_epi16(256, -128, 0, 0, 256, -128, 0, 0, 256, -128, 0, 0, 256, -128, 0, 0)
+                              : _mm256_setr_epi16(0, -128, 256, 0, 0, -128, 256, 0, 0, -128, 256, 0, 0, -128, 256, 0);
+    unsigned int pair_count = block_count / 2;
+    unsigned int i;
+    int row;
+
+    for (i = 0; i < pair_count; i++)
+    {
+        uint8_t luma_palette_a[8], luma_palette_b[8];
+        __m256i chroma, indices;
+        __m256i luma[4];
+        uint8_t *dst_row = dst;
+
+        chroma = _mm256_castsi128_si256(HapCodecYCoCgDXTChromaPaletteSSE2(src));
+        chroma = _mm256_inserti128_si256(chroma, HapCodecYCoCgDXTChromaPaletteSSE2(src + 16), 1);
+        indices = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i *)(src + 8))),
+                                          _mm_loadl_epi64((const __m128i *)(src + 24)),
+                                          1);
+        indices = _mm256_shuffle_epi32(indices, _MM_SHUFFLE(1, 1, 1, 1));
+        indices = _mm256_srlv_epi32(indices, colour_shifts);
+
+        HapCodecYCoCgDXTLumaPalette(src, luma_palette_a);
+        HapCodecYCoCgDXTLumaPalette(src + 16, luma_palette_b);
+        HapCodecDXTDecodeAlphaAVX2(HapCodecDXTWidenAlphaPaletteAVX2(luma_palette_a), HapCodecDXTAlphaIndices(src),
+                                   HapCodecDXTWidenAlphaPaletteAVX2(luma_palette_b), HapCodecDXTAlphaIndices(src + 16),
+                                   luma);
+
+        for (row = 0; row < 4; row++)
+        {
+            __m256i selection = _mm256_or_si256(_mm256_and_si256(indices, two_bits), second_block);
+            __m256i texels = _mm256_or_si256(_mm256_permutevar8x32_epi32(chroma, selection), luma[row]);
+            __m256i lo = HapCodecYCoCgDXTConvertAVX2(_mm256_unpacklo_epi8(texels, _mm256_setzero_si256()), co_weights, cg_weights, bias);
+            __m256i hi = HapCodecYCoCgDXTConvertAVX2(_mm256_unpackhi_epi8(texels, _mm256_setzero_si256()), co_weights, cg_weights, bias);
+            // Unpacking and packing within lanes leaves the pixels in order
+            _mm256_storeu_si256((__m256i *)dst_row, _mm256_or_si256(_mm256_packus_epi16(lo, hi), opaque));
+            indices = _mm256_srli_epi32(indices, 8);
+            dst_row += dst_bytes_per_row;
+        }
+
+        src += 32;
+        dst += 32;
+    }
+
+    if (block_count & 1)
+    {
+        HapCodecYCoCgDXTDecodeBlocksSSE2(src, dst, dst_bytes_per_row, 1, bgra);
+    }
+}
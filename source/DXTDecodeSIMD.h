@@ -0,0 +1,187 @@
+/*
+ DXTDecodeSIMD.h
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HapCodec_DXTDecodeSIMD_h
+#define HapCodec_DXTDecodeSIMD_h
+
+#include "HapPlatform.h"
+#include <stdint.h>
+#include <emmintrin.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ Vectorised DXT1 and DXT5 decoders, selected at runtime. They decode block_count blocks from one row of blocks
+ straight to RGBA or BGRA pixels, writing whole 4x4 blocks at dst, and produce the same output as squish.
+ dxt5 selects DXT5 blocks with alpha, otherwise blocks are DXT1 colour blocks.
+
+ The RGTC1 decoders replace only the alpha of pixels already in dst with the decoded alpha.
+
+ The YCoCg-DXT5 decoders unscale CoCg and convert to RGB as they go, matching DeCompressYCoCgDXT5() followed
+ by ConvertCoCg_Y8888ToRGB_() or ConvertCoCg_Y8888ToBGR_(). Alpha is 255.
+
+ The per-block palette arithmetic below is shared by the vector implementations and follows squish's
+ DecompressColour() and DecompressAlphaDxt5(), including their integer truncation.
+ */
+
+void HapCodecDXTDecodeBlocksSSE2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count, int dxt5, int bgra);
+void HapCodecDXTDecodeBlocksAVX2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count, int dxt5, int bgra);
+void HapCodecRGTC1DecodeBlocksSSE2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count);
+void HapCodecRGTC1DecodeBlocksAVX2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count);
+void HapCodecYCoCgDXTDecodeBlocksSSE2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count, int bgra);
+void HapCodecYCoCgDXTDecodeBlocksAVX2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count, int bgra);
+
+/*
+ Builds the four colours of a colour block as RGBA or BGRA pixels with zero alpha. DXT1 blocks with
+ colour0 <= colour1 use three colours and black, and three_colour is set to all ones for them.
+ */
+static HAP_INLINE __m128i HapCodecDXTColourPaletteSSE2(const uint8_t *block, int dxt1, int bgra, __m128i *three_colour)
+{
+    unsigned int c0 = block[0] | (block[1] << 8);
+    unsigned int c1 = block[2] | (block[3] << 8);
+    __m128i endpoints = _mm_cvtsi32_si128((int)(c0 | (c1 << 16)));
+    __m128i mode = _mm_set1_epi16((short)((dxt1 && c0 <= c1) ? -1 : 0));
+    __m128i swapped, four, three, midpoints;
+
+    // 16-bit lanes c0 c0 c0 c0 c1 c1 c1 c1 expand to r0 g0 b0 0 r1 g1 b1 0, shifting with multiplies
+    endpoints = _mm_unpacklo_epi16(endpoints, endpoints);
+    endpoints = _mm_unpacklo_epi32(endpoints, endpoints);
+    endpoints = _mm_mullo_epi16(endpoints, _mm_setr_epi16(1, 32, 2048, 0, 1, 32, 2048, 0));
+    endpoints = _mm_mulhi_epu16(endpoints, _mm_setr_epi16(32, 64, 32, 0, 32, 64, 32, 0));
+    // (r << 3) | (r >> 2) is (r * 33) >> 2, and (g << 2) | (g >> 4) is (g * 65) >> 4
+    endpoints = _mm_mullo_epi16(endpoints, _mm_setr_epi16(33, 65, 33, 0, 33, 65, 33, 0));
+    endpoints = _mm_mulhi_epu16(endpoints, _mm_setr_epi16(1 << 14, 1 << 12, 1 << 14, 0, 1 << 14, 1 << 12, 1 << 14, 0));
+    if (bgra)
+    {
+        endpoints = _mm_shufflelo_epi16(endpoints, _MM_SHUFFLE(3, 0, 1, 2));
+        endpoints = _mm_shufflehi_epi16(endpoints, _MM_SHUFFLE(3, 0, 1, 2));
+    }
+
+    // (2 * c0 + c1) / 3 and (c0 + 2 * c1) / 3, dividing by 3 as (x * 0xAAAB) >> 17, which is exact for these sums
+    swapped = _mm_shuffle_epi32(endpoints, _MM_SHUFFLE(1, 0, 3, 2));
+    four = _mm_add_epi16(_mm_add_epi16(endpoints, endpoints), swapped);
+    four = _mm_srli_epi16(_mm_mulhi_epu16(four, _mm_set1_epi16((short)0xAAAB)), 1);
+    // (c0 + c1) / 2 and black
+    three = _mm_srli_epi16(_mm_add_epi16(endpoints, swapped), 1);
+    three = _mm_unpacklo_epi64(three, _mm_setzero_si128());
+    midpoints = _mm_xor_si128(four, _mm_and_si128(mode, _mm_xor_si128(four, three)));
+
+    *three_colour = mode;
+    return _mm_packus_epi16(endpoints, midpoints);
+}
+
+// Builds the eight alphas of a DXT5 or RGTC1 alpha block
+static HAP_INLINE void HapCodecDXTAlphaPalette(const uint8_t *block, uint8_t *palette)
+{
+    unsigned int a0 = block[0];
+    unsigned int a1 = block[1];
+    unsigned int i;
+    palette[0] = a0;
+    palette[1] = a1;
+    if (a0 <= a1)
+    {
+        for (i = 1; i < 5; i++)
+        {
+            palette[1 + i] = (uint8_t)(((5 - i) * a0 + i * a1) / 5);
+        }
+        palette[6] = 0;
+        palette[7] = 255;
+    }
+    else
+    {
+        for (i = 1; i < 7; i++)
+        {
+            palette[1 + i] = (uint8_t)(((7 - i) * a0 + i * a1) / 7);
+        }
+    }
+}
+
+// The 3-bit alpha indices of all sixteen texels, texel 0 in the lowest bits
+static HAP_INLINE uint64_t HapCodecDXTAlphaIndices(const uint8_t *block)
+{
+    uint64_t indices = 0;
+    int i;
+    for (i = 7; i > 1; i--)
+    {
+        indices = (indices << 8) | block[i];
+    }
+    return indices;
+}
+
+// Builds the eight lumas of a YCoCg-DXT5 block, which rounds unlike DXT5 alpha and has no six-value mode
+static HAP_INLINE void HapCodecYCoCgDXTLumaPalette(const uint8_t *block, uint8_t *palette)
+{
+    unsigned int l0 = block[0];
+    unsigned int l1 = block[1];
+    unsigned int i;
+    palette[0] = (uint8_t)l0;
+    palette[1] = (uint8_t)l1;
+    for (i = 1; i < 7; i++)
+    {
+        palette[1 + i] = (uint8_t)(((7 - i) * l0 + i * l1 + 3) / 7);
+    }
+}
+
+/*
+ Builds the four chroma values of a YCoCg-DXT5 block as pixels of Co and Cg with zero in the other bytes,
+ unscaled as RestoreChromaBlock() does.
+ */
+static HAP_INLINE __m128i HapCodecYCoCgDXTChromaPaletteSSE2(const uint8_t *block)
+{
+    const uint8_t *chroma = block + 8;
+    unsigned int c0 = chroma[0] | (chroma[1] << 8);
+    unsigned int c1 = chroma[2] | (chroma[3] << 8);
+    // The scale is stored as 0, 1 or 3 in colour0's blue bits, for shifts of 0, 1 and 2
+    __m128i scale = _mm_cvtsi32_si128((int)(((c0 & 0x1F) + 1) >> 1));
+    const __m128i bias = _mm_setr_epi16(128, 128, 0, 0, 128, 128, 0, 0);
+    __m128i endpoints = _mm_cvtsi32_si128((int)(c0 | (c1 << 16)));
+    __m128i swapped, midpoints;
+
+    // 16-bit lanes c0 c0 c0 c0 c1 c1 c1 c1 become Co0 Cg0 0 0 Co1 Cg1 0 0: (c >> 8) & 0xF8 and (c >> 3) & 0xFC
+    endpoints = _mm_unpacklo_epi16(endpoints, endpoints);
+    endpoints = _mm_unpacklo_epi32(endpoints, endpoints);
+    endpoints = _mm_mulhi_epu16(endpoints, _mm_setr_epi16(1 << 8, 1 << 13, 0, 0, 1 << 8, 1 << 13, 0, 0));
+    endpoints = _mm_and_si128(endpoints, _mm_setr_epi16(0xF8, 0xFC, 0, 0, 0xF8, 0xFC, 0, 0));
+
+    // (3 * c0 + c1) / 4 and (c0 + 3 * c1) / 4
+    swapped = _mm_shuffle_epi32(endpoints, _MM_SHUFFLE(1, 0, 3, 2));
+    midpoints = _mm_add_epi16(_mm_add_epi16(endpoints, endpoints), _mm_add_epi16(endpoints, swapped));
+    midpoints = _mm_srli_epi16(midpoints, 2);
+
+    // ((c - 128) >> scale) + 128
+    endpoints = _mm_add_epi16(_mm_sra_epi16(_mm_sub_epi16(endpoints, bias), scale), bias);
+    midpoints = _mm_add_epi16(_mm_sra_epi16(_mm_sub_epi16(midpoints, bias), scale), bias);
+    return _mm_packus_epi16(endpoints, midpoints);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
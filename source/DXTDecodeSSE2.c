@@ -0,0 +1,195 @@
+/*
+ DXTDecodeSSE2.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DXTDecodeSIMD.h"
+#include <emmintrin.h>
+
+// Looks up the alphas of a DXT5 or RGTC1 alpha block, or the lumas of a YCoCg-DXT5 block, from its palette,
+// putting them in the alpha byte of each pixel of the four rows
+static HAP_INLINE void HapCodecDXTDecodeAlphaSSE2(const uint8_t *palette, uint64_t indices, __m128i *rows)
+{
+    uint8_t texel_alpha[16];
+    __m128i alpha_lo, alpha_hi;
+    int t;
+    for (t = 0; t < 16; t++)
+    {
+        texel_alpha[t] = palette[indices & 0x7];
+        indices >>= 3;
+    }
+    // Interleaving with zeros twice puts each alpha in the top byte of its pixel
+    alpha_lo = _mm_loadu_si128((const __m128i *)texel_alpha);
+    alpha_hi = _mm_unpackhi_epi8(_mm_setzero_si128(), alpha_lo);
+    alpha_lo = _mm_unpacklo_epi8(_mm_setzero_si128(), alpha_lo);
+    rows[0] = _mm_unpacklo_epi16(_mm_setzero_si128(), alpha_lo);
+    rows[1] = _mm_unpackhi_epi16(_mm_setzero_si128(), alpha_lo);
+    rows[2] = _mm_unpacklo_epi16(_mm_setzero_si128(), alpha_hi);
+    rows[3] = _mm_unpackhi_epi16(_mm_setzero_si128(), alpha_hi);
+}
+
+// Two CoCg_Y pixels widened to 16 bits, converted as ConvertCoCg_Y8888ToRGB_() does but for alpha
+static HAP_INLINE __m128i HapCodecYCoCgDXTConvertSSE2(__m128i pixels, __m128i co_weights, __m128i cg_weights, __m128i bias)
+{
+    __m128i y = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    __m128i co = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(0, 0, 0, 0)), _MM_SHUFFLE(0, 0, 0, 0));
+    __m128i cg = _mm_shufflehi_epi16(_mm_shufflelo_epi16(pixels, _MM_SHUFFLE(1, 1, 1, 1)), _MM_SHUFFLE(1, 1, 1, 1));
+    return _mm_add_epi16(_mm_add_epi16(y, bias), _mm_add_epi16(_mm_mullo_epi16(co, co_weights), _mm_mullo_epi16(cg, cg_weights)));
+}
+
+/*
+ One block at a time. Each row of four texels picks its colours from the palette with masks made by testing
+ the two bits of each texel's index. DXT5 alphas are looked up per texel and moved into the alpha byte.
+ */
+
+void HapCodecDXTDecodeBlocksSSE2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count, int dxt5, int bgra)
+{
+    const __m128i bit0 = _mm_setr_epi32(0x01, 0x04, 0x10, 0x40);
+    const __m128i bit1 = _mm_setr_epi32(0x02, 0x08, 0x20, 0x80);
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000U);
+    const __m128i last_colour = _mm_setr_epi32(0, 0, 0, -1);
+    unsigned int bytes_per_block = dxt5 ? 16 : 8;
+    unsigned int i;
+    int row;
+
+    for (i = 0; i < block_count; i++)
+    {
+        const uint8_t *colour_block = dxt5 ? src + 8 : src;
+        __m128i three_colour, palette, c0, c2, d01, d23, indices;
+        __m128i alpha[4];
+        uint8_t *dst_row = dst;
+
+        palette = HapCodecDXTColourPaletteSSE2(colour_block, !dxt5, bgra, &three_colour);
+        if (dxt5 == 0)
+        {
+            // Opaque, but for black in three-colour blocks
+            palette = _mm_or_si128(palette, _mm_andnot_si128(_mm_and_si128(three_colour, last_colour), opaque));
+        }
+        // Selecting with xor avoids and-not: c0 ^ ((c0 ^ c1) & mask) is c1 where mask is set
+        c0 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(0, 0, 0, 0));
+        c2 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(2, 2, 2, 2));
+        d01 = _mm_xor_si128(c0, _mm_shuffle_epi32(palette, _MM_SHUFFLE(1, 1, 1, 1)));
+        d23 = _mm_xor_si128(c2, _mm_shuffle_epi32(palette, _MM_SHUFFLE(3, 3, 3, 3)));
+        indices = _mm_shuffle_epi32(_mm_loadl_epi64((const __m128i *)colour_block), _MM_SHUFFLE(1, 1, 1, 1));
+
+        if (dxt5)
+        {
+            uint8_t alpha_palette[8];
+            HapCodecDXTAlphaPalette(src, alpha_palette);
+            HapCodecDXTDecodeAlphaSSE2(alpha_palette, HapCodecDXTAlphaIndices(src), alpha);
+        }
+        else
+        {
+            alpha[0] = alpha[1] = alpha[2] = alpha[3] = _mm_setzero_si128();
+        }
+
+        for (row = 0; row < 4; row++)
+        {
+            __m128i m0 = _mm_cmpeq_epi32(_mm_and_si128(indices, bit0), bit0);
+            __m128i m1 = _mm_cmpeq_epi32(_mm_and_si128(indices, bit1), bit1);
+            __m128i lo = _mm_xor_si128(c0, _mm_and_si128(m0, d01));
+            __m128i hi = _mm_xor_si128(c2, _mm_and_si128(m0, d23));
+            __m128i texels = _mm_xor_si128(lo, _mm_and_si128(m1, _mm_xor_si128(lo, hi)));
+            _mm_storeu_si128((__m128i *)dst_row, _mm_or_si128(texels, alpha[row]));
+            indices = _mm_srli_epi32(indices, 8);
+            dst_row += dst_bytes_per_row;
+        }
+
+        src += bytes_per_block;
+        dst += 16;
+    }
+}
+
+void HapCodecRGTC1DecodeBlocksSSE2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count)
+{
+    const __m128i colour_mask = _mm_set1_epi32(0x00FFFFFF);
+    unsigned int i;
+    int row;
+
+    for (i = 0; i < block_count; i++)
+    {
+        uint8_t alpha_palette[8];
+        __m128i alpha[4];
+        uint8_t *dst_row = dst;
+        HapCodecDXTAlphaPalette(src, alpha_palette);
+        HapCodecDXTDecodeAlphaSSE2(alpha_palette, HapCodecDXTAlphaIndices(src), alpha);
+        for (row = 0; row < 4; row++)
+        {
+            __m128i texels = _mm_and_si128(_mm_loadu_si128((const __m128i *)dst_row), colour_mask);
+            _mm_storeu_si128((__m128i *)dst_row, _mm_or_si128(texels, alpha[row]));
+            dst_row += dst_bytes_per_row;
+        }
+        src += 8;
+        dst += 16;
+    }
+}
+
+void HapCodecYCoCgDXTDecodeBlocksSSE2(const uint8_t *src, uint8_t *dst, unsigned int dst_bytes_per_row, unsigned int block_count, int bgra)
+{
+    const __m128i bit0 = _mm_setr_epi32(0x01, 0x04, 0x10, 0x40);
+    const __m128i bit1 = _mm_setr_epi32(0x02, 0x08, 0x20, 0x80);
+    const __m128i opaque = _mm_set1_epi32((int)0xFF000000U);
+    // R = Y + Co - Cg, G = Y + Cg - 128, B = Y - Co - Cg + 256, with Co and Cg still biased by 128
+    const __m128i co_weights = bgra ? _mm_setr_epi16(-1, 0, 1, 0, -1, 0, 1, 0) : _mm_setr_epi16(1, 0, -1, 0, 1, 0, -1, 0);
+    const __m128i cg_weights = _mm_setr_epi16(-1, 1, -1, 0, -1, 1, -1, 0);
+    const __m128i bias = bgra ? _mm_setr_epi16(256, -128, 0, 0, 256, -128, 0, 0) : _mm_setr_epi16(0, -128, 256, 0, 0, -128, 256, 0);
+    unsigned int i;
+    int row;
+
+    for (i = 0; i < block_count; i++)
+    {
+        uint8_t luma_palette[8];
+        __m128i palette, c0, c2, d01, d23, indices;
+        __m128i luma[4];
+        uint8_t *dst_row = dst;
+
+        palette = HapCodecYCoCgDXTChromaPaletteSSE2(src);
+        c0 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(0, 0, 0, 0));
+        c2 = _mm_shuffle_epi32(palette, _MM_SHUFFLE(2, 2, 2, 2));
+        d01 = _mm_xor_si128(c0, _mm_shuffle_epi32(palette, _MM_SHUFFLE(1, 1, 1, 1)));
+        d23 = _mm_xor_si128(c2, _mm_shuffle_epi32(palette, _MM_SHUFFLE(3, 3, 3, 3)));
+        indices = _mm_shuffle_epi32(_mm_loadl_epi64((const __m128i *)(src + 8)), _MM_SHUFFLE(1, 1, 1, 1));
+
+        HapCodecYCoCgDXTLumaPalette(src, luma_palette);
+        HapCodecDXTDecodeAlphaSSE2(luma_palette, HapCodecDXTAlphaIndices(src), luma);
+
+        for (row = 0; row < 4; row++)
+        {
+            __m128i m0 = _mm_cmpeq_epi32(_mm_and_si128(indices, bit0), bit0);
+            __m128i m1 = _mm_cmpeq_epi32(_mm_and_si128(indices, bit1), bit1);
+            __m128i lo = _mm_xor_si128(c0, _mm_and_si128(m0, d01));
+            __m128i hi = _mm_xor_si128(c2, _mm_and_si128(m0, d23));
+            __m128i texels = _mm_or_si128(_mm_xor_si128(lo, _mm_and_si128(m1, _mm_xor_si128(lo, hi))), luma[row]);
+            lo = HapCodecYCoCgDXTConvertSSE2(_mm_unpacklo_epi8(texels, _mm_setzero_si128()), co_weights, cg_weights, bias);
+            hi = HapCodecYCoCgDXTConvertSSE2(_mm_unpackhi_epi8(texels, _mm_setzero_si128()), co_weights, cg_weights, bias);
+            _mm_storeu_si128((__m128i *)dst_row, _mm_or_si128(_mm_packus_epi16(lo, hi), opaque));
+            indices = _mm_srli_epi32(indices, 8);
+            dst_row += dst_bytes_per_row;
+        }
+
+        src += 16;
+        dst += 16;
+    }
+}
@@ -28,7 +28,11 @@
 #ifndef HapCodec_DXTEncoder_h
 #define HapCodec_DXTEncoder_h
 
+#if defined(__APPLE__) || defined(_WIN32)
 #include <MacTypes.h>
+#else
+#include "HapPlatform.h"
+#endif
 
 /*
  An encoder is simply a pointer to a struct which provides functions for the codec to call
@@ -0,0 +1,384 @@
+/*
+ DXTScaledDecoder.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "DXTScaledDecoder.h"
+#include "HapPlatform.h"
+#include "DXTBlocks.h"
+#include "DXTDecodeSIMD.h"
+#include "ParallelLoops.h"
+#include <stdint.h>
+#include <string.h>
+
+// Bands of block rows are decoded in parallel
+#define kHapCodecDXTScaledDecodeMaxSliceCount 30U
+
+// Where blocks have to be decoded to pixels, this many are decoded at a time
+#define kHapCodecDXTScaledDecodeStripLength 64U
+#define kHapCodecDXTScaledDecodeStripBytesPerRow (kHapCodecDXTScaledDecodeStripLength * 16U)
+
+typedef struct HapCodecDXTScaledDecodeTask {
+    const uint8_t   *src;
+    unsigned int    src_pixel_format;
+    const uint8_t   *alpha;
+    uint8_t         *dst;
+    unsigned int    dst_bytes_per_row;
+    unsigned int    block_count;
+    unsigned int    block_rows;
+    unsigned int    scale;
+    unsigned int    slice_rows; // even at 1/8 so a slice never splits a pair of rows
+    int             bgra;
+    int             has_avx2;
+} HapCodecDXTScaledDecodeTask;
+
+// The number of times each 2-bit colour index appears in a byte of indices, as four byte-sized counts
+#define HapCodecDXTScaledColourCount(b) ((1U << (8 * ((b) & 3))) + (1U << (8 * (((b) >> 2) & 3))) + (1U << (8 * (((b) >> 4) & 3))) + (1U << (8 * (((b) >> 6) & 3))))
+#define HapCodecDXTScaledColourCount4(b) HapCodecDXTScaledColourCount(b), HapCodecDXTScaledColourCount(b + 1), HapCodecDXTScaledColourCount(b + 2), HapCodecDXTScaledColourCount(b + 3)
+#define HapCodecDXTScaledColourCount16(b) HapCodecDXTScaledColourCount4(b), HapCodecDXTScaledColourCount4(b + 4), HapCodecDXTScaledColourCount4(b + 8), HapCodecDXTScaledColourCount4(b + 12)
+#define HapCodecDXTScaledColourCount64(b) HapCodecDXTScaledColourCount16(b), HapCodecDXTScaledColourCount16(b + 16), HapCodecDXTScaledColourCount16(b + 32), HapCodecDXTScaledColourCount16(b + 48)
+
+static const uint32_t kHapCodecDXTScaledColourCounts[256] = {
+    HapCodecDXTScaledColourCount64(0), HapCodecDXTScaledColourCount64(64), HapCodecDXTScaledColourCount64(128), HapCodecDXTScaledColourCount64(192)
+};
+
+// The number of times each 3-bit alpha index appears in six bits of indices, as eight byte-sized counts
+#define HapCodecDXTScaledAlphaCount(b) ((1ULL << (8 * ((b) & 7))) + (1ULL << (8 * (((b) >> 3) & 7))))
+#define HapCodecDXTScaledAlphaCount4(b) HapCodecDXTScaledAlphaCount(b), HapCodecDXTScaledAlphaCount(b + 1), HapCodecDXTScaledAlphaCount(b + 2), HapCodecDXTScaledAlphaCount(b + 3)
+#define HapCodecDXTScaledAlphaCount16(b) HapCodecDXTScaledAlphaCount4(b), HapCodecDXTScaledAlphaCount4(b + 4), HapCodecDXTScaledAlphaCount4(b + 8), HapCodecDXTScaledAlphaCount4(b + 12)
+
+static const uint64_t kHapCodecDXTScaledAlphaCounts[64] = {
+    HapCodecDXTScaledAlphaCount16(0), HapCodecDXTScaledAlphaCount16(16), HapCodecDXTScaledAlphaCount16(32), HapCodecDXTScaledAlphaCount16(48)
+};
+
+// The sum of the sixteen alphas of a DXT5 or RGTC1 alpha block, from its palette weighted by how often each index is used
+static HAP_INLINE unsigned int HapCodecDXTScaledAlphaSum(const uint8_t *block)
+{
+    uint8_t palette[8];
+    uint64_t indices = HapCodecDXTAlphaIndices(block);
+    uint64_t counts = 0;
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum;
+    int i;
+    HapCodecDXTAlphaPalette(block, palette);
+    for (i = 0; i < 8; i++)
+    {
+        counts += kHapCodecDXTScaledAlphaCounts[indices & 0x3F];
+        indices >>= 6;
+    }
+    sum = _mm_madd_epi16(_mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)palette), zero),
+                         _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)&counts), zero));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return (unsigned int)_mm_cvtsi128_si32(sum);
+}
+
+/*
+ The sums of each channel of the sixteen pixels of a colour block in the low four 16-bit lanes, found by weighting
+ its palette by the number of times each index is used. DXT1 blocks are opaque, except for the black of three-colour
+ blocks; otherwise alpha is zero.
+ */
+static HAP_INLINE __m128i HapCodecDXTScaledColourSumSSE2(const uint8_t *block, int dxt1, int bgra)
+{
+    __m128i three_colour;
+    __m128i palette = HapCodecDXTColourPaletteSSE2(block, dxt1, bgra, &three_colour);
+    __m128i counts = _mm_cvtsi32_si128((int)(kHapCodecDXTScaledColourCounts[block[4]] + kHapCodecDXTScaledColourCounts[block[5]] +
+                                             kHapCodecDXTScaledColourCounts[block[6]] + kHapCodecDXTScaledColourCounts[block[7]]));
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum;
+
+    if (dxt1)
+    {
+        const int opaque = (int)0xFF000000U;
+        palette = _mm_or_si128(palette, _mm_setr_epi32(opaque, opaque, opaque, _mm_cvtsi128_si32(three_colour) ? 0 : opaque));
+    }
+
+    // Counts n0 n1 n2 n3 become n0 n0 n0 n0 n1 n1 n1 n1 and n2 n2 n2 n2 n3 n3 n3 n3
+    counts = _mm_unpacklo_epi8(counts, zero);
+    counts = _mm_unpacklo_epi16(counts, counts);
+    sum = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(palette, zero), _mm_unpacklo_epi32(counts, counts)),
+                        _mm_mullo_epi16(_mm_unpackhi_epi8(palette, zero), _mm_unpackhi_epi32(counts, counts)));
+    return _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+}
+
+// The sums of each channel of a block, from its palettes
+static HAP_INLINE __m128i HapCodecDXTScaledBlockSumSSE2(const HapCodecDXTScaledDecodeTask *task, size_t block_index)
+{
+    __m128i sum = _mm_setzero_si128();
+    if (task->src)
+    {
+        if (task->src_pixel_format == kHapCVPixelFormat_RGB_DXT1)
+        {
+            sum = HapCodecDXTScaledColourSumSSE2(task->src + (block_index * 8), 1, task->bgra);
+        }
+        else
+        {
+            const uint8_t *block = task->src + (block_index * 16);
+            sum = HapCodecDXTScaledColourSumSSE2(block + 8, 0, task->bgra);
+            sum = _mm_insert_epi16(sum, (int)HapCodecDXTScaledAlphaSum(block), 3);
+        }
+    }
+    if (task->alpha)
+    {
+        sum = _mm_insert_epi16(sum, (int)HapCodecDXTScaledAlphaSum(task->alpha + (block_index * 8)), 3);
+    }
+    return sum;
+}
+
+// The sums of each channel of a 4x4 block of pixels
+static HAP_INLINE __m128i HapCodecDXTScaledPixelSumSSE2(const uint8_t *pixels, unsigned int bytes_per_row)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = zero;
+    int y;
+    for (y = 0; y < 4; y++)
+    {
+        __m128i row = _mm_load_si128((const __m128i *)(pixels + (bytes_per_row * y)));
+        sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_unpacklo_epi8(row, zero), _mm_unpackhi_epi8(row, zero)));
+    }
+    return _mm_add_epi16(sum, _mm_srli_si128(sum, 8));
+}
+
+// Writes the rounded mean of 1 << shift pixels whose sums are in the low four lanes of sum
+static HAP_INLINE void HapCodecDXTScaledStorePixel(uint8_t *dst, __m128i sum, unsigned int shift, int alpha_only)
+{
+    __m128i mean = _mm_srl_epi16(_mm_add_epi16(sum, _mm_set1_epi16((short)(1 << (shift - 1)))), _mm_cvtsi32_si128((int)shift));
+    uint32_t pixel = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(mean, mean));
+    if (alpha_only)
+    {
+        dst[3] = (uint8_t)(pixel >> 24);
+    }
+    else
+    {
+        memcpy(dst, &pixel, 4);
+    }
+}
+
+// Decodes count blocks of a row of blocks to a strip four pixels high
+static void HapCodecDXTScaledDecodeStrip(const HapCodecDXTScaledDecodeTask *task, size_t block_index, unsigned int count, uint8_t *strip)
+{
+    if (task->src)
+    {
+        switch (task->src_pixel_format)
+        {
+            case kHapCVPixelFormat_RGB_DXT1:
+            case kHapCVPixelFormat_RGBA_DXT5:
+            {
+                int dxt5 = (task->src_pixel_format == kHapCVPixelFormat_RGBA_DXT5 ? 1 : 0);
+                const uint8_t *src = task->src + (block_index * (dxt5 ? 16 : 8));
+                if (task->has_avx2)
+                {
+                    HapCodecDXTDecodeBlocksAVX2(src, strip, kHapCodecDXTScaledDecodeStripBytesPerRow, count, dxt5, task->bgra);
+                }
+                else
+                {
+                    HapCodecDXTDecodeBlocksSSE2(src, strip, kHapCodecDXTScaledDecodeStripBytesPerRow, count, dxt5, task->bgra);
+                }
+                break;
+            }
+            case kHapCVPixelFormat_YCoCg_DXT5:
+                if (task->has_avx2)
+                {
+                    HapCodecYCoCgDXTDecodeBlocksAVX2(task->src + (block_index * 16), strip, kHapCodecDXTScaledDecodeStripBytesPerRow, count, task->bgra);
+                }
+                else
+                {
+                    HapCodecYCoCgDXTDecodeBlocksSSE2(task->src + (block_index * 16), strip, kHapCodecDXTScaledDecodeStripBytesPerRow, count, task->bgra);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    if (task->alpha)
+    {
+        if (task->has_avx2)
+        {
+            HapCodecRGTC1DecodeBlocksAVX2(task->alpha + (block_index * 8), strip, kHapCodecDXTScaledDecodeStripBytesPerRow, count);
+        }
+        else
+        {
+            HapCodecRGTC1DecodeBlocksSSE2(task->alpha + (block_index * 8), strip, kHapCodecDXTScaledDecodeStripBytesPerRow, count);
+        }
+    }
+}
+
+static void HapCodecDXTScaledDecodeSlice(void *p, unsigned int index)
+{
+    HapCodecDXTScaledDecodeTask *task = (HapCodecDXTScaledDecodeTask *)p;
+    HAP_ALIGN_16 uint8_t strip[kHapCodecDXTScaledDecodeStripBytesPerRow * 4];
+    __m128i sums[2][kHapCodecDXTScaledDecodeStripLength];
+    unsigned int first_row = index * task->slice_rows;
+    unsigned int last_row = first_row + task->slice_rows;
+    unsigned int rows_per_group = (task->scale == 8 ? 2 : 1);
+    int alpha_only = (task->src == NULL);
+    // Only YCoCg and 1/2 need pixels decoded
+    int from_palettes = (task->scale != 2 && (task->src == NULL || task->src_pixel_format != kHapCVPixelFormat_YCoCg_DXT5));
+    unsigned int row;
+
+    if (last_row > task->block_rows)
+    {
+        last_row = task->block_rows;
+    }
+    // Without colour only alpha is read back from the strip, but keep the rest defined
+    memset(strip, 0, sizeof(strip));
+
+    for (row = first_row; row < last_row; row += rows_per_group)
+    {
+        unsigned int group_rows = (last_row - row < rows_per_group ? last_row - row : rows_per_group);
+        unsigned int column;
+        for (column = 0; column < task->block_count; column += kHapCodecDXTScaledDecodeStripLength)
+        {
+            unsigned int count = task->block_count - column;
+            unsigned int r, i;
+            if (count > kHapCodecDXTScaledDecodeStripLength)
+            {
+                count = kHapCodecDXTScaledDecodeStripLength;
+            }
+            for (r = 0; r < group_rows; r++)
+            {
+                size_t block_index = ((size_t)(row + r) * task->block_count) + column;
+                if (from_palettes)
+                {
+                    for (i = 0; i < count; i++)
+                    {
+                        sums[r][i] = HapCodecDXTScaledBlockSumSSE2(task, block_index + i);
+                    }
+                    continue;
+                }
+                HapCodecDXTScaledDecodeStrip(task, block_index, count, strip);
+                if (task->scale == 2)
+                {
+                    // Each block becomes 2x2 pixels, each the mean of 2x2 pixels
+                    const __m128i zero = _mm_setzero_si128();
+                    for (i = 0; i < count; i++)
+                    {
+                        unsigned int k;
+                        for (k = 0; k < 2; k++)
+                        {
+                            const uint8_t *pixels = strip + (kHapCodecDXTScaledDecodeStripBytesPerRow * k * 2) + (i * 16);
+                            uint8_t *dst = task->dst + ((size_t)task->dst_bytes_per_row * ((row * 2) + k)) + ((column + i) * 8);
+                            __m128i a = _mm_load_si128((const __m128i *)pixels);
+                            __m128i b = _mm_load_si128((const __m128i *)(pixels + kHapCodecDXTScaledDecodeStripBytesPerRow));
+                            __m128i left = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+                            __m128i right = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+                            __m128i sum = _mm_add_epi16(_mm_unpacklo_epi64(left, right), _mm_unpackhi_epi64(left, right));
+                            sum = _mm_srli_epi16(_mm_add_epi16(sum, _mm_set1_epi16(2)), 2);
+                            sum = _mm_packus_epi16(sum, sum);
+                            if (alpha_only)
+                            {
+                                uint8_t pair[8];
+                                _mm_storel_epi64((__m128i *)pair, sum);
+                                dst[3] = pair[3];
+                                dst[7] = pair[7];
+                            }
+                            else
+                            {
+                                _mm_storel_epi64((__m128i *)dst, sum);
+                            }
+                        }
+                    }
+                }
+                else
+                {
+                    for (i = 0; i < count; i++)
+                    {
+                        sums[r][i] = HapCodecDXTScaledPixelSumSSE2(strip + (i * 16), kHapCodecDXTScaledDecodeStripBytesPerRow);
+                    }
+                }
+            }
+
+            if (task->scale == 4)
+            {
+                uint8_t *dst = task->dst + ((size_t)task->dst_bytes_per_row * row) + (column * 4);
+                for (i = 0; i < count; i++)
+                {
+                    HapCodecDXTScaledStorePixel(dst + (i * 4), sums[0][i], 4, alpha_only);
+                }
+            }
+            else if (task->scale == 8)
+            {
+                // Pairs of rows and columns of blocks, or what there is of them at the edges
+                uint8_t *dst = task->dst + ((size_t)task->dst_bytes_per_row * (row / 2)) + ((column / 2) * 4);
+                for (i = 0; i < count; i += 2)
+                {
+                    __m128i sum = sums[0][i];
+                    unsigned int shift = 4;
+                    if (i + 1 < count)
+                    {
+                        sum = _mm_add_epi16(sum, sums[0][i + 1]);
+                        shift++;
+                    }
+                    if (group_rows == 2)
+                    {
+                        sum = _mm_add_epi16(sum, sums[1][i]);
+                        if (i + 1 < count)
+                        {
+                            sum = _mm_add_epi16(sum, sums[1][i + 1]);
+                        }
+                        shift++;
+                    }
+                    HapCodecDXTScaledStorePixel(dst + ((i / 2) * 4), sum, shift, alpha_only);
+                }
+            }
+        }
+    }
+}
+
+void HapCodecDXTDecodeScaled(const void *src,
+                             unsigned int src_pixel_format,
+                             const void *alpha,
+                             void *dst,
+                             unsigned int dst_pixel_format,
+                             unsigned int dst_bytes_per_row,
+                             unsigned int width,
+                             unsigned int height,
+                             unsigned int scale)
+{
+    HapCodecDXTScaledDecodeTask task;
+    unsigned int slice_count;
+    task.block_count = (width + 3) / 4;
+    task.block_rows = (height + 3) / 4;
+    if (task.block_count == 0 || task.block_rows == 0 || (scale != 2 && scale != 4 && scale != 8) || (src == NULL && alpha == NULL))
+    {
+        return;
+    }
+    task.src = (const uint8_t *)src;
+    task.src_pixel_format = src_pixel_format;
+    task.alpha = (const uint8_t *)alpha;
+    task.dst = (uint8_t *)dst;
+    task.dst_bytes_per_row = dst_bytes_per_row;
+    task.scale = scale;
+    task.bgra = (dst_pixel_format == kHapCVPixelFormat_RGBA ? 0 : 1);
+    task.has_avx2 = HapCodecHasAVX2();
+    slice_count = task.block_rows < kHapCodecDXTScaledDecodeMaxSliceCount ? task.block_rows : kHapCodecDXTScaledDecodeMaxSliceCount;
+    task.slice_rows = (task.block_rows + slice_count - 1) / slice_count;
+    if (scale == 8)
+    {
+        task.slice_rows = (task.slice_rows + 1) & ~1U;
+    }
+    slice_count = (task.block_rows + task.slice_rows - 1) / task.slice_rows;
+    HapParallelFor(HapCodecDXTScaledDecodeSlice, &task, slice_count);
+}
@@ -0,0 +1,57 @@
+/*
+ DXTScaledDecoder.h
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HapCodec_DXTScaledDecoder_h
+#define HapCodec_DXTScaledDecoder_h
+
+#include "PixelFormats.h"
+
+/*
+ Decodes a texture to RGBA or BGRA at 1/scale of its size, where scale is 2, 4 or 8, in parallel bands. Each pixel
+ written is the mean of the scale x scale pixels it covers in a full decode, rounded to nearest, without a full-size
+ image being made. At 1/4 and 1/8 the means of DXT1, DXT5 and RGTC1 blocks are found from their palettes and a count
+ of their indices, without decoding any pixels.
+
+ src_pixel_format is kHapCVPixelFormat_RGB_DXT1, kHapCVPixelFormat_RGBA_DXT5 or kHapCVPixelFormat_YCoCg_DXT5. If alpha
+ is non-NULL it is an RGTC1 texture which replaces the alpha of the colour. src may be NULL, in which case only the alpha
+ of dst is written.
+
+ The whole blocks of the texture are scaled, so ((width + 3) / 4) * 4 / scale pixels, rounded up, are written to each
+ of ((height + 3) / 4) * 4 / scale rows, rounded up. Where the blocks don't divide evenly at 1/8, pixels on the right
+ and bottom edges are the mean of the blocks there are.
+ */
+void HapCodecDXTDecodeScaled(const void *src,
+                             unsigned int src_pixel_format,
+                             const void *alpha,
+                             void *dst,
+                             unsigned int dst_pixel_format,
+                             unsigned int dst_bytes_per_row,
+                             unsigned int width,
+                             unsigned int height,
+                             unsigned int scale);
+
+#endif
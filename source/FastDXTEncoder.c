@@ -0,0 +1,351 @@
+/*
+ FastDXTEncoder.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "FastDXTEncoder.h"
+#include "PixelFormats.h"
+#include "HapPlatform.h"
+#include <emmintrin.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+/*
+ Each block's colour endpoints are the corners of its bounding box, inset by a sixteenth of its size so the
+ endpoints sit nearer the texels than the extremes do. The box's diagonal is chosen to follow the sign of the
+ covariance of red and blue with green. Every texel is then assigned to its nearest palette entry.
+ 
+ This uses only SSE2, so needs no runtime checks.
+ */
+
+#define kHapCodecFastDXTInsetShift 4
+#define kHapCodecFastDXTAlphaInsetShift 5
+
+struct HapCodecFastDXTEncoder {
+    struct HapCodecDXTEncoder base;
+    int alpha;
+};
+
+static void HapCodecFastDXTEncoderDestroy(HapCodecDXTEncoderRef encoder)
+{
+    free(encoder);
+}
+
+// Spreads the low 16 bits of v to the even bits of the result
+static HAP_INLINE uint32_t HapCodecFastDXTSpreadBits(uint32_t v)
+{
+    v = (v | (v << 8)) & 0x00FF00FF;
+    v = (v | (v << 4)) & 0x0F0F0F0F;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+// The sum of the absolute differences of the three colour channels of each texel
+static HAP_INLINE __m128i HapCodecFastDXTDistance(__m128i texels, __m128i colour)
+{
+    const __m128i byteMask = _mm_set1_epi32(0xFF);
+    __m128i d = _mm_or_si128(_mm_subs_epu8(texels, colour), _mm_subs_epu8(colour, texels));
+    return _mm_add_epi32(_mm_add_epi32(_mm_and_si128(d, byteMask),
+                                       _mm_and_si128(_mm_srli_epi32(d, 8), byteMask)),
+                         _mm_and_si128(_mm_srli_epi32(d, 16), byteMask));
+}
+
+// Packs the low bits of 16 32-bit masks, one per texel, to a 16-bit mask
+static HAP_INLINE unsigned int HapCodecFastDXTMovemask(const __m128i *masks)
+{
+    return (unsigned int)_mm_movemask_epi8(_mm_packs_epi16(_mm_packs_epi32(masks[0], masks[1]),
+                                                           _mm_packs_epi32(masks[2], masks[3])));
+}
+
+static HAP_INLINE unsigned int HapCodecFastDXTTo565(const uint8_t *colour, int r)
+{
+    return ((colour[r] >> 3) << 11) | ((colour[1] >> 2) << 5) | (colour[2 - r] >> 3);
+}
+
+// Expands a 565 colour to a texel with channels in the source order and zero alpha
+static HAP_INLINE void HapCodecFastDXTFrom565(unsigned int c, int r, int *colour)
+{
+    int red = (c >> 11) & 0x1F;
+    int green = (c >> 5) & 0x3F;
+    int blue = c & 0x1F;
+    colour[r] = (red << 3) | (red >> 2);
+    colour[1] = (green << 2) | (green >> 4);
+    colour[2 - r] = (blue << 3) | (blue >> 2);
+}
+
+static HAP_INLINE void HapCodecFastDXTEmitAlpha(const __m128i *rows, uint8_t minAlpha, uint8_t maxAlpha, uint8_t *dst)
+{
+    uint8_t inset = (maxAlpha - minAlpha) >> kHapCodecFastDXTAlphaInsetShift;
+    uint8_t thresholds[7];
+    uint8_t mid;
+    int i;
+    
+    minAlpha += inset;
+    maxAlpha -= inset;
+    
+    // Each texel's index is found by counting the midpoints between palette entries it lies below
+    mid = (maxAlpha - minAlpha) / (2 * 7);
+    thresholds[0] = minAlpha + mid;
+    thresholds[1] = (6 * maxAlpha + 1 * minAlpha) / 7 + mid;
+    thresholds[2] = (5 * maxAlpha + 2 * minAlpha) / 7 + mid;
+    thresholds[3] = (4 * maxAlpha + 3 * minAlpha) / 7 + mid;
+    thresholds[4] = (3 * maxAlpha + 4 * minAlpha) / 7 + mid;
+    thresholds[5] = (2 * maxAlpha + 5 * minAlpha) / 7 + mid;
+    thresholds[6] = (1 * maxAlpha + 6 * minAlpha) / 7 + mid;
+    
+    __m128i alpha = _mm_packus_epi16(_mm_packs_epi32(_mm_srli_epi32(rows[0], 24), _mm_srli_epi32(rows[1], 24)),
+                                     _mm_packs_epi32(_mm_srli_epi32(rows[2], 24), _mm_srli_epi32(rows[3], 24)));
+    __m128i count = _mm_setzero_si128();
+    for (i = 0; i < 7; i++)
+    {
+        __m128i threshold = _mm_set1_epi8((char)thresholds[i]);
+        count = _mm_add_epi8(count, _mm_cmpeq_epi8(_mm_min_epu8(alpha, threshold), alpha));
+    }
+    // count is negative: index = (count + 1) & 7, then 0 and 1 swap places
+    __m128i index = _mm_and_si128(_mm_sub_epi8(_mm_set1_epi8(1), count), _mm_set1_epi8(7));
+    index = _mm_xor_si128(index, _mm_and_si128(_mm_cmplt_epi8(index, _mm_set1_epi8(2)), _mm_set1_epi8(1)));
+    
+    // Pack 3-bit indices: pairs into 6 bits, then 4 texels into 12 bits, then 8 into 24
+    index = _mm_and_si128(_mm_or_si128(index, _mm_srli_epi16(index, 5)), _mm_set1_epi16(0x3F));
+    index = _mm_and_si128(_mm_or_si128(index, _mm_srli_epi32(index, 10)), _mm_set1_epi32(0xFFF));
+    index = _mm_and_si128(_mm_or_si128(index, _mm_srli_epi64(index, 20)), _mm_set_epi32(0, 0xFFFFFF, 0, 0xFFFFFF));
+    uint32_t indices0 = (uint32_t)_mm_cvtsi128_si32(index);
+    uint32_t indices1 = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(index, 8));
+    
+    dst[0] = maxAlpha;
+    dst[1] = minAlpha;
+    dst[2] = indices0 & 0xFF;
+    dst[3] = (indices0 >> 8) & 0xFF;
+    dst[4] = (indices0 >> 16) & 0xFF;
+    dst[5] = indices1 & 0xFF;
+    dst[6] = (indices1 >> 8) & 0xFF;
+    dst[7] = (indices1 >> 16) & 0xFF;
+}
+
+static void HapCodecFastDXTEncodeBlock(const uint8_t *src, size_t src_bytes_per_row, int r, int alpha, uint8_t *dst)
+{
+    __m128i rows[4];
+    __m128i masks0[4];
+    __m128i masks1[4];
+    __m128i lo, hi, inset;
+    int i;
+    
+    for (i = 0; i < 4; i++)
+    {
+        rows[i] = _mm_loadu_si128((const __m128i *)(src + (i * src_bytes_per_row)));
+    }
+    
+    // The bounding box
+    lo = _mm_min_epu8(_mm_min_epu8(rows[0], rows[1]), _mm_min_epu8(rows[2], rows[3]));
+    hi = _mm_max_epu8(_mm_max_epu8(rows[0], rows[1]), _mm_max_epu8(rows[2], rows[3]));
+    lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+    hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+    lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+    hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+    
+    if (alpha)
+    {
+        uint32_t mins = (uint32_t)_mm_cvtsi128_si32(lo);
+        uint32_t maxs = (uint32_t)_mm_cvtsi128_si32(hi);
+        HapCodecFastDXTEmitAlpha(rows, mins >> 24, maxs >> 24, dst);
+        dst += 8;
+    }
+    
+    inset = _mm_and_si128(_mm_srli_epi16(_mm_subs_epu8(hi, lo), kHapCodecFastDXTInsetShift), _mm_set1_epi8(0xFF >> kHapCodecFastDXTInsetShift));
+    lo = _mm_adds_epu8(lo, inset);
+    hi = _mm_subs_epu8(hi, inset);
+    
+    // The signs of the covariances of the outer channels with green choose the diagonal
+    __m128i centre = _mm_unpacklo_epi8(_mm_avg_epu8(lo, hi), _mm_setzero_si128());
+    centre = _mm_unpacklo_epi64(centre, centre);
+    __m128i covariance = _mm_setzero_si128();
+    const __m128i outerMask = _mm_set_epi16(0, -1, 0, -1, 0, -1, 0, -1);
+    for (i = 0; i < 4; i++)
+    {
+        __m128i t0 = _mm_sub_epi16(_mm_unpacklo_epi8(rows[i], _mm_setzero_si128()), centre);
+        __m128i t1 = _mm_sub_epi16(_mm_unpackhi_epi8(rows[i], _mm_setzero_si128()), centre);
+        __m128i g0 = _mm_and_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(t0, _MM_SHUFFLE(3, 1, 1, 1)), _MM_SHUFFLE(3, 1, 1, 1)), outerMask);
+        __m128i g1 = _mm_and_si128(_mm_shufflehi_epi16(_mm_shufflelo_epi16(t1, _MM_SHUFFLE(3, 1, 1, 1)), _MM_SHUFFLE(3, 1, 1, 1)), outerMask);
+        covariance = _mm_add_epi32(covariance, _mm_add_epi32(_mm_madd_epi16(t0, g0), _mm_madd_epi16(t1, g1)));
+    }
+    covariance = _mm_add_epi32(covariance, _mm_srli_si128(covariance, 8));
+    
+    HAP_ALIGN_16 uint8_t endpoints[16];
+    _mm_store_si128((__m128i *)endpoints, _mm_unpacklo_epi32(hi, lo));
+    uint8_t *maxColour = endpoints;
+    uint8_t *minColour = endpoints + 4;
+    if (_mm_cvtsi128_si32(covariance) < 0)
+    {
+        uint8_t c = maxColour[0];
+        maxColour[0] = minColour[0];
+        minColour[0] = c;
+    }
+    if (_mm_cvtsi128_si32(_mm_srli_si128(covariance, 4)) < 0)
+    {
+        uint8_t c = maxColour[2];
+        maxColour[2] = minColour[2];
+        minColour[2] = c;
+    }
+    
+    // The larger endpoint goes first so DXT1 is in four-colour mode
+    unsigned int colour0 = HapCodecFastDXTTo565(maxColour, r);
+    unsigned int colour1 = HapCodecFastDXTTo565(minColour, r);
+    unsigned int indices = 0;
+    if (colour0 < colour1)
+    {
+        unsigned int c = colour0;
+        colour0 = colour1;
+        colour1 = c;
+    }
+    if (colour0 != colour1)
+    {
+        int palette[4][3];
+        __m128i colours[4];
+        HapCodecFastDXTFrom565(colour0, r, palette[0]);
+        HapCodecFastDXTFrom565(colour1, r, palette[1]);
+        for (i = 0; i < 3; i++)
+        {
+            palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+            palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+        }
+        for (i = 0; i < 4; i++)
+        {
+            colours[i] = _mm_set1_epi32(palette[i][0] | (palette[i][1] << 8) | (palette[i][2] << 16));
+        }
+        for (i = 0; i < 4; i++)
+        {
+            __m128i d0 = HapCodecFastDXTDistance(rows[i], colours[0]);
+            __m128i d1 = HapCodecFastDXTDistance(rows[i], colours[1]);
+            __m128i d2 = HapCodecFastDXTDistance(rows[i], colours[2]);
+            __m128i d3 = HapCodecFastDXTDistance(rows[i], colours[3]);
+            
+            __m128i b0 = _mm_cmpgt_epi32(d0, d3);
+            __m128i b1 = _mm_cmpgt_epi32(d1, d2);
+            __m128i b2 = _mm_cmpgt_epi32(d0, d2);
+            __m128i b3 = _mm_cmpgt_epi32(d1, d3);
+            __m128i b4 = _mm_cmpgt_epi32(d2, d3);
+            
+            masks0[i] = _mm_and_si128(b0, b4);
+            masks1[i] = _mm_or_si128(_mm_and_si128(b1, b2), _mm_and_si128(b0, b3));
+        }
+        indices = HapCodecFastDXTSpreadBits(HapCodecFastDXTMovemask(masks0)) | (HapCodecFastDXTSpreadBits(HapCodecFastDXTMovemask(masks1)) << 1);
+    }
+    
+    dst[0] = colour0 & 0xFF;
+    dst[1] = colour0 >> 8;
+    dst[2] = colour1 & 0xFF;
+    dst[3] = colour1 >> 8;
+    dst[4] = indices & 0xFF;
+    dst[5] = (indices >> 8) & 0xFF;
+    dst[6] = (indices >> 16) & 0xFF;
+    dst[7] = indices >> 24;
+}
+
+static int HapCodecFastDXTEncoderEncode(HapCodecDXTEncoderRef encoder,
+                                        const void *src,
+                                        unsigned int src_bytes_per_row,
+                                        OSType src_pixel_format,
+                                        void *dst,
+                                        unsigned int width,
+                                        unsigned int height)
+{
+    int alpha = ((struct HapCodecFastDXTEncoder *)encoder)->alpha;
+    int r = (src_pixel_format == kHapCVPixelFormat_BGRA ? 2 : 0);
+    uint8_t *dst_block = (uint8_t *)dst;
+    unsigned int y, x, py, px;
+    
+    if (src_pixel_format != kHapCVPixelFormat_RGBA && src_pixel_format != kHapCVPixelFormat_BGRA) return 1;
+    
+    for (y = 0; y < height; y += 4)
+    {
+        for (x = 0; x < width; x += 4)
+        {
+            const uint8_t *block_src = (const uint8_t *)src + (y * src_bytes_per_row) + (x * 4);
+            
+            if (height - y < 4 || width - x < 4)
+            {
+                // Replicate the last row and column to fill blocks at the edges
+                uint32_t block[16];
+                for (py = 0; py < 4; py++)
+                {
+                    const uint32_t *row = (const uint32_t *)(block_src + ((y + py < height ? py : height - y - 1) * src_bytes_per_row));
+                    for (px = 0; px < 4; px++)
+                    {
+                        block[(py * 4) + px] = row[x + px < width ? px : width - x - 1];
+                    }
+                }
+                HapCodecFastDXTEncodeBlock((const uint8_t *)block, 16, r, alpha, dst_block);
+            }
+            else
+            {
+                HapCodecFastDXTEncodeBlock(block_src, src_bytes_per_row, r, alpha, dst_block);
+            }
+            dst_block += alpha ? 16 : 8;
+        }
+    }
+    return 0;
+}
+
+static OSType HapCodecFastDXTEncoderWantedPixelFormat(HapCodecDXTEncoderRef encoder HAP_ATTR_UNUSED, OSType sourceFormat)
+{
+    switch (sourceFormat) {
+        case kHapCVPixelFormat_RGBA:
+        case kHapCVPixelFormat_BGRA:
+            return sourceFormat;
+        default:
+            return kHapCVPixelFormat_RGBA;
+    }
+}
+
+#if defined(DEBUG)
+static const char *HapCodecFastDXTEncoderDescribe(HapCodecDXTEncoderRef encoder)
+{
+    return ((struct HapCodecFastDXTEncoder *)encoder)->alpha ? "Fast RGBA DXT5 Encoder" : "Fast RGB DXT1 Encoder";
+}
+#endif
+
+HapCodecDXTEncoderRef HapCodecFastDXTEncoderCreate(OSType pixelFormat)
+{
+    struct HapCodecFastDXTEncoder *encoder;
+    
+    if (pixelFormat != kHapCVPixelFormat_RGB_DXT1 && pixelFormat != kHapCVPixelFormat_RGBA_DXT5)
+        return NULL;
+    
+    encoder = (struct HapCodecFastDXTEncoder *)malloc(sizeof(struct HapCodecFastDXTEncoder));
+    if (encoder)
+    {
+        encoder->base.pixelformat_function = HapCodecFastDXTEncoderWantedPixelFormat;
+        encoder->base.encode_function = HapCodecFastDXTEncoderEncode;
+        encoder->base.destroy_function = HapCodecFastDXTEncoderDestroy;
+#if defined(DEBUG)
+        encoder->base.describe_function = HapCodecFastDXTEncoderDescribe;
+#endif
+        encoder->base.pad_source_buffers = false;
+        encoder->base.can_slice = true;
+        encoder->alpha = (pixelFormat == kHapCVPixelFormat_RGBA_DXT5);
+    }
+    return (HapCodecDXTEncoderRef)encoder;
+}
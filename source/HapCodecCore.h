@@ -0,0 +1,299 @@
+/*
+ HapCodecCore.h
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HapCodec_HapCodecCore_h
+#define HapCodec_HapCodecCore_h
+
+#include <stddef.h>
+#include "Buffers.h"
+#include "PixelFormats.h"
+#include "HapCodecSubTypes.h"
+#include "hap.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ The codec core encodes and decodes Hap frames from plain pointers and strides. It has no dependency on
+ QuickTime, so as well as backing the QuickTime components it can be built on its own.
+
+ Codec types are the sub-types in HapCodecSubTypes.h. Pixel formats are kHapCVPixelFormat_RGBA or
+ kHapCVPixelFormat_BGRA, or one of the DXT formats in PixelFormats.h. The Hap Q encoder also accepts
+ kHapCVPixelFormat_2vuy and kHapCVPixelFormat_v210, and frames with colour can be decoded to them.
+ Pixel buffers should be 16-byte aligned with bytes-per-row a multiple of 16.
+
+ Encoders and decoders share the process's worker threads, so sessions running at once divide the processors between
+ them. HapParallelSetWorkerLimit() in ParallelLoops.h sets how many threads they may use in total.
+ */
+
+enum HapCodecResult {
+    HapCodecResult_No_Error = 0,
+    HapCodecResult_Bad_Arguments,
+    HapCodecResult_Buffer_Too_Small,
+    HapCodecResult_Bad_Frame,
+    HapCodecResult_Internal_Error,
+    HapCodecResult_Out_Of_Memory
+};
+
+/*
+ Encoding
+ */
+
+enum HapCodecEncoderQuality {
+    HapCodecEncoderQuality_Fast = 0,
+    HapCodecEncoderQuality_Normal = 1
+};
+
+typedef struct HapCodecEncoder *HapCodecEncoderRef;
+
+#define kHapCodecEncoderMaxChunkCount 64U
+
+/*
+ The DXT texture(s) for one frame, between the two stages of encoding. If the source was already DXT then
+ dxt points to the source and no buffers are used.
+ */
+typedef struct HapCodecEncoderTextures {
+    const void          *dxt;
+    HapCodecBufferRef   dxtBuffer;
+    HapCodecBufferRef   alphaBuffer;
+} HapCodecEncoderTextures;
+
+/*
+ quality is ignored by the YCoCg codecs. Returns NULL if codecType isn't a Hap codec or on allocation failure.
+ */
+HapCodecEncoderRef HapCodecEncoderCreate(unsigned int codecType, unsigned int width, unsigned int height, int quality);
+void HapCodecEncoderDestroy(HapCodecEncoderRef encoder);
+
+/*
+ Sets the number of chunks each texture is divided into. Chunks are compressed in parallel, and can be decompressed
+ in parallel. 0 (the default) picks a count from the number of processors and the frame size. Counts are limited to
+ kHapCodecEncoderMaxChunkCount, and may be reduced to divide a texture evenly. Call before encoding any frames.
+ */
+void HapCodecEncoderSetChunkCount(HapCodecEncoderRef encoder, unsigned int chunkCount);
+
+/*
+ If enabled is non-zero, frames record where each of their chunks starts, so decoders can go straight to any chunk
+ rather than finding it from the sizes of those before it. This adds four bytes per chunk. Off by default.
+ */
+void HapCodecEncoderSetChunkOffsetTable(HapCodecEncoderRef encoder, int enabled);
+
+/*
+ Returns the largest possible encoded size of a frame.
+ */
+unsigned long HapCodecEncoderGetMaxEncodedLength(unsigned int codecType, unsigned int width, unsigned int height);
+
+#if defined(DEBUG)
+/*
+ Returns a C-string describing the DXT encoder in use, or NULL if none has been used yet.
+ */
+const char *HapCodecEncoderDescribe(HapCodecEncoderRef encoder);
+#endif
+
+/*
+ Encodes a frame in one call. Equivalent to calling HapCodecEncoderAcquireTextures(),
+ HapCodecEncoderEncodeTextures() and HapCodecEncoderCompressTextures().
+ */
+unsigned int HapCodecEncoderEncodeFrame(HapCodecEncoderRef encoder,
+                                        const void *src,
+                                        unsigned int srcPixelFormat,
+                                        size_t srcBytesPerRow,
+                                        size_t srcLength,
+                                        void *dst,
+                                        unsigned long dstLength,
+                                        unsigned long *outputLength);
+
+/*
+ Acquires the buffers HapCodecEncoderEncodeTextures() will need for a frame in srcPixelFormat. Release them with
+ HapCodecEncoderTexturesRelease().
+ 
+ Returns HapCodecResult_Out_Of_Memory if no buffer was available, in which case nothing is held and it can be
+ retried after earlier textures have been released.
+ */
+unsigned int HapCodecEncoderAcquireTextures(HapCodecEncoderRef encoder,
+                                            unsigned int srcPixelFormat,
+                                            HapCodecEncoderTextures *textures);
+
+/*
+ Performs any pixel-format conversion and DXT encoding required by src into textures, which must have been
+ acquired for srcPixelFormat by HapCodecEncoderAcquireTextures(). The source must remain valid until
+ HapCodecEncoderCompressTextures() has been called if it was already DXT. This may be called from any thread,
+ and in parallel for different frames. The textures remain held on failure.
+ */
+unsigned int HapCodecEncoderEncodeTextures(HapCodecEncoderRef encoder,
+                                           const void *src,
+                                           unsigned int srcPixelFormat,
+                                           size_t srcBytesPerRow,
+                                           size_t srcLength,
+                                           HapCodecEncoderTextures *textures);
+
+/*
+ Compresses textures into a Hap frame in dst. This may be called from any thread, and in parallel for
+ different frames.
+ */
+unsigned int HapCodecEncoderCompressTextures(HapCodecEncoderRef encoder,
+                                             const HapCodecEncoderTextures *textures,
+                                             void *dst,
+                                             unsigned long dstLength,
+                                             unsigned long *outputLength);
+
+void HapCodecEncoderTexturesRelease(HapCodecEncoderTextures *textures);
+
+/*
+ Decoding
+ */
+
+typedef struct HapCodecDecoder *HapCodecDecoderRef;
+
+/*
+ The state for one frame, between the stages of decoding.
+ */
+typedef struct HapCodecDecoderFrame {
+    unsigned int        width;
+    unsigned int        height;
+    unsigned int        dstPixelFormat;
+    int                 hasColour;
+    int                 hasAlpha;
+    int                 streaming; // textures are decoded a chunk at a time by HapCodecDecoderDrawFrame()
+    unsigned int        colourFormat; // a HapTextureFormat
+    unsigned int        colourIndex;
+    unsigned int        alphaIndex;
+    HapCodecBufferRef   colourBuffer;
+    HapCodecBufferRef   alphaBuffer;
+    HapCodecBufferRef   scratchBuffer; // chunk tables and row counters, so decoding needn't allocate
+    HapFrame            hapFrame; // the frame's sections, read once by HapCodecDecoderBeginFrame(), which point into src
+} HapCodecDecoderFrame;
+
+HapCodecDecoderRef HapCodecDecoderCreate(void);
+void HapCodecDecoderDestroy(HapCodecDecoderRef decoder);
+
+/*
+ Decodes a frame in one call. Whole 4x4 blocks are written, so dst must have room for width and height
+ rounded up to multiples of 4. For DXT destinations dst must hold the whole texture and dstBytesPerRow is
+ ignored. Y'CbCr destinations are written only within width and height, and any alpha is dropped.
+ kHapCVPixelFormat_YCoCg_DXT5_A_RGTC1 is planar so must be decoded a texture at a time with
+ HapCodecDecoderDecodeTexture().
+ */
+unsigned int HapCodecDecoderDecodeFrame(HapCodecDecoderRef decoder,
+                                        const void *src,
+                                        unsigned long srcLength,
+                                        unsigned int width,
+                                        unsigned int height,
+                                        void *dst,
+                                        unsigned int dstPixelFormat,
+                                        size_t dstBytesPerRow);
+
+/*
+ Decodes only the part of a frame inside the rectangle regionX, regionY, regionWidth, regionHeight to kHapCVPixelFormat_RGBA
+ or kHapCVPixelFormat_BGRA. Only the 4x4 blocks which intersect the rectangle are decoded, and chunks of the frame
+ holding none of them are skipped without being decompressed, so the cost follows the area of the region rather than
+ the frame. Whole blocks are written, with the block containing pixel regionX, regionY at dst, so dst must have room for
+ the rectangle grown out to block boundaries.
+ */
+unsigned int HapCodecDecoderDecodeRegion(HapCodecDecoderRef decoder,
+                                         const void *src,
+                                         unsigned long srcLength,
+                                         unsigned int width,
+                                         unsigned int height,
+                                         unsigned int regionX,
+                                         unsigned int regionY,
+                                         unsigned int regionWidth,
+                                         unsigned int regionHeight,
+                                         void *dst,
+                                         unsigned int dstPixelFormat,
+                                         size_t dstBytesPerRow);
+
+/*
+ Decodes a frame to kHapCVPixelFormat_RGBA or kHapCVPixelFormat_BGRA at 1/2, 1/4 or 1/8 of its size, for thumbnails
+ and previews. Each pixel is the mean of the scale x scale pixels it covers. At 1/4 and 1/8 the means of Hap and Hap
+ Alpha blocks are found without decoding any pixels, so these are much cheaper than a full decode. The frame is scaled
+ from its size rounded up to whole blocks, so dst must have room for ((width + 3) / 4) * 4 / scale pixels, rounded up,
+ in each of ((height + 3) / 4) * 4 / scale rows, rounded up.
+ */
+unsigned int HapCodecDecoderDecodeFrameScaled(HapCodecDecoderRef decoder,
+                                              const void *src,
+                                              unsigned long srcLength,
+                                              unsigned int width,
+                                              unsigned int height,
+                                              unsigned int scale,
+                                              void *dst,
+                                              unsigned int dstPixelFormat,
+                                              size_t dstBytesPerRow);
+
+/*
+ Inspects the frame in src and obtains any buffers needed to decode it to dstPixelFormat. The frame's headers are read
+ only here, so src must not change before HapCodecDecoderEndFrame(). Frames begun with one decoder may be decoded in
+ parallel, but must all have the same dimensions.
+ */
+unsigned int HapCodecDecoderBeginFrame(HapCodecDecoderRef decoder,
+                                       HapCodecDecoderFrame *frame,
+                                       const void *src,
+                                       unsigned long srcLength,
+                                       unsigned int width,
+                                       unsigned int height,
+                                       unsigned int dstPixelFormat);
+
+/*
+ Decompresses the frame's textures into its buffers. Does nothing for DXT destinations.
+ */
+unsigned int HapCodecDecoderDecodeTextures(HapCodecDecoderFrame *frame);
+
+/*
+ Writes the frame to dst. For DXT destinations this decompresses the colour texture straight into dst.
+ */
+unsigned int HapCodecDecoderDrawFrame(HapCodecDecoderRef decoder,
+                                      HapCodecDecoderFrame *frame,
+                                      void *dst,
+                                      size_t dstBytesPerRow);
+
+void HapCodecDecoderEndFrame(HapCodecDecoderFrame *frame);
+
+/*
+ Decompresses the texture at index of a frame begun with HapCodecDecoderBeginFrame() straight into dst, in parallel
+ where the frame allows.
+ */
+unsigned int HapCodecDecoderDecodeFrameTexture(const HapCodecDecoderFrame *frame,
+                                               unsigned int index,
+                                               void *dst,
+                                               unsigned long dstLength);
+
+/*
+ Decompresses the texture at index straight into dst, in parallel where the frame allows.
+ outputFormat is set to the HapTextureFormat of the texture.
+ */
+unsigned int HapCodecDecoderDecodeTexture(const void *src,
+                                          unsigned long srcLength,
+                                          unsigned int index,
+                                          void *dst,
+                                          unsigned long dstLength,
+                                          unsigned int *outputFormat);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1002 @@
+/*
+ HapCodecDecoder.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "HapCodecCore.h"
+#include "HapPlatform.h"
+#include "hap.h"
+#include "ParallelLoops.h"
+#include "Lock.h"
+#include "YCoCgDXTDecoder.h"
+#include "DXTScaledDecoder.h"
+#include "DXTBlocks.h"
+#include "DXTDecodeSIMD.h"
+#include "YCbCr.h"
+#include <stdlib.h>
+#include <string.h>
+#if defined(__APPLE__)
+#include <libkern/OSAtomic.h>
+#elif defined(_WIN32)
+#include <Windows.h>
+#else
+#include <stdatomic.h>
+#endif
+
+/*
+ Defines determine the decoding methods available.
+ MacOS supports the required EXT_texture_compression_s3tc extension at least as far back as 10.5
+ so we don't enable squish decoding at all. Elsewhere we currently use Squish.
+ If both are enabled, squish will be used as a fallback when the extension is not available.
+ */
+
+#if defined(__APPLE__)
+#define HAP_GPU_DECODE
+#else
+#define HAP_SQUISH_DECODE
+#endif
+
+#ifndef HAP_GPU_DECODE
+    #ifndef HAP_SQUISH_DECODE
+        #error Neither HAP_GPU_DECODE nor HAP_SQUISH_DECODE is defined. #define one or both.
+    #endif
+#endif
+
+#ifdef HAP_GPU_DECODE
+    #include "HapCodecGL.h"
+#endif
+
+#ifdef HAP_SQUISH_DECODE
+    #include "SquishDecoder.h"
+#endif
+
+#include "SquishRGTC1Decoder.h"
+
+/*
+ Chunks up to this length are decompressed into a buffer of their own which stays in cache while its blocks are
+ decoded. Longer chunks are decompressed into the frame's texture buffer.
+ */
+#define kHapCodecDecoderChunkBufferLength (1024U * 1024U)
+
+/*
+ Y'CbCr destinations are drawn through an RGBA strip of this many blocks, small enough to live on the stack. 48 blocks
+ is 192 pixels, whole groups of six for v210.
+ */
+#define kHapCodecDecoderYCbCrStripBlocks 48U
+
+#if defined(__APPLE__)
+typedef volatile int32_t HapCodecDecoderCounter;
+#define HapCodecDecoderCounterAdd(counter, amount) OSAtomicAdd32Barrier((amount), (counter))
+#elif defined(_WIN32)
+typedef volatile LONG HapCodecDecoderCounter;
+#define HapCodecDecoderCounterAdd(counter, amount) (InterlockedExchangeAdd((counter), (amount)) + (amount))
+#else
+typedef atomic_int HapCodecDecoderCounter;
+#define HapCodecDecoderCounterAdd(counter, amount) (atomic_fetch_add((counter), (amount)) + (amount))
+#endif
+
+struct HapCodecDecoder {
+    HapCodecBufferPoolRef       dxtBufferPool;
+    HapCodecBufferPoolRef       alphaBufferPool;
+    HapCodecBufferPoolRef       chunkBufferPool;
+    HapCodecBufferPoolRef       scratchBufferPool;
+    HapCodecLock                lock; // guards replacing the pools, as frames may begin in parallel
+#ifdef HAP_GPU_DECODE
+    HapCodecGLRef               glDecoder;
+#endif
+};
+
+#define HapCodecRoundUpToMultipleOf4(n) (((n) + 3U) & ~3U)
+
+static unsigned long HapCodecTextureLength(unsigned int width, unsigned int height, unsigned int textureFormat)
+{
+    unsigned long length = HapCodecRoundUpToMultipleOf4(width) * HapCodecRoundUpToMultipleOf4(height);
+    if (textureFormat == HapTextureFormat_RGB_DXT1 || textureFormat == HapTextureFormat_A_RGTC1) length /= 2;
+    return length;
+}
+
+static unsigned int HapCodecResultForHapResult(unsigned int hapResult)
+{
+    switch (hapResult) {
+        case HapResult_No_Error:
+            return HapCodecResult_No_Error;
+        case HapResult_Bad_Arguments:
+            return HapCodecResult_Bad_Arguments;
+        case HapResult_Buffer_Too_Small:
+            return HapCodecResult_Buffer_Too_Small;
+        case HapResult_Bad_Frame:
+            return HapCodecResult_Bad_Frame;
+        default:
+            return HapCodecResult_Internal_Error;
+    }
+}
+
+/*
+ Callback for multithreaded Hap decoding
+ */
+
+static void HapMTDecode(HapDecodeWorkFunction function, void *p, unsigned int count, void *info HAP_ATTR_UNUSED)
+{
+    HapParallelFor((HapParallelFunction)function, p, count);
+}
+
+/*
+ Returns a buffer of size from *pool, replacing the pool if its buffers are a different size. A replaced pool is freed
+ once other frames have returned its buffers.
+ */
+static HapCodecBufferRef HapCodecDecoderCreateBuffer(HapCodecDecoderRef decoder, HapCodecBufferPoolRef *pool, long size)
+{
+    HapCodecBufferRef buffer;
+    HapCodecLockLock(&decoder->lock);
+    if (*pool == NULL || HapCodecBufferPoolGetBufferSize(*pool) != size)
+    {
+        HapCodecBufferPoolDestroy(*pool);
+        *pool = HapCodecBufferPoolCreate(size);
+    }
+    buffer = HapCodecBufferCreate(*pool);
+    HapCodecLockUnlock(&decoder->lock);
+    return buffer;
+}
+
+/*
+ Creates the pool of chunk buffers used while streaming if it doesn't exist yet. Returns zero on failure.
+ */
+static int HapCodecDecoderCreateChunkBufferPool(HapCodecDecoderRef decoder)
+{
+    int result;
+    HapCodecLockLock(&decoder->lock);
+    if (decoder->chunkBufferPool == NULL)
+    {
+        decoder->chunkBufferPool = HapCodecBufferPoolCreate(kHapCodecDecoderChunkBufferLength);
+    }
+    result = decoder->chunkBufferPool != NULL;
+    HapCodecLockUnlock(&decoder->lock);
+    return result;
+}
+
+/*
+ A frame's scratch buffer holds a counter for every row of blocks, used while streaming, followed by the chunk table
+ hap.c uses to decode a texture. It always has room for kHapCodecEncoderMaxChunkCount chunks, so its size only changes
+ with the frame's height. hap.c allocates the table itself for frames with more chunks, which only other encoders write.
+ */
+static size_t HapCodecDecoderScratchCounterLength(unsigned int height)
+{
+    return ((((height + 3) / 4) * sizeof(HapCodecDecoderCounter)) + 15U) & ~((size_t)15U);
+}
+
+static HapCodecDecoderCounter *HapCodecDecoderScratchCounters(const HapCodecDecoderFrame *frame)
+{
+    return (HapCodecDecoderCounter *)HapCodecBufferGetBaseAddress(frame->scratchBuffer);
+}
+
+static void *HapCodecDecoderScratchChunks(const HapCodecDecoderFrame *frame, unsigned long *length)
+{
+    size_t counterLength = HapCodecDecoderScratchCounterLength(frame->height);
+    *length = (unsigned long)(HapCodecBufferGetSize(frame->scratchBuffer) - counterLength);
+    return (uint8_t *)HapCodecBufferGetBaseAddress(frame->scratchBuffer) + counterLength;
+}
+
+HapCodecDecoderRef HapCodecDecoderCreate(void)
+{
+    HapCodecDecoderRef decoder = (HapCodecDecoderRef)calloc(1, sizeof(struct HapCodecDecoder));
+    if (decoder)
+    {
+        decoder->lock = HAP_CODEC_LOCK_INIT;
+    }
+    return decoder;
+}
+
+void HapCodecDecoderDestroy(HapCodecDecoderRef decoder)
+{
+    if (decoder)
+    {
+        HapCodecBufferPoolDestroy(decoder->dxtBufferPool);
+        HapCodecBufferPoolDestroy(decoder->alphaBufferPool);
+        HapCodecBufferPoolDestroy(decoder->chunkBufferPool);
+        HapCodecBufferPoolDestroy(decoder->scratchBufferPool);
+        HapCodecLockDestroy(&decoder->lock);
+#ifdef HAP_GPU_DECODE
+        if (decoder->glDecoder)
+        {
+            HapCodecGLDestroy(decoder->glDecoder);
+        }
+#endif
+        free(decoder);
+    }
+}
+
+unsigned int HapCodecDecoderDecodeTexture(const void *src,
+                                          unsigned long srcLength,
+                                          unsigned int index,
+                                          void *dst,
+                                          unsigned long dstLength,
+                                          unsigned int *outputFormat)
+{
+    unsigned int hapResult = HapDecode(src,
+                                       srcLength,
+                                       index,
+                                       (HapDecodeCallback)HapMTDecode,
+                                       NULL,
+                                       dst,
+                                       dstLength,
+                                       NULL,
+                                       outputFormat);
+    return HapCodecResultForHapResult(hapResult);
+}
+
+unsigned int HapCodecDecoderDecodeFrameTexture(const HapCodecDecoderFrame *frame,
+                                               unsigned int index,
+                                               void *dst,
+                                               unsigned long dstLength)
+{
+    unsigned int hapResult;
+    unsigned long scratchLength;
+    void *scratch;
+
+    if (frame == NULL || frame->scratchBuffer == NULL)
+        return HapCodecResult_Bad_Arguments;
+
+    scratch = HapCodecDecoderScratchChunks(frame, &scratchLength);
+    hapResult = HapDecodeTexture(&frame->hapFrame,
+                                 index,
+                                 (HapDecodeCallback)HapMTDecode,
+                                 NULL,
+                                 scratch,
+                                 scratchLength,
+                                 dst,
+                                 dstLength,
+                                 NULL);
+    return HapCodecResultForHapResult(hapResult);
+}
+
+unsigned int HapCodecDecoderBeginFrame(HapCodecDecoderRef decoder,
+                                       HapCodecDecoderFrame *frame,
+                                       const void *src,
+                                       unsigned long srcLength,
+                                       unsigned int width,
+                                       unsigned int height,
+                                       unsigned int dstPixelFormat)
+{
+    unsigned int hapResult;
+    int ycbcr = HapCodecIsYCbCrPixelFormat(dstPixelFormat);
+    unsigned int i;
+
+    if (decoder == NULL || frame == NULL || src == NULL)
+        return HapCodecResult_Bad_Arguments;
+
+    frame->width = width;
+    frame->height = height;
+    frame->dstPixelFormat = dstPixelFormat;
+    frame->colourBuffer = frame->alphaBuffer = frame->scratchBuffer = NULL;
+    frame->colourFormat = 0;
+    frame->colourIndex = frame->alphaIndex = 0;
+    frame->hasAlpha = frame->hasColour = false;
+    frame->streaming = false;
+
+    if (!isDXTPixelFormat(dstPixelFormat) && dstPixelFormat != kHapCVPixelFormat_RGBA && dstPixelFormat != kHapCVPixelFormat_BGRA && !ycbcr)
+        return HapCodecResult_Bad_Arguments;
+
+    // Read the frame's sections once to discover the texture format(s) and how to decode them
+    hapResult = HapParseFrame(src, srcLength, &frame->hapFrame);
+    if (hapResult != HapResult_No_Error)
+        return HapCodecResultForHapResult(hapResult);
+
+    for (i = 0; i < frame->hapFrame.textureCount; i++) {
+        unsigned int textureFormat = frame->hapFrame.textures[i].textureFormat;
+
+        if (textureFormat == HapTextureFormat_A_RGTC1)
+        {
+            frame->alphaIndex = i;
+            frame->hasAlpha = true;
+        }
+        else if (textureFormat == HapTextureFormat_RGB_DXT1 || textureFormat == HapTextureFormat_RGBA_DXT5 || textureFormat == HapTextureFormat_YCoCg_DXT5)
+        {
+            frame->colourIndex = i;
+            frame->colourFormat = textureFormat;
+            frame->hasColour = true;
+        }
+    }
+
+    // Y'CbCr has no alpha, so is only drawn from colour
+    if (ycbcr && !frame->hasColour)
+        return HapCodecResult_Bad_Arguments;
+
+    frame->scratchBuffer = HapCodecDecoderCreateBuffer(decoder,
+                                                       &decoder->scratchBufferPool,
+                                                       (long)(HapCodecDecoderScratchCounterLength(height) + HapDecodeScratchLength(kHapCodecEncoderMaxChunkCount)));
+    if (frame->scratchBuffer == NULL)
+        goto memory_error;
+
+    if (!isDXTPixelFormat(dstPixelFormat))
+    {
+        if (frame->hasColour)
+        {
+            frame->colourBuffer = HapCodecDecoderCreateBuffer(decoder, &decoder->dxtBufferPool, HapCodecTextureLength(width, height, frame->colourFormat));
+            if (frame->colourBuffer == NULL)
+                goto memory_error;
+        }
+
+        if (frame->hasAlpha && !ycbcr)
+        {
+            frame->alphaBuffer = HapCodecDecoderCreateBuffer(decoder, &decoder->alphaBufferPool, HapCodecTextureLength(width, height, HapTextureFormat_A_RGTC1));
+            if (frame->alphaBuffer == NULL)
+                goto memory_error;
+        }
+
+#ifdef HAP_GPU_DECODE
+        if (frame->hasColour && frame->colourFormat != HapTextureFormat_YCoCg_DXT5 && !ycbcr)
+        {
+            unsigned int textureFormat = frame->colourFormat;
+
+            // Rebuild the decoder if the format has changed
+            if (decoder->glDecoder && textureFormat != HapCodecGLGetCompressedFormat(decoder->glDecoder))
+            {
+                HapCodecGLDestroy(decoder->glDecoder);
+                decoder->glDecoder = NULL;
+            }
+            if (decoder->glDecoder == NULL)
+            {
+                decoder->glDecoder = HapCodecGLCreateDecoder(width, height, textureFormat);
+            }
+
+#ifndef HAP_SQUISH_DECODE
+            // Built without squish we're stuck if we failed to create a GL decoder, so bail
+            if (decoder->glDecoder == NULL)
+            {
+                HapCodecDecoderEndFrame(frame);
+                return HapCodecResult_Internal_Error;
+            }
+#endif
+        }
+#endif
+
+        // Unless the GPU is decoding, textures are decoded a chunk at a time straight to the destination, which is the
+        // only way to Y'CbCr
+        frame->streaming = true;
+#ifdef HAP_GPU_DECODE
+        if (frame->hasColour && frame->colourFormat != HapTextureFormat_YCoCg_DXT5 && !ycbcr && decoder->glDecoder != NULL)
+        {
+            frame->streaming = false;
+        }
+#endif
+        if (frame->streaming && !HapCodecDecoderCreateChunkBufferPool(decoder))
+            goto memory_error;
+    }
+    return HapCodecResult_No_Error;
+memory_error:
+    HapCodecDecoderEndFrame(frame);
+    return HapCodecResult_Out_Of_Memory;
+}
+
+unsigned int HapCodecDecoderDecodeTextures(HapCodecDecoderFrame *frame)
+{
+    unsigned int result = HapCodecResult_No_Error;
+
+    if (frame == NULL)
+        return HapCodecResult_Bad_Arguments;
+
+    if (frame->streaming)
+    {
+        // Colour is streamed by HapCodecDecoderDrawFrame(), which needs the whole alpha texture to decode with it
+        if (frame->hasColour && frame->alphaBuffer)
+        {
+            result = HapCodecDecoderDecodeFrameTexture(frame,
+                                                       frame->alphaIndex,
+                                                       HapCodecBufferGetBaseAddress(frame->alphaBuffer),
+                                                       HapCodecBufferGetSize(frame->alphaBuffer));
+        }
+    }
+    else if (!isDXTPixelFormat(frame->dstPixelFormat))
+    {
+        if (frame->hasColour)
+        {
+            result = HapCodecDecoderDecodeFrameTexture(frame,
+                                                       frame->colourIndex,
+                                                       HapCodecBufferGetBaseAddress(frame->colourBuffer),
+                                                       HapCodecBufferGetSize(frame->colourBuffer));
+            if (result != HapCodecResult_No_Error)
+                return result;
+        }
+        if (frame->hasAlpha)
+        {
+            result = HapCodecDecoderDecodeFrameTexture(frame,
+                                                       frame->alphaIndex,
+                                                       HapCodecBufferGetBaseAddress(frame->alphaBuffer),
+                                                       HapCodecBufferGetSize(frame->alphaBuffer));
+        }
+    }
+    return result;
+}
+
+typedef struct HapCodecDecoderYCoCgInfo {
+    const void      *src;
+    void            *dst;
+    unsigned int    dstPixelFormat;
+    unsigned int    dstBytesPerRow;
+    unsigned int    width;
+    int             hasAVX2;
+} HapCodecDecoderYCoCgInfo;
+
+// Decodes a row of YCoCg blocks, called by the alpha decoder so each row is written in one pass
+static void HapCodecDecoderDecodeYCoCgRow(void *p, unsigned int first_row, unsigned int row_count HAP_ATTR_UNUSED)
+{
+    HapCodecDecoderYCoCgInfo *info = (HapCodecDecoderYCoCgInfo *)p;
+    HapCodecYCoCgDXTDecodeBlockRow(info->src, info->dst, info->dstPixelFormat, info->dstBytesPerRow, info->width, first_row, info->hasAVX2);
+}
+
+/*
+ Streaming decode: each chunk of a texture is decompressed into a buffer small enough to stay in cache and its blocks
+ decoded to the destination at once, so the texture is never written out whole. Rows of blocks split between chunks
+ are gathered in the frame's texture buffer and decoded by whichever chunk completes them. Only the rows and columns
+ of blocks in the stream's region are decoded, and chunks holding none of its rows are never decompressed.
+ */
+
+typedef struct HapCodecDecoderStream {
+    HapCodecBufferPoolRef   chunkBufferPool;
+    unsigned int            textureFormat;
+    uint8_t                 *texture;
+    unsigned long           textureLength;
+    unsigned int            blockRowLength;
+    unsigned int            blockLength;
+    HapCodecDecoderCounter  *blockRowBytes; // bytes gathered for each row of blocks split between chunks
+    const uint8_t           *alpha; // a whole RGTC1 texture to decode with the colour, or NULL
+    unsigned int            firstBlockRow;
+    unsigned int            blockRowEnd;
+    unsigned int            firstBlockColumn;
+    unsigned int            blockColumnCount;
+    uint8_t                 *dst; // receives the first block of the region
+    unsigned int            dstBytesPerRow;
+    int                     bgra;
+    unsigned int            ycbcrFormat; // a Y'CbCr pixel format, or 0 to write RGBA or BGRA
+    int                     ycbcrMatrix;
+    unsigned int            width; // the frame's dimensions, which bound Y'CbCr rows
+    unsigned int            height;
+    int                     hasAVX2;
+    int                     allowWhole; // a single chunk may be left in texture to decode in bands
+    int                     decodedWhole; // set if it was
+} HapCodecDecoderStream;
+
+static void HapCodecDecoderStreamBlocks(const HapCodecDecoderStream *stream, const uint8_t *src, const uint8_t *alpha, uint8_t *dst, unsigned int dstBytesPerRow, unsigned int blockCount)
+{
+    switch (stream->textureFormat)
+    {
+        case HapTextureFormat_RGB_DXT1:
+        case HapTextureFormat_RGBA_DXT5:
+            if (stream->hasAVX2)
+            {
+                HapCodecDXTDecodeBlocksAVX2(src, dst, dstBytesPerRow, blockCount, stream->textureFormat == HapTextureFormat_RGBA_DXT5, stream->bgra);
+            }
+            else
+            {
+                HapCodecDXTDecodeBlocksSSE2(src, dst, dstBytesPerRow, blockCount, stream->textureFormat == HapTextureFormat_RGBA_DXT5, stream->bgra);
+            }
+            break;
+        case HapTextureFormat_YCoCg_DXT5:
+            if (stream->hasAVX2)
+            {
+                HapCodecYCoCgDXTDecodeBlocksAVX2(src, dst, dstBytesPerRow, blockCount, stream->bgra);
+            }
+            else
+            {
+                HapCodecYCoCgDXTDecodeBlocksSSE2(src, dst, dstBytesPerRow, blockCount, stream->bgra);
+            }
+            break;
+        case HapTextureFormat_A_RGTC1:
+            alpha = src;
+            break;
+        default:
+            break;
+    }
+    if (alpha)
+    {
+        if (stream->hasAVX2)
+        {
+            HapCodecRGTC1DecodeBlocksAVX2(alpha, dst, dstBytesPerRow, blockCount);
+        }
+        else
+        {
+            HapCodecRGTC1DecodeBlocksSSE2(alpha, dst, dstBytesPerRow, blockCount);
+        }
+    }
+}
+
+static void HapCodecDecoderStreamBlockRow(const HapCodecDecoderStream *stream, const uint8_t *src, unsigned int row)
+{
+    uint8_t *dst = stream->dst + ((size_t)stream->dstBytesPerRow * (row - stream->firstBlockRow) * 4);
+    const uint8_t *alpha = NULL;
+    src += stream->blockLength * stream->firstBlockColumn;
+    if (stream->alpha)
+    {
+        alpha = stream->alpha + ((size_t)(stream->blockRowLength / 2) * row) + (8 * stream->firstBlockColumn);
+    }
+    if (stream->ycbcrFormat)
+    {
+        // Blocks are decoded to a strip of RGBA which is converted a row at a time, so the chroma is subsampled while
+        // the pixels are in cache. Rows and columns beyond the frame are never written.
+        HAP_ALIGN_16 uint8_t strip[kHapCodecDecoderYCbCrStripBlocks * 4 * 4 * 4];
+        unsigned int rowCount = stream->height - (row * 4);
+        unsigned int block;
+        unsigned int i;
+        if (rowCount > 4)
+            rowCount = 4;
+        for (block = 0; block < stream->blockColumnCount; block += kHapCodecDecoderYCbCrStripBlocks)
+        {
+            unsigned int blockCount = stream->blockColumnCount - block;
+            unsigned int x = block * 4;
+            unsigned int pixelCount;
+            if (blockCount > kHapCodecDecoderYCbCrStripBlocks)
+                blockCount = kHapCodecDecoderYCbCrStripBlocks;
+            pixelCount = blockCount * 4;
+            if (pixelCount > stream->width - x)
+                pixelCount = stream->width - x;
+            HapCodecDecoderStreamBlocks(stream, src + (stream->blockLength * block), NULL, strip, kHapCodecDecoderYCbCrStripBlocks * 16, blockCount);
+            for (i = 0; i < rowCount; i++)
+            {
+                HapCodecYCbCrRowFromRGBA(strip + (i * kHapCodecDecoderYCbCrStripBlocks * 16),
+                                         stream->bgra,
+                                         x,
+                                         pixelCount,
+                                         dst + ((size_t)stream->dstBytesPerRow * i),
+                                         stream->ycbcrFormat,
+                                         stream->ycbcrMatrix);
+            }
+        }
+    }
+    else
+    {
+        HapCodecDecoderStreamBlocks(stream, src, alpha, dst, stream->dstBytesPerRow, stream->blockColumnCount);
+    }
+}
+
+// Decodes a row of blocks of a texture left whole in the stream's texture buffer
+static void HapCodecDecoderStreamWholeBlockRow(void *p, unsigned int index)
+{
+    const HapCodecDecoderStream *stream = (const HapCodecDecoderStream *)p;
+    unsigned int row = stream->firstBlockRow + index;
+    HapCodecDecoderStreamBlockRow(stream, stream->texture + ((size_t)stream->blockRowLength * row), row);
+}
+
+static unsigned int HapCodecDecoderStreamChunk(void *info, const HapChunkDecodeInfo *chunk, unsigned long offset, unsigned long length)
+{
+    HapCodecDecoderStream *stream = (HapCodecDecoderStream *)info;
+    HapCodecBufferRef buffer = NULL;
+    uint8_t *data;
+    unsigned long end = offset + length;
+    unsigned long regionStart = (unsigned long)stream->firstBlockRow * stream->blockRowLength;
+    unsigned long regionEnd = (unsigned long)stream->blockRowEnd * stream->blockRowLength;
+    unsigned int row;
+    unsigned int hapResult;
+
+    if (length > stream->textureLength || offset > stream->textureLength - length)
+        return HapResult_Buffer_Too_Small;
+
+    // Skip chunks without any of the region's rows
+    if (end <= regionStart || offset >= regionEnd)
+        return HapResult_No_Error;
+
+    if (stream->allowWhole && offset == 0 && length == stream->textureLength)
+    {
+        // A single chunk is left to be decoded in parallel bands
+        hapResult = HapDecodeChunk(chunk, stream->texture, length);
+        stream->decodedWhole = (hapResult == HapResult_No_Error);
+        return hapResult;
+    }
+
+    if (length <= (unsigned long)HapCodecBufferPoolGetBufferSize(stream->chunkBufferPool))
+    {
+        buffer = HapCodecBufferCreate(stream->chunkBufferPool);
+    }
+    if (buffer)
+    {
+        data = (uint8_t *)HapCodecBufferGetBaseAddress(buffer);
+    }
+    else
+    {
+        data = stream->texture + offset;
+    }
+
+    hapResult = HapDecodeChunk(chunk, data, length);
+    if (hapResult == HapResult_No_Error)
+    {
+        if (offset < regionStart)
+        {
+            row = stream->firstBlockRow;
+        }
+        else
+        {
+            row = offset / stream->blockRowLength;
+        }
+        for (; row < stream->blockRowEnd && (unsigned long)row * stream->blockRowLength < end; row++)
+        {
+            unsigned long rowStart = (unsigned long)row * stream->blockRowLength;
+            unsigned long rowEnd = rowStart + stream->blockRowLength;
+            unsigned long first = (rowStart > offset ? rowStart : offset);
+            unsigned long last = (rowEnd < end ? rowEnd : end);
+            if (first == rowStart && last == rowEnd)
+            {
+                HapCodecDecoderStreamBlockRow(stream, data + (rowStart - offset), row);
+            }
+            else
+            {
+                if (buffer)
+                {
+                    memcpy(stream->texture + first, data + (first - offset), last - first);
+                }
+                if (HapCodecDecoderCounterAdd(&stream->blockRowBytes[row], (int)(last - first)) == (int)stream->blockRowLength)
+                {
+                    HapCodecDecoderStreamBlockRow(stream, stream->texture + rowStart, row);
+                }
+            }
+        }
+    }
+
+    if (buffer)
+    {
+        HapCodecBufferReturn(buffer);
+    }
+    return hapResult;
+}
+
+/*
+ Decodes the blocks of the frame's colour texture, or its alpha texture if alphaTexture is true, which intersect the
+ rectangle x, y, width, height to dst, which receives the block containing pixel x, y. If alpha is non-NULL it is a
+ whole RGTC1 texture decoded with the colour. If decodedWhole is non-NULL the rectangle must be the whole frame, and
+ if the texture turns out to be a single chunk it is left in its buffer and *decodedWhole is set for the caller to
+ decode it in parallel.
+ */
+static unsigned int HapCodecDecoderStreamTexture(HapCodecDecoderRef decoder,
+                                                 const HapCodecDecoderFrame *frame,
+                                                 int alphaTexture,
+                                                 const void *alpha,
+                                                 unsigned int x,
+                                                 unsigned int y,
+                                                 unsigned int width,
+                                                 unsigned int height,
+                                                 void *dst,
+                                                 size_t dstBytesPerRow,
+                                                 int *decodedWhole)
+{
+    HapCodecDecoderStream stream;
+    unsigned int blockRowCount = (frame->height + 3) / 4;
+    unsigned int hapResult;
+    unsigned long scratchLength;
+    void *scratch;
+
+    if (decodedWhole)
+        *decodedWhole = false;
+
+    if (width == 0 || height == 0)
+        return HapCodecResult_No_Error;
+
+    stream.chunkBufferPool = decoder->chunkBufferPool;
+    stream.textureFormat = (alphaTexture ? HapTextureFormat_A_RGTC1 : frame->colourFormat);
+    stream.texture = (uint8_t *)HapCodecBufferGetBaseAddress(alphaTexture ? frame->alphaBuffer : frame->colourBuffer);
+    stream.textureLength = HapCodecTextureLength(frame->width, frame->height, stream.textureFormat);
+    stream.blockLength = (stream.textureFormat == HapTextureFormat_RGB_DXT1 || stream.textureFormat == HapTextureFormat_A_RGTC1 ? 8 : 16);
+    stream.blockRowLength = ((frame->width + 3) / 4) * stream.blockLength;
+    stream.alpha = (const uint8_t *)alpha;
+    stream.firstBlockRow = y / 4;
+    stream.blockRowEnd = (y + height + 3) / 4;
+    stream.firstBlockColumn = x / 4;
+    stream.blockColumnCount = ((x + width + 3) / 4) - stream.firstBlockColumn;
+    stream.dst = (uint8_t *)dst;
+    stream.dstBytesPerRow = (unsigned int)dstBytesPerRow;
+    stream.bgra = (frame->dstPixelFormat == kHapCVPixelFormat_BGRA ? 1 : 0);
+    stream.ycbcrFormat = (HapCodecIsYCbCrPixelFormat(frame->dstPixelFormat) ? frame->dstPixelFormat : 0);
+    stream.ycbcrMatrix = HapCodecYCbCrMatrixForWidth(frame->width);
+    stream.width = frame->width;
+    stream.height = frame->height;
+    stream.hasAVX2 = HapCodecHasAVX2();
+    stream.allowWhole = (decodedWhole != NULL);
+    stream.decodedWhole = false;
+
+    stream.blockRowBytes = HapCodecDecoderScratchCounters(frame);
+    memset((void *)stream.blockRowBytes, 0, blockRowCount * sizeof(HapCodecDecoderCounter));
+    scratch = HapCodecDecoderScratchChunks(frame, &scratchLength);
+
+    hapResult = HapDecodeTextureChunks(&frame->hapFrame,
+                                       (alphaTexture ? frame->alphaIndex : frame->colourIndex),
+                                       (HapDecodeCallback)HapMTDecode,
+                                       NULL,
+                                       scratch,
+                                       scratchLength,
+                                       HapCodecDecoderStreamChunk,
+                                       &stream);
+
+    // There is no whole-frame path to Y'CbCr, so a texture left whole is drawn here, in parallel bands
+    if (hapResult == HapResult_No_Error && stream.decodedWhole && stream.ycbcrFormat)
+    {
+        HapParallelFor(HapCodecDecoderStreamWholeBlockRow, &stream, stream.blockRowEnd - stream.firstBlockRow);
+        stream.decodedWhole = false;
+    }
+
+    if (decodedWhole)
+        *decodedWhole = stream.decodedWhole;
+    return HapCodecResultForHapResult(hapResult);
+}
+
+unsigned int HapCodecDecoderDrawFrame(HapCodecDecoderRef decoder,
+                                      HapCodecDecoderFrame *frame,
+                                      void *dst,
+                                      size_t dstBytesPerRow)
+{
+    if (decoder == NULL || frame == NULL || dst == NULL)
+        return HapCodecResult_Bad_Arguments;
+
+    if (isDXTPixelFormat(frame->dstPixelFormat))
+    {
+        // Decompress the frame directly into the output buffer
+        if (frame->dstPixelFormat == kHapCVPixelFormat_YCoCg_DXT5_A_RGTC1 || !frame->hasColour)
+            return HapCodecResult_Bad_Arguments;
+
+        return HapCodecDecoderDecodeFrameTexture(frame,
+                                                 frame->colourIndex,
+                                                 dst,
+                                                 HapCodecTextureLength(frame->width, frame->height, frame->colourFormat));
+    }
+
+    if (frame->streaming)
+    {
+        // The colour is decoded with the alpha, which is decoded alone if there is no colour
+        int decodedWhole;
+        unsigned int result = HapCodecDecoderStreamTexture(decoder,
+                                                           frame,
+                                                           !frame->hasColour,
+                                                           (frame->hasColour && frame->alphaBuffer ? HapCodecBufferGetBaseAddress(frame->alphaBuffer) : NULL),
+                                                           0,
+                                                           0,
+                                                           frame->width,
+                                                           frame->height,
+                                                           dst,
+                                                           dstBytesPerRow,
+                                                           &decodedWhole);
+        // A texture decoded whole is left in its buffer to be drawn below
+        if (result != HapCodecResult_No_Error || decodedWhole == false)
+            return result;
+    }
+
+    if (frame->hasColour)
+    {
+        if (frame->colourFormat == HapTextureFormat_YCoCg_DXT5)
+        {
+            // With alpha, colour is decoded a row of blocks at a time in the alpha pass below
+            if (frame->hasAlpha == false)
+            {
+                HapCodecYCoCgDXTDecode(HapCodecBufferGetBaseAddress(frame->colourBuffer), dst, frame->dstPixelFormat, (unsigned int)dstBytesPerRow, frame->width, frame->height);
+            }
+        }
+        else
+        {
+#ifdef HAP_GPU_DECODE
+            if (decoder->glDecoder != NULL)
+            {
+                int decodeResult = HapCodecGLDecode(decoder->glDecoder,
+                                                    (unsigned int)dstBytesPerRow,
+                                                    (frame->dstPixelFormat == kHapCVPixelFormat_RGBA ? HapCodecGLPixelFormat_RGBA8 : HapCodecGLPixelFormat_BGRA8),
+                                                    HapCodecBufferGetBaseAddress(frame->colourBuffer),
+                                                    dst);
+                if (decodeResult != 0)
+                {
+                    return HapCodecResult_Internal_Error;
+                }
+            }
+#endif
+            
+#ifdef HAP_SQUISH_DECODE
+#ifdef HAP_GPU_DECODE
+            else
+            {
+#endif
+                unsigned int decompressFormat;
+                switch (frame->colourFormat)
+                {
+                    case HapTextureFormat_RGB_DXT1:
+                        decompressFormat = kHapCVPixelFormat_RGB_DXT1;
+                        break;
+                    case HapTextureFormat_RGBA_DXT5:
+                        decompressFormat = kHapCVPixelFormat_RGBA_DXT5;
+                        break;
+                    default:
+                        return HapCodecResult_Internal_Error;
+                }
+                HapCodecSquishDecode(HapCodecBufferGetBaseAddress(frame->colourBuffer),
+                                     decompressFormat,
+                                     dst,
+                                     frame->dstPixelFormat,
+                                     (unsigned int)dstBytesPerRow,
+                                     frame->width,
+                                     frame->height);
+#ifdef HAP_GPU_DECODE
+            }
+#endif
+#endif // HAP_SQUISH_DECODE
+        }
+    }
+
+    if (frame->hasAlpha)
+    {
+        if (frame->hasColour && frame->colourFormat == HapTextureFormat_YCoCg_DXT5)
+        {
+            HapCodecDecoderYCoCgInfo info;
+            info.src = HapCodecBufferGetBaseAddress(frame->colourBuffer);
+            info.dst = dst;
+            info.dstPixelFormat = frame->dstPixelFormat;
+            info.dstBytesPerRow = (unsigned int)dstBytesPerRow;
+            info.width = frame->width;
+            info.hasAVX2 = HapCodecHasAVX2();
+            HapCodecSquishRGTC1Decode(HapCodecBufferGetBaseAddress(frame->alphaBuffer), dst, (unsigned int)dstBytesPerRow, frame->width, frame->height, HapCodecDecoderDecodeYCoCgRow, &info);
+        }
+        else
+        {
+            HapCodecSquishRGTC1Decode(HapCodecBufferGetBaseAddress(frame->alphaBuffer), dst, (unsigned int)dstBytesPerRow, frame->width, frame->height, NULL, NULL);
+        }
+    }
+    return HapCodecResult_No_Error;
+}
+
+void HapCodecDecoderEndFrame(HapCodecDecoderFrame *frame)
+{
+    if (frame)
+    {
+        HapCodecBufferReturn(frame->colourBuffer);
+        frame->colourBuffer = NULL;
+        HapCodecBufferReturn(frame->alphaBuffer);
+        frame->alphaBuffer = NULL;
+        HapCodecBufferReturn(frame->scratchBuffer);
+        frame->scratchBuffer = NULL;
+    }
+}
+
+unsigned int HapCodecDecoderDecodeFrame(HapCodecDecoderRef decoder,
+                                        const void *src,
+                                        unsigned long srcLength,
+                                        unsigned int width,
+                                        unsigned int height,
+                                        void *dst,
+                                        unsigned int dstPixelFormat,
+                                        size_t dstBytesPerRow)
+{
+    HapCodecDecoderFrame frame;
+    unsigned int result = HapCodecDecoderBeginFrame(decoder, &frame, src, srcLength, width, height, dstPixelFormat);
+    if (result == HapCodecResult_No_Error)
+    {
+        result = HapCodecDecoderDecodeTextures(&frame);
+        if (result == HapCodecResult_No_Error)
+        {
+            result = HapCodecDecoderDrawFrame(decoder, &frame, dst, dstBytesPerRow);
+        }
+        HapCodecDecoderEndFrame(&frame);
+    }
+    return result;
+}
+
+unsigned int HapCodecDecoderDecodeRegion(HapCodecDecoderRef decoder,
+                                         const void *src,
+                                         unsigned long srcLength,
+                                         unsigned int width,
+                                         unsigned int height,
+                                         unsigned int regionX,
+                                         unsigned int regionY,
+                                         unsigned int regionWidth,
+                                         unsigned int regionHeight,
+                                         void *dst,
+                                         unsigned int dstPixelFormat,
+                                         size_t dstBytesPerRow)
+{
+    HapCodecDecoderFrame frame;
+    unsigned int result;
+
+    if (decoder == NULL || dst == NULL || (dstPixelFormat != kHapCVPixelFormat_RGBA && dstPixelFormat != kHapCVPixelFormat_BGRA))
+        return HapCodecResult_Bad_Arguments;
+
+    if (regionX > width || regionWidth > width - regionX || regionY > height || regionHeight > height - regionY)
+        return HapCodecResult_Bad_Arguments;
+
+    result = HapCodecDecoderBeginFrame(decoder, &frame, src, srcLength, width, height, dstPixelFormat);
+    if (result != HapCodecResult_No_Error)
+        return result;
+
+    // Regions are always streamed, even where the GPU decodes whole frames
+    if (!HapCodecDecoderCreateChunkBufferPool(decoder))
+        result = HapCodecResult_Out_Of_Memory;
+
+    // Colour is decoded first as it sets alpha to opaque
+    if (result == HapCodecResult_No_Error && frame.hasColour)
+    {
+        result = HapCodecDecoderStreamTexture(decoder, &frame, false, NULL, regionX, regionY, regionWidth, regionHeight, dst, dstBytesPerRow, NULL);
+    }
+    if (result == HapCodecResult_No_Error && frame.hasAlpha)
+    {
+        result = HapCodecDecoderStreamTexture(decoder, &frame, true, NULL, regionX, regionY, regionWidth, regionHeight, dst, dstBytesPerRow, NULL);
+    }
+
+    HapCodecDecoderEndFrame(&frame);
+    return result;
+}
+
+unsigned int HapCodecDecoderDecodeFrameScaled(HapCodecDecoderRef decoder,
+                                              const void *src,
+                                              unsigned long srcLength,
+                                              unsigned int width,
+                                              unsigned int height,
+                                              unsigned int scale,
+                                              void *dst,
+                                              unsigned int dstPixelFormat,
+                                              size_t dstBytesPerRow)
+{
+    HapCodecDecoderFrame frame;
+    unsigned int result;
+
+    if (decoder == NULL || dst == NULL || (dstPixelFormat != kHapCVPixelFormat_RGBA && dstPixelFormat != kHapCVPixelFormat_BGRA))
+        return HapCodecResult_Bad_Arguments;
+
+    if (scale != 2 && scale != 4 && scale != 8)
+        return HapCodecResult_Bad_Arguments;
+
+    result = HapCodecDecoderBeginFrame(decoder, &frame, src, srcLength, width, height, dstPixelFormat);
+    if (result != HapCodecResult_No_Error)
+        return result;
+
+    // Scaled frames are reduced from whole textures rather than streamed
+    frame.streaming = false;
+    result = HapCodecDecoderDecodeTextures(&frame);
+    if (result == HapCodecResult_No_Error)
+    {
+        unsigned int colourFormat = 0;
+        switch (frame.colourFormat)
+        {
+            case HapTextureFormat_RGB_DXT1:
+                colourFormat = kHapCVPixelFormat_RGB_DXT1;
+                break;
+            case HapTextureFormat_RGBA_DXT5:
+                colourFormat = kHapCVPixelFormat_RGBA_DXT5;
+                break;
+            case HapTextureFormat_YCoCg_DXT5:
+                colourFormat = kHapCVPixelFormat_YCoCg_DXT5;
+                break;
+            default:
+                break;
+        }
+        if (frame.hasColour || frame.hasAlpha)
+        {
+            HapCodecDXTDecodeScaled(frame.hasColour ? HapCodecBufferGetBaseAddress(frame.colourBuffer) : NULL,
+                                    colourFormat,
+                                    frame.hasAlpha ? HapCodecBufferGetBaseAddress(frame.alphaBuffer) : NULL,
+                                    dst,
+                                    dstPixelFormat,
+                                    (unsigned int)dstBytesPerRow,
+                                    width,
+                                    height,
+                                    scale);
+        }
+        else
+        {
+            result = HapCodecResult_Bad_Frame;
+        }
+    }
+
+    HapCodecDecoderEndFrame(&frame);
+    return result;
+}
@@ -0,0 +1,624 @@
+/*
+ HapCodecEncoder.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "HapCodecCore.h"
+#include "HapPlatform.h"
+#include "hap.h"
+#include "ParallelLoops.h"
+#include "Lock.h"
+#include "DXTEncoder.h"
+#include "ImageMath.h"
+#include "YCbCr.h"
+#if defined(__APPLE__)
+#include "GLDXTEncoder.h"
+#endif
+#include "SquishEncoder.h"
+#include "FastDXTEncoder.h"
+#include "YCoCgDXTEncoder.h"
+#include <stdlib.h>
+
+/*
+ On Apple we support GL encoding using the GPU.
+ The GPU is very fast but produces low quality results
+ Squish produces nicer results but takes longer.
+ We select the GPU for HapCodecEncoderQuality_Fast
+ Elsewhere we select the fast CPU encoder for HapCodecEncoderQuality_Fast, which is of similar quality to the GPU
+ YCoCg encodes YCoCg in DXT and requires a shader to draw, and produces very high quality results
+ */
+
+struct HapCodecEncoder {
+    unsigned int                    type;
+    unsigned int                    width;
+    unsigned int                    height;
+    int                             quality;
+
+    unsigned int                    textureCount;
+    unsigned int                    textureFormats[2];
+    unsigned long                   textureLengths[2];
+    
+    HapCodecLock                    lock; // guards creation of the DXT encoders
+    HapCodecDXTEncoderRef           dxtEncoder;
+    HapCodecDXTEncoderRef           alphaEncoder;
+    
+    size_t                          convertBytesPerRow;
+    
+    HapCodecBufferPoolRef           dxtBufferPool;
+    HapCodecBufferPoolRef           alphaBufferPool;
+    HapCodecBufferPoolRef           convertBufferPool;
+
+    unsigned int                    sliceCount;
+    unsigned int                    sliceHeight;
+
+    unsigned int                    chunkCounts[2];
+    unsigned int                    hapOptions; // HapEncodeOption values passed to HapEncodeWithOptions()
+};
+
+typedef struct HapCodecEncodeDXTTask HapCodecEncodeDXTTask;
+
+struct HapCodecEncodeDXTTask
+{
+    long                    width;
+    long                    height;
+    long                    sliceHeight;
+    OSType                  sourcePixelFormat;
+    size_t                  sourceBytesPerRow;
+    const uint8_t           *source;
+    OSType                  dxtInputFormat;
+    size_t                  dxtInputBytesPerRow;
+    uint8_t                 *dxtInput;
+    size_t                  dxtBytesPerRow;
+    uint8_t                 *dxt;
+    HapCodecDXTEncoderRef   encoder;
+};
+
+#define HapCodecRoundUpToMultipleOf4(n) (((n) + 3U) & ~3U)
+#define HapCodecRoundUpToMultipleOf16(n) (((n) + 15U) & ~15U)
+
+// Smaller chunks cost compression ratio for little gain in parallelism
+#define kHapCodecMinimumAutomaticChunkLength (64U * 1024U)
+// Larger chunks don't stay in cache while the decoder expands them to pixels
+#define kHapCodecMaximumAutomaticChunkLength (512U * 1024U)
+
+static unsigned long HapCodecTextureLength(unsigned int width, unsigned int height, unsigned int textureFormat)
+{
+    unsigned long length = HapCodecRoundUpToMultipleOf4(width) * HapCodecRoundUpToMultipleOf4(height);
+    if (textureFormat == HapTextureFormat_RGB_DXT1 || textureFormat == HapTextureFormat_A_RGTC1) length /= 2;
+    return length;
+}
+
+static unsigned int HapCodecTextureFormatsForType(unsigned int codecType, unsigned int *textureFormats)
+{
+    switch (codecType) {
+        case kHapCodecSubType:
+            textureFormats[0] = HapTextureFormat_RGB_DXT1;
+            return 1;
+        case kHapAlphaCodecSubType:
+            textureFormats[0] = HapTextureFormat_RGBA_DXT5;
+            return 1;
+        case kHapYCoCgCodecSubType:
+            textureFormats[0] = HapTextureFormat_YCoCg_DXT5;
+            return 1;
+        case kHapYCoCgACodecSubType:
+            textureFormats[0] = HapTextureFormat_YCoCg_DXT5;
+            textureFormats[1] = HapTextureFormat_A_RGTC1;
+            return 2;
+        default:
+            return 0;
+    }
+}
+
+static OSType HapCodecDXTPixelFormatForType(unsigned int codecType)
+{
+    switch (codecType) {
+        case kHapCodecSubType:
+            return kHapCVPixelFormat_RGB_DXT1;
+        case kHapAlphaCodecSubType:
+            return kHapCVPixelFormat_RGBA_DXT5;
+        case kHapYCoCgCodecSubType:
+            return kHapCVPixelFormat_YCoCg_DXT5;
+        default:
+            return 0;
+    }
+}
+
+static unsigned int HapCodecAutomaticChunkCount(unsigned long textureLength)
+{
+    unsigned int chunkCount = HapParallelGetProcessorCount();
+    if (chunkCount < (textureLength + kHapCodecMaximumAutomaticChunkLength - 1) / kHapCodecMaximumAutomaticChunkLength)
+        chunkCount = (unsigned int)((textureLength + kHapCodecMaximumAutomaticChunkLength - 1) / kHapCodecMaximumAutomaticChunkLength);
+    if (chunkCount > textureLength / kHapCodecMinimumAutomaticChunkLength)
+        chunkCount = (unsigned int)(textureLength / kHapCodecMinimumAutomaticChunkLength);
+    if (chunkCount > kHapCodecEncoderMaxChunkCount)
+        chunkCount = kHapCodecEncoderMaxChunkCount;
+    if (chunkCount < 1)
+        chunkCount = 1;
+    return chunkCount;
+}
+
+/*
+ Callback for multithreaded Hap encoding
+ */
+
+static void HapMTEncode(HapEncodeWorkFunction function, void *p, unsigned int count, void *info HAP_ATTR_UNUSED)
+{
+    HapParallelFor((HapParallelFunction)function, p, count);
+}
+
+HapCodecEncoderRef HapCodecEncoderCreate(unsigned int codecType, unsigned int width, unsigned int height, int quality)
+{
+    HapCodecEncoderRef encoder;
+    unsigned int textureFormats[2];
+    unsigned int textureCount = HapCodecTextureFormatsForType(codecType, textureFormats);
+    unsigned int i;
+
+    if (textureCount == 0 || width == 0 || height == 0)
+        return NULL;
+
+    encoder = (HapCodecEncoderRef)calloc(1, sizeof(struct HapCodecEncoder));
+    if (encoder == NULL)
+        return NULL;
+
+    encoder->lock = HAP_CODEC_LOCK_INIT;
+    encoder->type = codecType;
+    encoder->width = width;
+    encoder->height = height;
+    encoder->quality = quality;
+    encoder->textureCount = textureCount;
+    for (i = 0; i < textureCount; i++)
+    {
+        encoder->textureFormats[i] = textureFormats[i];
+        encoder->textureLengths[i] = HapCodecTextureLength(width, height, textureFormats[i]);
+        encoder->chunkCounts[i] = HapCodecAutomaticChunkCount(encoder->textureLengths[i]);
+    }
+
+    encoder->dxtBufferPool = HapCodecBufferPoolCreate(encoder->textureLengths[0]);
+    if (textureCount > 1)
+        encoder->alphaBufferPool = HapCodecBufferPoolCreate(encoder->textureLengths[1]);
+
+    // Buffers to convert the source to an ordering the DXT encoder supports, only created if one is
+    // needed (the YCoCg encoder converts from RGB itself as it encodes)
+    encoder->convertBytesPerRow = HapCodecRoundUpToMultipleOf16(width * 4);
+    encoder->convertBufferPool = HapCodecBufferPoolCreate(encoder->convertBytesPerRow * height);
+
+    if (encoder->dxtBufferPool == NULL || (textureCount > 1 && encoder->alphaBufferPool == NULL) || encoder->convertBufferPool == NULL)
+    {
+        HapCodecEncoderDestroy(encoder);
+        return NULL;
+    }
+
+    {
+        // Slice on DXT row boundaries
+        unsigned int totalDXTRows = HapCodecRoundUpToMultipleOf4(height) / 4;
+        unsigned int remainder;
+        encoder->sliceCount = totalDXTRows < 30 ? totalDXTRows : 30;
+        encoder->sliceHeight = (totalDXTRows / encoder->sliceCount) * 4;
+        remainder = (totalDXTRows % encoder->sliceCount) * 4;
+        while (remainder > 0)
+        {
+            encoder->sliceCount++;
+            if (remainder > encoder->sliceHeight)
+            {
+                remainder -= encoder->sliceHeight;
+            }
+            else
+            {
+                remainder = 0;
+            }
+        }
+    }
+    return encoder;
+}
+
+void HapCodecEncoderDestroy(HapCodecEncoderRef encoder)
+{
+    if (encoder)
+    {
+        HapCodecDXTEncoderDestroy(encoder->dxtEncoder);
+        HapCodecDXTEncoderDestroy(encoder->alphaEncoder);
+        HapCodecBufferPoolDestroy(encoder->dxtBufferPool);
+        HapCodecBufferPoolDestroy(encoder->alphaBufferPool);
+        HapCodecBufferPoolDestroy(encoder->convertBufferPool);
+        HapCodecLockDestroy(&encoder->lock);
+        free(encoder);
+    }
+}
+
+void HapCodecEncoderSetChunkCount(HapCodecEncoderRef encoder, unsigned int chunkCount)
+{
+    if (encoder)
+    {
+        unsigned int i;
+        if (chunkCount > kHapCodecEncoderMaxChunkCount)
+            chunkCount = kHapCodecEncoderMaxChunkCount;
+        for (i = 0; i < encoder->textureCount; i++)
+        {
+            encoder->chunkCounts[i] = (chunkCount == 0 ? HapCodecAutomaticChunkCount(encoder->textureLengths[i]) : chunkCount);
+        }
+    }
+}
+
+void HapCodecEncoderSetChunkOffsetTable(HapCodecEncoderRef encoder, int enabled)
+{
+    if (encoder)
+    {
+        if (enabled)
+            encoder->hapOptions |= HapEncodeOptionChunkOffsetTable;
+        else
+            encoder->hapOptions &= ~HapEncodeOptionChunkOffsetTable;
+    }
+}
+
+unsigned long HapCodecEncoderGetMaxEncodedLength(unsigned int codecType, unsigned int width, unsigned int height)
+{
+    unsigned long lengths[2];
+    // The worst case grows with the chunk count, so allow for the most we ever use
+    unsigned int chunks[2] = {kHapCodecEncoderMaxChunkCount, kHapCodecEncoderMaxChunkCount};
+    unsigned int textureFormats[2];
+    unsigned int count = HapCodecTextureFormatsForType(codecType, textureFormats);
+    unsigned int i;
+
+    if (count == 0)
+        return 0;
+
+    for (i = 0; i < count; i++)
+    {
+        lengths[i] = HapCodecTextureLength(width, height, textureFormats[i]);
+    }
+    return HapMaxEncodedLength(count, lengths, textureFormats, chunks);
+}
+
+#if defined(DEBUG)
+const char *HapCodecEncoderDescribe(HapCodecEncoderRef encoder)
+{
+    if (encoder && encoder->dxtEncoder && encoder->dxtEncoder->describe_function)
+    {
+        return encoder->dxtEncoder->describe_function(encoder->dxtEncoder);
+    }
+    return NULL;
+}
+#endif
+
+static void Encode_Slice(void *p, unsigned int index)
+{
+    HapCodecEncodeDXTTask *task = (HapCodecEncodeDXTTask *)p;
+
+    unsigned int sliceHeight = task->sliceHeight;
+    if ((index + 1) * sliceHeight > (unsigned int)task->height)
+        sliceHeight = task->height - (index * sliceHeight);
+
+    const uint8_t *src = task->source + (index * task->sliceHeight * task->sourceBytesPerRow);
+    uint8_t *dxtInput = task->dxtInput + (index * task->sliceHeight * task->dxtInputBytesPerRow);
+    uint8_t *dxt = task->dxt + (index * task->sliceHeight * task->dxtBytesPerRow);
+
+    if (task->dxtInputFormat != task->sourcePixelFormat)
+    {
+        // for all these we pass 0 as last argument so we don't tile, we are already multithreaded
+        switch (task->dxtInputFormat)
+        {
+            case kHapCVPixelFormat_RGBA:
+                if (task->sourcePixelFormat == kHapCVPixelFormat_BGRA)
+                {
+                    uint8_t permuteMap[] = {2, 1, 0, 3};
+                    ImageMath_Permute8888(src,
+                                          task->sourceBytesPerRow,
+                                          dxtInput,
+                                          task->dxtInputBytesPerRow,
+                                          task->width,
+                                          sliceHeight,
+                                          permuteMap,
+                                          0);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    if (task->encoder->can_slice)
+    {
+        // Encode the DXT frame
+        task->encoder->encode_function(task->encoder,
+                                       dxtInput,
+                                       task->dxtInputBytesPerRow,
+                                       task->dxtInputFormat,
+                                       dxt,
+                                       task->width,
+                                       sliceHeight);
+    }
+}
+
+// Perform pixel-format conversion and DXT encoding
+static unsigned int dxtEncode(HapCodecEncoderRef encoder,
+                              const void *src,
+                              OSType sourceFormat,
+                              size_t srcBytesPerRow,
+                              HapCodecBufferRef destinationDXTBuffer,
+                              HapCodecDXTEncoderRef dxtEncoder,
+                              Boolean isDXT1orRGTC1)
+{
+    HapCodecEncodeDXTTask dxtTask;
+    HapCodecBufferRef convertBuffer = NULL;
+
+    dxtTask.width = encoder->width;
+    dxtTask.height = encoder->height;
+    dxtTask.encoder = dxtEncoder;
+    dxtTask.sliceHeight = encoder->sliceHeight;
+    dxtTask.sourceBytesPerRow = srcBytesPerRow;
+    dxtTask.sourcePixelFormat = sourceFormat;
+    dxtTask.source = (const uint8_t *)src;
+    dxtTask.dxtInputFormat = dxtEncoder->pixelformat_function(dxtEncoder, sourceFormat);
+    dxtTask.dxtBytesPerRow = HapCodecRoundUpToMultipleOf4(encoder->width);
+    if (isDXT1orRGTC1)
+        dxtTask.dxtBytesPerRow /= 2;
+
+    // If necessary, convert the pixels to a format the encoder can ingest
+    if (dxtTask.dxtInputFormat != sourceFormat)
+    {
+        if (dxtTask.dxtInputFormat != kHapCVPixelFormat_RGBA || sourceFormat != kHapCVPixelFormat_BGRA)
+        {
+            return HapCodecResult_Internal_Error;
+        }
+        convertBuffer = HapCodecBufferCreate(encoder->convertBufferPool);
+        if (convertBuffer == NULL)
+        {
+            return HapCodecResult_Out_Of_Memory;
+        }
+        dxtTask.dxtInput = (uint8_t *)HapCodecBufferGetBaseAddress(convertBuffer);
+        dxtTask.dxtInputBytesPerRow = encoder->convertBytesPerRow;
+    }
+    else // wantedPixelFormat == sourcePixelFormat
+    {
+        dxtTask.dxtInput = (uint8_t *)dxtTask.source;
+        dxtTask.dxtInputBytesPerRow = dxtTask.sourceBytesPerRow;
+    }
+
+    dxtTask.dxt = (uint8_t *)HapCodecBufferGetBaseAddress(destinationDXTBuffer);
+
+    HapParallelFor(Encode_Slice, &dxtTask, encoder->sliceCount);
+
+    if (dxtTask.encoder->can_slice == false)
+    {
+        dxtTask.encoder->encode_function(dxtTask.encoder,
+                                         dxtTask.dxtInput,
+                                         dxtTask.dxtInputBytesPerRow,
+                                         dxtTask.dxtInputFormat,
+                                         dxtTask.dxt,
+                                         dxtTask.width,
+                                         dxtTask.height);
+    }
+    HapCodecBufferReturn(convertBuffer);
+    return HapCodecResult_No_Error;
+}
+
+unsigned int HapCodecEncoderAcquireTextures(HapCodecEncoderRef encoder,
+                                            unsigned int srcPixelFormat,
+                                            HapCodecEncoderTextures *textures)
+{
+    if (encoder == NULL || textures == NULL)
+        return HapCodecResult_Bad_Arguments;
+
+    textures->dxt = NULL;
+    textures->dxtBuffer = NULL;
+    textures->alphaBuffer = NULL;
+
+    // DXT sources are used as they are
+    if (isDXTPixelFormat(srcPixelFormat))
+        return HapCodecResult_No_Error;
+
+    textures->dxtBuffer = HapCodecBufferCreate(encoder->dxtBufferPool);
+    if (textures->dxtBuffer == NULL)
+        return HapCodecResult_Out_Of_Memory;
+
+    if (encoder->type == kHapYCoCgACodecSubType)
+    {
+        textures->alphaBuffer = HapCodecBufferCreate(encoder->alphaBufferPool);
+        if (textures->alphaBuffer == NULL)
+        {
+            HapCodecEncoderTexturesRelease(textures);
+            return HapCodecResult_Out_Of_Memory;
+        }
+    }
+    return HapCodecResult_No_Error;
+}
+
+unsigned int HapCodecEncoderEncodeTextures(HapCodecEncoderRef encoder,
+                                           const void *src,
+                                           unsigned int srcPixelFormat,
+                                           size_t srcBytesPerRow,
+                                           size_t srcLength,
+                                           HapCodecEncoderTextures *textures)
+{
+    unsigned int result = HapCodecResult_No_Error;
+
+    if (encoder == NULL || src == NULL || textures == NULL)
+        return HapCodecResult_Bad_Arguments;
+
+    textures->dxt = NULL;
+
+    if (isDXTPixelFormat(srcPixelFormat))
+    {
+        if (srcPixelFormat != HapCodecDXTPixelFormatForType(encoder->type) || srcLength < encoder->textureLengths[0])
+            return HapCodecResult_Bad_Arguments;
+        textures->dxt = src;
+        return HapCodecResult_No_Error;
+    }
+
+    if (srcPixelFormat != kHapCVPixelFormat_RGBA && srcPixelFormat != kHapCVPixelFormat_BGRA
+        && !((srcPixelFormat == kHapCVPixelFormat_CoCgXY || HapCodecIsYCbCrPixelFormat(srcPixelFormat)) && encoder->type == kHapYCoCgCodecSubType))
+        return HapCodecResult_Bad_Arguments;
+
+    if (textures->dxtBuffer == NULL || (encoder->type == kHapYCoCgACodecSubType && textures->alphaBuffer == NULL))
+        return HapCodecResult_Bad_Arguments;
+
+    if (HapCodecIsYCbCrPixelFormat(srcPixelFormat))
+    {
+        if (srcLength < srcBytesPerRow * (encoder->height - 1) + HapCodecYCbCrBytesPerRow(srcPixelFormat, encoder->width))
+            return HapCodecResult_Bad_Arguments;
+    }
+    else if (srcLength < srcBytesPerRow * (encoder->height - 1) + encoder->width * 4)
+        return HapCodecResult_Bad_Arguments;
+
+    // Create a DXT encoder if one will be needed by this frame
+    HapCodecLockLock(&encoder->lock);
+    if (encoder->dxtEncoder == NULL)
+    {
+        if (encoder->type == kHapYCoCgCodecSubType || encoder->type == kHapYCoCgACodecSubType)
+        {
+            encoder->dxtEncoder = HapCodecYCoCgDXTEncoderCreate();
+        }
+#if defined(__APPLE__)
+        else if (encoder->quality == HapCodecEncoderQuality_Fast)
+        {
+            encoder->dxtEncoder = HapCodecGLEncoderCreate(encoder->width,
+                                                          encoder->height,
+                                                          HapCodecDXTPixelFormatForType(encoder->type));
+        }
+#else
+        else if (encoder->quality == HapCodecEncoderQuality_Fast)
+        {
+            encoder->dxtEncoder = HapCodecFastDXTEncoderCreate(HapCodecDXTPixelFormatForType(encoder->type));
+        }
+#endif
+        else
+        {
+            encoder->dxtEncoder = HapCodecSquishEncoderCreate(HapCodecSquishEncoderMediumQuality, HapCodecDXTPixelFormatForType(encoder->type));
+        }
+    }
+
+    if (encoder->type == kHapYCoCgACodecSubType && encoder->alphaEncoder == NULL)
+    {
+        encoder->alphaEncoder = HapCodecSquishEncoderCreate(HapCodecSquishEncoderBestQuality, kHapCVPixelFormat_A_RGTC1);
+    }
+    HapCodecLockUnlock(&encoder->lock);
+
+    if (encoder->dxtEncoder == NULL || (encoder->type == kHapYCoCgACodecSubType && encoder->alphaEncoder == NULL))
+    {
+        return HapCodecResult_Internal_Error;
+    }
+
+    // Perform DXT compression
+    result = dxtEncode(encoder, src, srcPixelFormat, srcBytesPerRow, textures->dxtBuffer, encoder->dxtEncoder, encoder->type == kHapCodecSubType ? true : false);
+    if (result != HapCodecResult_No_Error)
+        return result;
+    textures->dxt = HapCodecBufferGetBaseAddress(textures->dxtBuffer);
+
+    if (encoder->type == kHapYCoCgACodecSubType)
+    {
+        // Perform RGTC1 alpha compression
+        result = dxtEncode(encoder, src, srcPixelFormat, srcBytesPerRow, textures->alphaBuffer, encoder->alphaEncoder, true);
+    }
+    return result;
+}
+
+unsigned int HapCodecEncoderCompressTextures(HapCodecEncoderRef encoder,
+                                             const HapCodecEncoderTextures *textures,
+                                             void *dst,
+                                             unsigned long dstLength,
+                                             unsigned long *outputLength)
+{
+    unsigned int hapResult;
+    const void *inputBuffers[2];
+    unsigned long inputBufferLengths[2];
+    unsigned int textureFormats[2];
+    unsigned int compressors[2];
+    unsigned int chunkCounts[2];
+
+    if (encoder == NULL || textures == NULL || textures->dxt == NULL || dst == NULL || outputLength == NULL)
+        return HapCodecResult_Bad_Arguments;
+
+    inputBuffers[0] = textures->dxt;
+    inputBufferLengths[0] = encoder->textureLengths[0];
+    textureFormats[0] = encoder->textureFormats[0];
+
+    if (encoder->textureCount > 1)
+    {
+        if (textures->alphaBuffer == NULL)
+            return HapCodecResult_Bad_Arguments;
+        inputBuffers[1] = HapCodecBufferGetBaseAddress(textures->alphaBuffer);
+        inputBufferLengths[1] = encoder->textureLengths[1];
+        textureFormats[1] = encoder->textureFormats[1];
+    }
+
+    compressors[0] = compressors[1] = HapCompressorSnappy;
+    chunkCounts[0] = encoder->chunkCounts[0];
+    chunkCounts[1] = encoder->chunkCounts[1];
+
+    hapResult = HapEncodeWithOptions(encoder->textureCount,
+                                     inputBuffers,
+                                     inputBufferLengths,
+                                     textureFormats,
+                                     compressors,
+                                     chunkCounts,
+                                     encoder->hapOptions,
+                                     (HapEncodeCallback)HapMTEncode,
+                                     NULL,
+                                     dst,
+                                     dstLength,
+                                     outputLength);
+
+    switch (hapResult) {
+        case HapResult_No_Error:
+            return HapCodecResult_No_Error;
+        case HapResult_Buffer_Too_Small:
+            return HapCodecResult_Buffer_Too_Small;
+        default:
+            return HapCodecResult_Internal_Error;
+    }
+}
+
+void HapCodecEncoderTexturesRelease(HapCodecEncoderTextures *textures)
+{
+    if (textures)
+    {
+        HapCodecBufferReturn(textures->dxtBuffer);
+        HapCodecBufferReturn(textures->alphaBuffer);
+        textures->dxt = NULL;
+        textures->dxtBuffer = NULL;
+        textures->alphaBuffer = NULL;
+    }
+}
+
+unsigned int HapCodecEncoderEncodeFrame(HapCodecEncoderRef encoder,
+                                        const void *src,
+                                        unsigned int srcPixelFormat,
+                                        size_t srcBytesPerRow,
+                                        size_t srcLength,
+                                        void *dst,
+                                        unsigned long dstLength,
+                                        unsigned long *outputLength)
+{
+    HapCodecEncoderTextures textures;
+    unsigned int result = HapCodecEncoderAcquireTextures(encoder, srcPixelFormat, &textures);
+    if (result == HapCodecResult_No_Error)
+    {
+        result = HapCodecEncoderEncodeTextures(encoder, src, srcPixelFormat, srcBytesPerRow, srcLength, &textures);
+        if (result == HapCodecResult_No_Error)
+            result = HapCodecEncoderCompressTextures(encoder, &textures, dst, dstLength, outputLength);
+        HapCodecEncoderTexturesRelease(&textures);
+    }
+    return result;
+}
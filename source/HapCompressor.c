@@ -40,30 +40,14 @@
 #include "Utility.h"
 #include "PixelFormats.h"
 #include "HapCodecSubTypes.h"
-#include "hap.h"
+#include "HapCodecCore.h"
+#include "YCbCr.h"
 #include "Lock.h"
 #include "Tasks.h"
-#include "ParallelLoops.h"
 #include "Buffers.h"
-#include "DXTEncoder.h"
-#include "ImageMath.h"
 #if defined(DEBUG)
 #include <string.h>
 #endif
-/*
- On Apple we support GL encoding using the GPU.
- The GPU is very fast but produces low quality results
- Squish produces nicer results but takes longer.
- We select the GPU when the quality setting is above "High"
- YCoCg encodes YCoCg in DXT and requires a shader to draw, and produces very high quality results
- */
-
-#if defined(__APPLE__)
-#include "GLDXTEncoder.h"
-#endif
-#include "SquishEncoder.h"
-#include "YCoCg.h"
-#include "YCoCgDXTEncoder.h"
 
 typedef struct HapCodecCompressTask HapCodecCompressTask;
 
@@ -87,20 +71,8 @@ typedef struct {
     
     HapCodecBufferPoolRef           compressTaskPool;
     
-    HapCodecDXTEncoderRef           dxtEncoder;
-    HapCodecDXTEncoderRef           alphaEncoder;
-    
-    uint8_t                         *formatConvertBuffer;
-    size_t                          formatConvertBufferBytesPerRow;
-    
-    HapCodecBufferPoolRef           dxtBufferPool;
-    HapCodecBufferPoolRef           alphaBufferPool;
-    
-    unsigned int                    dxtFormat;
+    HapCodecEncoderRef              encoder;
     HapCodecTaskGroupRef            taskGroup;
-
-    unsigned int                    sliceCount;
-    unsigned int                    sliceHeight;
 #ifdef DEBUG
     unsigned int                    debugFrameCount;
     uint64_t                        debugStartTime;
@@ -111,35 +83,19 @@ typedef struct {
 #endif
 } HapCompressorGlobalsRecord, *HapCompressorGlobals;
 
-typedef struct HapCodecEncodeDXTTask HapCodecEncodeDXTTask;
-
-struct HapCodecEncodeDXTTask
-{
-    long                    width;
-    long                    height;
-    long                    sliceHeight;
-    OSType                  sourcePixelFormat;
-    size_t                  sourceBytesPerRow;
-    const uint8_t           *source;
-    OSType                  dxtInputFormat;
-    size_t                  dxtInputBytesPerRow;
-    uint8_t                 *dxtInput;
-    size_t                  dxtBytesPerRow;
-    uint8_t                 *dxt;
-    HapCodecDXTEncoderRef   encoder;
-};
-
 struct HapCodecCompressTask
 {
     HapCompressorGlobals            glob;
     ICMCompressorSourceFrameRef     sourceFrame;
-    CVPixelBufferRef                sourceFramePixelBuffer;
-    const uint8_t                   *sourceFramePixelBufferBaseAddress;
+    CVPixelBufferRef                sourceFramePixelBuffer; // locked until the task is done with it
+    const void                      *sourceFramePixelBufferBaseAddress;
+    OSType                          sourcePixelFormat;
+    size_t                          sourceBytesPerRow;
+    size_t                          sourceDataSize;
     ICMMutableEncodedFrameRef       encodedFrame;
     UInt8                           *encodedFrameDataPtr;
     unsigned long                   encodedFrameActualSize;
-    HapCodecBufferRef               dxtBuffer;
-    HapCodecBufferRef               alphaBuffer;
+    HapCodecEncoderTextures         textures;
     ComponentResult                 error;
     HapCodecBufferRef               next; // Used to queue finished tasks
 };
@@ -175,9 +131,8 @@ static void Background_Encode(void *info);
  createTask() returns a complete task or NULL on error (which is likely to be due to buffer allocation failure)
  */
 static HapCodecBufferRef createTask(HapCompressorGlobals glob,
-                                    HapCodecBufferRef dxtBuffer,
-                                    HapCodecBufferRef alphaBuffer,
                                     ICMCompressorSourceFrameRef sourceFrame,
+                                    CVPixelBufferRef lockedPixelBuffer,
                                     ICMMutableEncodedFrameRef encodedFrame);
 static void disposeTask(HapCodecCompressTask *task);
 static ComponentResult finishFrame(HapCodecBufferRef buffer);
@@ -221,16 +176,8 @@ Hap_COpen(
     glob->finishedFrames = NULL;
     glob->lock = HAP_CODEC_LOCK_INIT;
     glob->compressTaskPool = NULL;
-    glob->dxtEncoder = NULL;
-    glob->alphaEncoder = NULL;
-    glob->formatConvertBuffer = NULL;
-    glob->formatConvertBufferBytesPerRow = 0;
-    glob->dxtBufferPool = NULL;
-    glob->alphaBufferPool = NULL;
-    glob->dxtFormat = 0;
+    glob->encoder = NULL;
     glob->taskGroup = NULL;
-    glob->sliceCount = 1;
-    glob->sliceHeight = 4;
     
 bail:
     debug_print_err(glob, err);
@@ -257,18 +204,18 @@ Hap_CClose(
             
             unsigned int uncompressed = glob->width * glob->height;
             
-            if (glob->dxtFormat == HapTextureFormat_RGB_DXT1) uncompressed /= 2;
+            if (glob->type == kHapCodecSubType) uncompressed /= 2;
             uncompressed += 4U; // Hap uses 4 extra bytes
 
             sprintf(stringBuffer, "HAP CODEC: ");
             
-            if (glob->dxtEncoder == NULL)
+            if (HapCodecEncoderDescribe(glob->encoder) == NULL)
             {
                 sprintf(stringBuffer + strlen(stringBuffer), "DXT frames in");
             }
-            else if (glob->dxtEncoder->describe_function)
+            else
             {
-                sprintf(stringBuffer + strlen(stringBuffer), "%s ", glob->dxtEncoder->describe_function(glob->dxtEncoder));
+                sprintf(stringBuffer + strlen(stringBuffer), "%s ", HapCodecEncoderDescribe(glob->encoder));
             }
             sprintf(stringBuffer + strlen(stringBuffer), "%u frames over %.1f seconds %.1f FPS. ", glob->debugFrameCount, time, glob->debugFrameCount / time);
             sprintf(stringBuffer + strlen(stringBuffer), "Largest frame bytes: %lu smallest: %lu average: %lu ",
@@ -277,16 +224,6 @@ Hap_CClose(
             debug_print(glob, stringBuffer);
         }
 #endif
-        HapCodecDXTEncoderDestroy(glob->dxtEncoder);
-        glob->dxtEncoder = NULL;
-        
-#if defined(__APPLE__)
-        free(glob->formatConvertBuffer);
-#else
-        _aligned_free(glob->formatConvertBuffer);
-#endif
-        glob->formatConvertBuffer = NULL;
-        
         HapCodecTasksWaitForGroupToComplete(glob->taskGroup);
         HapCodecTasksDestroyGroup(glob->taskGroup);
         glob->taskGroup = NULL;
@@ -314,11 +251,9 @@ Hap_CClose(
         HapCodecBufferPoolDestroy(glob->compressTaskPool);
         glob->compressTaskPool = NULL;
 
-        HapCodecBufferPoolDestroy(glob->dxtBufferPool);
-        glob->dxtBufferPool = NULL;
-
-        HapCodecBufferPoolDestroy(glob->alphaBufferPool);
-        glob->alphaBufferPool = NULL;
+        // Destroy the encoder once no task holds its buffers
+        HapCodecEncoderDestroy(glob->encoder);
+        glob->encoder = NULL;
 
         HapCodecLockDestroy(&glob->lock);
         glob->lock = NULL;
@@ -409,34 +344,7 @@ Hap_CGetMaxCompressionSize(
 	if( ! size )
 		return paramErr;
 
-    unsigned int count = 1;
-    unsigned long sizes[2];
-    unsigned int chunks[2] = {1, 1};
-    unsigned int textureFormats[2];
-
-    switch (glob->type) {
-        case kHapAlphaCodecSubType:
-            textureFormats[0] = HapTextureFormat_RGBA_DXT5;
-            sizes[0] = dxtBytesForDimensions(srcRect->right - srcRect->left, srcRect->bottom - srcRect->top, glob->type);
-            break;
-        case kHapYCoCgCodecSubType:
-            textureFormats[0] = HapTextureFormat_YCoCg_DXT5;
-            sizes[0] = dxtBytesForDimensions(srcRect->right - srcRect->left, srcRect->bottom - srcRect->top, glob->type);
-            break;
-        case kHapYCoCgACodecSubType:
-            textureFormats[0] = HapTextureFormat_YCoCg_DXT5;
-            textureFormats[1] = HapTextureFormat_A_RGTC1;
-            sizes[0] = dxtBytesForDimensions(srcRect->right - srcRect->left, srcRect->bottom - srcRect->top, kHapYCoCgCodecSubType);
-            sizes[1] = dxtBytesForDimensions(srcRect->right - srcRect->left, srcRect->bottom - srcRect->top, kHapAOnlyCodecSubType);
-            count = 2;
-            break;
-        default:
-            textureFormats[0] = HapTextureFormat_RGB_DXT1;
-            sizes[0] = dxtBytesForDimensions(srcRect->right - srcRect->left, srcRect->bottom - srcRect->top, glob->type);
-            break;
-    }
-
-    *size = HapMaxEncodedLength(count, sizes, textureFormats, chunks);
+    *size = HapCodecEncoderGetMaxEncodedLength(glob->type, srcRect->right - srcRect->left, srcRect->bottom - srcRect->top);
     
 	return noErr;
 }
@@ -549,7 +457,7 @@ Hap_CPrepareToCompressFrames(
 {
 	ComponentResult err = noErr;
 	CFMutableDictionaryRef compressorPixelBufferAttributes = NULL;
-    OSType pixelFormatList[] = { k32BGRAPixelFormat, k32RGBAPixelFormat, 0, 0 };
+    OSType pixelFormatList[] = { k32BGRAPixelFormat, k32RGBAPixelFormat, 0, 0, 0, 0 };
     int pixelFormatCount;
 	Fixed gammaLevel;
     int maxTasks;
@@ -567,7 +475,10 @@ Hap_CPrepareToCompressFrames(
         case kHapYCoCgCodecSubType:
             pixelFormatList[2] = kHapCVPixelFormat_YCoCg_DXT5;
             pixelFormatList[3] = kHapCVPixelFormat_CoCgXY;
-            pixelFormatCount = 4;
+            // Y'CbCr from capture is converted to YCoCg as it is encoded, saving the host a conversion to RGB
+            pixelFormatList[4] = kHapCVPixelFormat_2vuy;
+            pixelFormatList[5] = kHapCVPixelFormat_v210;
+            pixelFormatCount = 6;
             break;
         case kHapYCoCgACodecSubType:
             pixelFormatCount = 2;
@@ -623,12 +534,6 @@ Hap_CPrepareToCompressFrames(
         }
         
         glob->quality = quality;
-        
-        glob->dxtFormat = glob->type == kHapAlphaCodecSubType ? HapTextureFormat_RGBA_DXT5 : HapTextureFormat_RGB_DXT1;
-    }
-    else
-    {
-        glob->dxtFormat = HapTextureFormat_YCoCg_DXT5;
     }
     
     // Create a pixel buffer attributes dictionary.
@@ -639,10 +544,30 @@ Hap_CPrepareToCompressFrames(
                                                 &compressorPixelBufferAttributes );
 	if( err )
 		goto bail;
+
+    // Ask for Y'CbCr with the matrix the encoder will assume
+    if (glob->type == kHapYCoCgCodecSubType)
+    {
+        CFDictionaryAddValue(compressorPixelBufferAttributes,
+                             kCVImageBufferYCbCrMatrixKey,
+                             (HapCodecYCbCrMatrixForWidth(glob->width) == HapCodecYCbCrMatrix_ITU_R_709 ? kCVImageBufferYCbCrMatrix_ITU_R_709_2 : kCVImageBufferYCbCrMatrix_ITU_R_601_4));
+    }
     
 	*compressorPixelBufferAttributesOut = compressorPixelBufferAttributes;
 	compressorPixelBufferAttributes = NULL;
     
+    // The encoder selects the GPU DXT encoder (on Apple) or Squish's fastest setting for qualities below "High"
+    HapCodecEncoderDestroy(glob->encoder);
+    glob->encoder = HapCodecEncoderCreate(glob->type,
+                                          glob->width,
+                                          glob->height,
+                                          (glob->quality < codecHighQuality ? HapCodecEncoderQuality_Fast : HapCodecEncoderQuality_Normal));
+    if (glob->encoder == NULL)
+    {
+        err = memFullErr;
+        goto bail;
+    }
+
     // Work out the upper bound on encoded frame data size -- we'll allocate buffers of this size.
     srcRect = (Rect){0, 0, glob->height, glob->width};
     Hap_CGetMaxCompressionSize(glob, NULL, &srcRect, 0, codecLosslessQuality, &glob->maxEncodedDataSize);
@@ -666,27 +591,6 @@ Hap_CPrepareToCompressFrames(
     
     glob->taskGroup = HapCodecTasksCreateGroup(Background_Encode, maxTasks);
 
-    {
-        // Slice on DXT row boundaries
-        unsigned int totalDXTRows = roundUpToMultipleOf4(glob->height) / 4;
-        unsigned int remainder;
-        glob->sliceCount = totalDXTRows < 30 ? totalDXTRows : 30;
-        glob->sliceHeight = (totalDXTRows / glob->sliceCount) * 4;
-        remainder = (totalDXTRows % glob->sliceCount) * 4;
-        while (remainder > 0)
-        {
-            glob->sliceCount++;
-            if (remainder > glob->sliceHeight)
-            {
-                remainder -= glob->sliceHeight;
-            }
-            else
-            {
-                remainder = 0;
-            }
-        }
-    }
-
 #ifdef DEBUG    
     glob->debugStartTime = CVGetCurrentHostTime();
 #endif
@@ -696,131 +600,32 @@ bail:
 	return err;
 }
 
-static void Encode_Slice(void *p, unsigned int index)
-{
-    HapCodecEncodeDXTTask *task = (HapCodecEncodeDXTTask *)p;
-
-    unsigned int sliceHeight = task->sliceHeight;
-    if ((index + 1) * sliceHeight > (unsigned int)task->height)
-        sliceHeight = task->height - (index * sliceHeight);
-
-    const uint8_t *src = task->source + (index * task->sliceHeight * task->sourceBytesPerRow);
-    uint8_t *dxtInput = task->dxtInput + (index * task->sliceHeight * task->dxtInputBytesPerRow);
-    uint8_t *dxt = task->dxt + (index * task->sliceHeight * task->dxtBytesPerRow);
-
-    if (task->dxtInputFormat != task->sourcePixelFormat)
-    {
-        // for all these we pass 0 as last argument so we don't tile, we are already multithreaded
-        switch (task->dxtInputFormat)
-        {
-            case kHapCVPixelFormat_CoCgXY:
-                if (task->sourcePixelFormat == k32BGRAPixelFormat)
-                {
-                    ConvertBGR_ToCoCg_Y8888(src,
-                                            dxtInput,
-                                            task->width,
-                                            sliceHeight,
-                                            task->sourceBytesPerRow,
-                                            task->dxtInputBytesPerRow,
-                                            0);
-                }
-                else
-                {
-                    ConvertRGB_ToCoCg_Y8888(src,
-                                            dxtInput,
-                                            task->width,
-                                            sliceHeight,
-                                            task->sourceBytesPerRow,
-                                            task->dxtInputBytesPerRow,
-                                            0);
-                }
-                break;
-            case k32RGBAPixelFormat:
-                if (task->sourcePixelFormat == k32BGRAPixelFormat)
-                {
-                    uint8_t permuteMap[] = {2, 1, 0, 3};
-                    ImageMath_Permute8888(src,
-                                          task->sourceBytesPerRow,
-                                          dxtInput,
-                                          task->dxtInputBytesPerRow,
-                                          task->width,
-                                          sliceHeight,
-                                          permuteMap,
-                                          0);
-                }
-                break;
-            default:
-                break;
-        }
-    }
-
-    if (task->encoder->can_slice)
-    {
-        // Encode the DXT frame
-        task->encoder->encode_function(task->encoder,
-                                       dxtInput,
-                                       task->dxtInputBytesPerRow,
-                                       task->dxtInputFormat,
-                                       dxt,
-                                       task->width,
-                                       sliceHeight);
-    }
-}
-
 static void Background_Encode(void *info)
 {
     HapCodecCompressTask *task = (HapCodecCompressTask *)HapCodecBufferGetBaseAddress((HapCodecBufferRef)info);
     HapCompressorGlobals glob = task->glob;
 
-    unsigned int hapResult;
-    const void *inputBuffers[2];
-    unsigned long inputBufferLengths[2];
-    unsigned int textureFormats[2];
-    unsigned int compressors[2];
-    unsigned int chunkCounts[2];
-    unsigned int bufferCount;
-
     ComponentResult err = noErr;
-    
-    if (task->dxtBuffer)
-    {
-        inputBuffers[0] = HapCodecBufferGetBaseAddress(task->dxtBuffer);
-        inputBufferLengths[0] = HapCodecBufferGetSize(task->dxtBuffer);
-    }
-    else
-    {
-        inputBuffers[0] = task->sourceFramePixelBufferBaseAddress;
-        inputBufferLengths[0] = dxtBytesForDimensions(glob->width, glob->height, glob->type);
-    }
-
-    textureFormats[0] = glob->dxtFormat;
-
-    if (task->alphaBuffer)
-    {
-        bufferCount = 2;
-        inputBuffers[1] = HapCodecBufferGetBaseAddress(task->alphaBuffer);
-        inputBufferLengths[1] = HapCodecBufferGetSize(task->alphaBuffer);
-        textureFormats[1] = HapTextureFormat_A_RGTC1;
-    }
-    else
-    {
-        bufferCount = 1;
+    unsigned int result;
+
+    // Perform any pixel-format conversion and DXT compression into the textures acquired by createTask()
+    result = HapCodecEncoderEncodeTextures(glob->encoder,
+                                           task->sourceFramePixelBufferBaseAddress,
+                                           task->sourcePixelFormat,
+                                           task->sourceBytesPerRow,
+                                           task->sourceDataSize,
+                                           &task->textures);
+    if (result != HapCodecResult_No_Error)
+    {
+        err = (result == HapCodecResult_Out_Of_Memory ? memFullErr : internalComponentErr);
+        goto bail;
     }
 
-    compressors[0] = compressors[1] = HapCompressorSnappy;
-    chunkCounts[0] = chunkCounts[1] = 1;
-
-    hapResult = HapEncode(bufferCount,
-                          inputBuffers,
-                          inputBufferLengths,
-                          textureFormats,
-                          compressors,
-                          chunkCounts,
-                          task->encodedFrameDataPtr,
-                          glob->maxEncodedDataSize,
-                          &(task->encodedFrameActualSize));
-
-    if (hapResult != HapResult_No_Error)
+    if (HapCodecEncoderCompressTextures(glob->encoder,
+                                        &task->textures,
+                                        task->encodedFrameDataPtr,
+                                        glob->maxEncodedDataSize,
+                                        &(task->encodedFrameActualSize)) != HapCodecResult_No_Error)
     {
         err = internalComponentErr;
         goto bail;
@@ -838,16 +643,7 @@ static void Background_Encode(void *info)
 bail:
     debug_print_err(glob, err);
 
-    if (task->dxtBuffer)
-    {
-        HapCodecBufferReturn(task->dxtBuffer);
-        task->dxtBuffer = NULL;
-    }
-    if (task->alphaBuffer)
-    {
-        HapCodecBufferReturn(task->alphaBuffer);
-        task->alphaBuffer = NULL;
-    }
+    HapCodecEncoderTexturesRelease(&task->textures);
 #if defined(__APPLE__)
     if (task->sourceFramePixelBuffer)
     {
@@ -864,60 +660,6 @@ bail:
     queueEncodedFrame(glob, (HapCodecBufferRef)info);
 }
 
-// Perform pixel-format conversion and DXT encoding
-// Lock the CVPixelBuffer prior to calling (and unlock after)
-static ComponentResult
-dxtEncode(HapCompressorGlobals glob, CVPixelBufferRef sourcePixelBuffer, HapCodecBufferRef destinationDXTBuffer, HapCodecDXTEncoderRef encoder, Boolean isDXT1orRGTC1)
-{
-    HapCodecEncodeDXTTask dxtTask;
-    OSType sourceFormat = CVPixelBufferGetPixelFormatType(sourcePixelBuffer);
-
-    dxtTask.width = glob->width;
-    dxtTask.height = glob->height;
-    dxtTask.encoder = encoder;
-    dxtTask.sliceHeight = glob->sliceHeight;
-    dxtTask.sourceBytesPerRow = CVPixelBufferGetBytesPerRow(sourcePixelBuffer);
-    dxtTask.sourcePixelFormat = sourceFormat;
-    dxtTask.source = CVPixelBufferGetBaseAddress(sourcePixelBuffer);
-    dxtTask.dxtInputFormat = encoder->pixelformat_function(encoder, sourceFormat);
-    dxtTask.dxtBytesPerRow = roundUpToMultipleOf4(glob->width);
-    if (isDXT1orRGTC1)
-        dxtTask.dxtBytesPerRow /= 2;
-
-    // If necessary, convert the pixels to a format the encoder can ingest
-    if (dxtTask.dxtInputFormat != sourceFormat)
-    {
-        if ((dxtTask.dxtInputFormat == k32RGBAPixelFormat && dxtTask.dxtInputFormat != k32BGRAPixelFormat) ||
-            (dxtTask.dxtInputFormat != kHapCVPixelFormat_CoCgXY && dxtTask.dxtInputFormat != k32RGBAPixelFormat))
-        {
-            return internalComponentErr;
-        }
-        dxtTask.dxtInput = glob->formatConvertBuffer;
-        dxtTask.dxtInputBytesPerRow = glob->formatConvertBufferBytesPerRow;
-    }
-    else // wantedPixelFormat == sourcePixelFormat
-    {
-        dxtTask.dxtInput = (uint8_t *)dxtTask.source;
-        dxtTask.dxtInputBytesPerRow = dxtTask.sourceBytesPerRow;
-    }
-
-    dxtTask.dxt = HapCodecBufferGetBaseAddress(destinationDXTBuffer);
-
-    HapParallelFor(Encode_Slice, &dxtTask, glob->sliceCount);
-
-    if (dxtTask.encoder->can_slice == false)
-    {
-        dxtTask.encoder->encode_function(dxtTask.encoder,
-                                         dxtTask.dxtInput,
-                                         dxtTask.dxtInputBytesPerRow,
-                                         dxtTask.dxtInputFormat,
-                                         dxtTask.dxt,
-                                         dxtTask.width,
-                                         dxtTask.height);
-    }
-    return noErr;
-}
-
 // Presents the compressor with a frame to encode.
 // The compressor may encode the frame immediately or queue it for later encoding.
 // If the compressor queues the frame for later decode, it must retain it (by calling ICMCompressorSourceFrameRetain)
@@ -932,180 +674,18 @@ Hap_CEncodeFrame(
 	ComponentResult err = noErr;
     
     CVPixelBufferRef sourcePixelBuffer = ICMCompressorSourceFrameGetPixelBuffer(sourceFrame);
-    OSType sourceFormat = CVPixelBufferGetPixelFormatType(sourcePixelBuffer);
     HapCodecBufferRef buffer = NULL;
-    HapCodecBufferRef dxtBuffer = NULL;
-    HapCodecBufferRef alphaBuffer = NULL;
     ICMMutableEncodedFrameRef encodedFrame = NULL;
 
     if (CVPixelBufferGetWidth(sourcePixelBuffer) != glob->width || CVPixelBufferGetHeight(sourcePixelBuffer) != glob->height)
         return internalComponentErr;
 
-    if (isDXTPixelFormat(sourceFormat))
+    // The pixel buffer stays locked until the task has finished with it
+    if (CVPixelBufferLockBaseAddress(sourcePixelBuffer, kHapCodecCVPixelBufferLockFlags) != kCVReturnSuccess)
     {
-        size_t expectedDXTLength = dxtBytesForDimensions(glob->width, glob->height, glob->type);
-
-        if (CVPixelBufferGetDataSize(sourcePixelBuffer) < expectedDXTLength)
-            return internalComponentErr;
-    }
-    else
-    {
-        // Create a DXT encoder if one will be needed by this frame
-        if (glob->dxtEncoder == NULL)
-        {
-            if (glob->type == kHapYCoCgCodecSubType || glob->type == kHapYCoCgACodecSubType)
-            {
-                glob->dxtEncoder = HapCodecYCoCgDXTEncoderCreate();
-            }
-#if defined(__APPLE__)
-            else if (glob->quality < codecHighQuality)
-            {
-                glob->dxtEncoder = HapCodecGLEncoderCreate(glob->width,
-                                                           glob->height,
-                                                           (glob->type == kHapAlphaCodecSubType ? kHapCVPixelFormat_RGBA_DXT5 : kHapCVPixelFormat_RGB_DXT1));
-            }
-#endif
-            else
-            {
-                HapCodecSquishEncoderQuality squishQuality = (glob->quality < codecHighQuality ? HapCodecSquishEncoderWorstQuality : HapCodecSquishEncoderMediumQuality);
-                OSType squishPixelFormat = (glob->type == kHapAlphaCodecSubType ? kHapCVPixelFormat_RGBA_DXT5 : kHapCVPixelFormat_RGB_DXT1);
-                glob->dxtEncoder = HapCodecSquishEncoderCreate(squishQuality, squishPixelFormat);
-            }
-            
-            if (glob->dxtEncoder == NULL)
-            {
-                err = internalComponentErr;
-                goto bail;
-            }
-        }
-
-        if (glob->type == kHapYCoCgACodecSubType && glob->alphaEncoder == NULL)
-        {
-            glob->alphaEncoder = HapCodecSquishEncoderCreate(HapCodecSquishEncoderBestQuality, kHapCVPixelFormat_A_RGTC1);
-            if (glob->alphaEncoder == NULL)
-            {
-                err = internalComponentErr;
-                goto bail;
-            }
-        }
-
-        // Create a DXT buffer pool if one doesn't already exist
-        if (glob->dxtBufferPool == NULL)
-        {
-            long wantedDXTSize = dxtBytesForDimensions(glob->width, glob->height, glob->type);
-            
-            glob->dxtBufferPool = HapCodecBufferPoolCreate(wantedDXTSize);
-            
-            if (glob->dxtBufferPool == NULL)
-            {
-                err = internalComponentErr;
-                goto bail;
-            }
-        }
-
-        if (glob->type == kHapYCoCgACodecSubType && glob->alphaBufferPool == NULL)
-        {
-            long wantedDXTSize = dxtBytesForDimensions(glob->width, glob->height, kHapAOnlyCodecSubType);
-
-            glob->alphaBufferPool = HapCodecBufferPoolCreate(wantedDXTSize);
-
-            if (glob->alphaBufferPool == NULL)
-            {
-                err = internalComponentErr;
-                goto bail;
-            }
-        }
-
-        if (glob->formatConvertBuffer == NULL)
-        {
-            OSType wantedPixelFormat = glob->dxtEncoder->pixelformat_function(glob->dxtEncoder, sourceFormat);
-            
-            // Create a buffer to convert the RGBA pixel buffer to an ordering the DXT encoder supports
-            if (wantedPixelFormat != sourceFormat)
-            {
-                size_t wantedConvertBufferBytesPerRow = roundUpToMultipleOf16(glob->width * 4);
-                size_t wantedBufferSize = wantedConvertBufferBytesPerRow * glob->height;
-#if defined(__APPLE__)
-                glob->formatConvertBuffer = malloc(wantedBufferSize);
-#else
-                glob->formatConvertBuffer = (uint8_t *)_aligned_malloc(wantedBufferSize, 16);
-#endif
-
-                if (glob->formatConvertBuffer == NULL)
-                {
-                    err = memFullErr;
-                    goto bail;
-                }
-                glob->formatConvertBufferBytesPerRow = wantedConvertBufferBytesPerRow;
-            }
-        }
-    }
-
-    if (!isDXTPixelFormat(sourceFormat) || glob->type == kHapYCoCgACodecSubType)
-    {
-        if (CVPixelBufferLockBaseAddress(sourcePixelBuffer, kHapCodecCVPixelBufferLockFlags) != kCVReturnSuccess)
-        {
-            err = internalComponentErr;
-            goto bail;
-        }
-
-        if (!isDXTPixelFormat(sourceFormat))
-        {
-            // Perform DXT compression
-
-            dxtBuffer = HapCodecBufferCreate(glob->dxtBufferPool);
-
-            if (dxtBuffer == NULL)
-            {
-                // Try again after finishing any background frames
-                Hap_CCompleteFrame(glob, NULL, 0);
-                dxtBuffer = HapCodecBufferCreate(glob->dxtBufferPool);
-            }
-
-            if (dxtBuffer == NULL)
-            {
-                err = memFullErr;
-                goto bail;
-            }
-
-            err = dxtEncode(glob, sourcePixelBuffer, dxtBuffer, glob->dxtEncoder, glob->type == kHapCodecSubType ? true : false);
-            if (err != noErr)
-            {
-                goto bail;
-            }
-        }
-
-        if (glob->type == kHapYCoCgACodecSubType)
-        {
-            // Perform RGTC1 alpha compression
-
-            alphaBuffer = HapCodecBufferCreate(glob->alphaBufferPool);
-
-            if (alphaBuffer == NULL)
-            {
-                // Try again after finishing any background frames
-                Hap_CCompleteFrame(glob, NULL, 0);
-                alphaBuffer = HapCodecBufferCreate(glob->alphaBufferPool);
-            }
-
-            if (alphaBuffer == NULL)
-            {
-                err = memFullErr;
-                goto bail;
-            }
-
-            err = dxtEncode(glob, sourcePixelBuffer, alphaBuffer, glob->alphaEncoder, true);
-            if (err != noErr)
-            {
-                goto bail;
-            }
-        }
-
-        CVPixelBufferUnlockBaseAddress(sourcePixelBuffer, kHapCodecCVPixelBufferLockFlags);
-
-        // Detach the sourceFrame as soon as we are finished with it
-        ICMCompressorSourceFrameDetachPixelBuffer(sourceFrame);
         sourcePixelBuffer = NULL;
+        err = internalComponentErr;
+        goto bail;
     }
 
     // Create an empty encoded frame
@@ -1115,7 +695,7 @@ Hap_CEncodeFrame(
     
     if (err == noErr)
     {
-        buffer = createTask(glob, dxtBuffer, alphaBuffer, sourceFrame, encodedFrame);
+        buffer = createTask(glob, sourceFrame, sourcePixelBuffer, encodedFrame);
         if (buffer == NULL)
             err = memFullErr;
     }
@@ -1127,9 +707,11 @@ Hap_CEncodeFrame(
 
         if (encodedFrame == NULL)
             err = ICMEncodedFrameCreateMutable(glob->session, sourceFrame, glob->maxEncodedDataSize, &encodedFrame);
+        else
+            err = noErr;
 
         if (err == noErr)
-            buffer = createTask(glob, dxtBuffer, alphaBuffer, sourceFrame, encodedFrame);
+            buffer = createTask(glob, sourceFrame, sourcePixelBuffer, encodedFrame);
     }
 
     ICMEncodedFrameRelease(encodedFrame);
@@ -1142,8 +724,9 @@ Hap_CEncodeFrame(
     }
 
     HapCodecTasksAddTask(glob->taskGroup, buffer);
-    sourceFrame = NULL; // indicate to bail: that we don't need to drop it
-    dxtBuffer = NULL; // ditto
+    // indicate to bail: that the task now owns these
+    sourceFrame = NULL;
+    sourcePixelBuffer = NULL;
 
     // Dequeue and deliver any encoded frames
     do
@@ -1162,9 +745,10 @@ bail:
     {
         ICMEncodedFrameRelease(encodedFrame);
     }
+    if (sourcePixelBuffer)
+        CVPixelBufferUnlockBaseAddress(sourcePixelBuffer, kHapCodecCVPixelBufferLockFlags);
     if (sourceFrame)
         ICMCompressorSessionDropFrame(glob->session, sourceFrame);
-    HapCodecBufferReturn(dxtBuffer);
     debug_print_err(glob, err);
 	return err;
 }
@@ -1221,8 +805,7 @@ static void disposeTask(HapCodecCompressTask *task)
         }
         ICMCompressorSourceFrameRelease(task->sourceFrame);
         ICMEncodedFrameRelease(task->encodedFrame);
-        HapCodecBufferReturn(task->dxtBuffer);
-        HapCodecBufferReturn(task->alphaBuffer);
+        HapCodecEncoderTexturesRelease(&task->textures);
     }
 }
 
@@ -1311,9 +894,8 @@ static HapCodecBufferRef dequeueNextFrameOut(HapCompressorGlobals glob)
 }
 
 static HapCodecBufferRef createTask(HapCompressorGlobals glob,
-                                    HapCodecBufferRef dxtBuffer,
-                                    HapCodecBufferRef alphaBuffer,
                                     ICMCompressorSourceFrameRef sourceFrame,
+                                    CVPixelBufferRef lockedPixelBuffer,
                                     ICMMutableEncodedFrameRef encodedFrame)
 {
     HapCodecBufferRef buffer = HapCodecBufferCreate(glob->compressTaskPool);
@@ -1321,24 +903,26 @@ static HapCodecBufferRef createTask(HapCompressorGlobals glob,
     {
         HapCodecCompressTask *task = (HapCodecCompressTask *)HapCodecBufferGetBaseAddress(buffer);
 
-        task->sourceFrame = ICMCompressorSourceFrameRetain(sourceFrame);
-        task->sourceFramePixelBuffer = ICMCompressorSourceFrameGetPixelBuffer(sourceFrame);
-        if (task->sourceFramePixelBuffer)
+        // Acquire the texture buffers now so a failure can be recovered from by finishing pending frames
+        if (HapCodecEncoderAcquireTextures(glob->encoder,
+                                           CVPixelBufferGetPixelFormatType(lockedPixelBuffer),
+                                           &task->textures) != HapCodecResult_No_Error)
         {
-            CVPixelBufferLockBaseAddress(task->sourceFramePixelBuffer, kHapCodecCVPixelBufferLockFlags);
-            task->sourceFramePixelBufferBaseAddress = CVPixelBufferGetBaseAddress(task->sourceFramePixelBuffer);
-        }
-        else
-        {
-            task->sourceFramePixelBufferBaseAddress = NULL;
+            HapCodecBufferReturn(buffer);
+            return NULL;
         }
+
+        task->sourceFrame = ICMCompressorSourceFrameRetain(sourceFrame);
+        task->sourceFramePixelBuffer = lockedPixelBuffer;
+        task->sourceFramePixelBufferBaseAddress = CVPixelBufferGetBaseAddress(lockedPixelBuffer);
+        task->sourcePixelFormat = CVPixelBufferGetPixelFormatType(lockedPixelBuffer);
+        task->sourceBytesPerRow = CVPixelBufferGetBytesPerRow(lockedPixelBuffer);
+        task->sourceDataSize = CVPixelBufferGetDataSize(lockedPixelBuffer);
         task->glob = glob;
         task->encodedFrame = (ICMMutableEncodedFrameRef)ICMEncodedFrameRetain(encodedFrame);
         task->encodedFrameDataPtr = ICMEncodedFrameGetDataPtr(encodedFrame);
         task->error = noErr;
         task->next = NULL;
-        task->dxtBuffer = dxtBuffer;
-        task->alphaBuffer = alphaBuffer;
     }
     return buffer;
 }
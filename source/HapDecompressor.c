@@ -39,40 +39,7 @@
 #include "Utility.h"
 #include "PixelFormats.h"
 #include "HapCodecSubTypes.h"
-#include "hap.h"
-#include "Buffers.h"
-#include "ParallelLoops.h"
-#include "YCoCg.h"
-#include "YCoCgDXT.h"
-
-/*
- Defines determine the decoding methods available.
- MacOS supports the required EXT_texture_compression_s3tc extension at least as far back as 10.5
- so we don't enable squish decoding at all. For Windows we currently use Squish.
- If both are enabled, squish will be used as a fallback when the extension is not available.
- */
-
-#if defined(__APPLE__)
-#define HAP_GPU_DECODE
-#else
-#define HAP_SQUISH_DECODE
-#endif
-
-#ifndef HAP_GPU_DECODE
-    #ifndef HAP_SQUISH_DECODE
-        #error Neither HAP_GPU_DECODE nor HAP_SQUISH_DECODE is defined. #define one or both.
-    #endif
-#endif
-
-#ifdef HAP_GPU_DECODE
-    #include "HapCodecGL.h"
-#endif
-
-#ifdef HAP_SQUISH_DECODE
-    #include "SquishDecoder.h"
-#endif
-
-#include "SquishRGTC1Decoder.h"
+#include "HapCodecCore.h"
 
 // Data structures
 typedef struct	{
@@ -85,30 +52,13 @@ typedef struct	{
     long                        dxtWidth;
     long                        dxtHeight;
 	Handle						wantedDestinationPixelTypes;
-    HapCodecBufferPoolRef       dxtBufferPool;
-    HapCodecBufferPoolRef       alphaBufferPool;
-    HapCodecBufferPoolRef       convertBufferPool;
-#ifdef HAP_GPU_DECODE
-    HapCodecGLRef               glDecoder;
-#endif
+    HapCodecDecoderRef          decoder;
 } HapDecompressorGlobalsRecord, *HapDecompressorGlobals;
 
 typedef struct {
-	long                        width;
-	long                        height;
-    long                        dxtWidth;
-    long                        dxtHeight;
 	size_t                      dataSize;
-    Boolean                     hasColour;
-    Boolean                     hasAlpha;
-    unsigned int                dxtFormat;
-    unsigned int                dxtIndex;
-    unsigned int                alphaIndex;
-    OSType                      destFormat;
 	Boolean                     decoded;
-    HapCodecBufferRef           dxtBuffer;
-    HapCodecBufferRef           alphaBuffer;
-    HapCodecBufferRef           convertBuffer; // used for YCoCg -> RGB
+    HapCodecDecoderFrame        frame;
 } HapDecompressRecord;
 
 // Setup required for ComponentDispatchHelper.c
@@ -145,13 +95,19 @@ struct PlanarPixmapInfoHapYCoCgA {
 };
 
 typedef struct PlanarPixmapInfoHapYCoCgA PlanarPixmapInfoHapYCoCgA;
-/*
- Callback for multithreaded Hap decoding
- */
 
-void HapMTDecode(HapDecodeWorkFunction function, void *p, unsigned int count, void *info HAP_ATTR_UNUSED)
+static ComponentResult errorForHapCodecResult(unsigned int result)
 {
-    HapParallelFor((HapParallelFunction)function, p, count);
+    switch (result) {
+        case HapCodecResult_No_Error:
+            return noErr;
+        case HapCodecResult_Bad_Frame:
+            return codecBadDataErr;
+        case HapCodecResult_Out_Of_Memory:
+            return memFullErr;
+        default:
+            return internalComponentErr;
+    }
 }
 
 /* -- This Image Decompressor User the Base Image Decompressor Component --
@@ -191,13 +147,12 @@ ComponentResult Hap_DOpen(HapDecompressorGlobals glob, ComponentInstance self)
 	glob->self = self;
 	glob->target = self;
     glob->type = componentDescription.componentSubType;
-	glob->dxtBufferPool = NULL;
-    glob->alphaBufferPool = NULL;
-    glob->convertBufferPool = NULL;
-
-#ifdef HAP_GPU_DECODE
-    glob->glDecoder = NULL;
-#endif
+    glob->decoder = HapCodecDecoderCreate();
+    if (glob->decoder == NULL)
+    {
+        err = memFullErr;
+        goto bail;
+    }
     
 	// Open and target an instance of the base decompressor as we delegate
 	// most of our calls to the base decompressor instance
@@ -225,15 +180,7 @@ ComponentResult Hap_DClose(HapDecompressorGlobals glob, ComponentInstance self H
 			CloseComponent(glob->delegateComponent);
 		}
 		
-        HapCodecBufferPoolDestroy(glob->dxtBufferPool);
-        HapCodecBufferPoolDestroy(glob->alphaBufferPool);
-#ifdef HAP_GPU_DECODE
-        if (glob->glDecoder)
-        {
-            HapCodecGLDestroy(glob->glDecoder);
-        }
-#endif
-        HapCodecBufferPoolDestroy(glob->convertBufferPool);
+        HapCodecDecoderDestroy(glob->decoder);
         
 		DisposeHandle( glob->wantedDestinationPixelTypes );
 		glob->wantedDestinationPixelTypes = NULL;
@@ -323,7 +270,7 @@ ComponentResult Hap_DPreflight(HapDecompressorGlobals glob, CodecDecompressParam
 	capabilities->wantedPixelSize = 0; // set this to zero when using wantedDestinationPixelTypes
 	if( NULL == glob->wantedDestinationPixelTypes )
     {
-		glob->wantedDestinationPixelTypes = NewHandleClear( 4 * sizeof(OSType) );
+		glob->wantedDestinationPixelTypes = NewHandleClear( 6 * sizeof(OSType) );
 		if( NULL == glob->wantedDestinationPixelTypes )
         {
             err =  memFullErr;
@@ -337,18 +284,22 @@ ComponentResult Hap_DPreflight(HapDecompressorGlobals glob, CodecDecompressParam
     (*p->wantedDestinationPixelTypes)[0] = k32RGBAPixelFormat;
 	(*p->wantedDestinationPixelTypes)[1] = k32BGRAPixelFormat;
     
+    // Y'CbCr is converted from the decoded blocks, for video outputs which would otherwise convert from RGB themselves
+    (*p->wantedDestinationPixelTypes)[2] = kHapCVPixelFormat_2vuy;
+    (*p->wantedDestinationPixelTypes)[3] = kHapCVPixelFormat_v210;
+    
     switch (glob->type) {
         case kHapCodecSubType:
-            (*p->wantedDestinationPixelTypes)[2] = kHapCVPixelFormat_RGB_DXT1;
+            (*p->wantedDestinationPixelTypes)[4] = kHapCVPixelFormat_RGB_DXT1;
             break;
         case kHapYCoCgCodecSubType:
-            (*p->wantedDestinationPixelTypes)[2] = kHapCVPixelFormat_YCoCg_DXT5;
+            (*p->wantedDestinationPixelTypes)[4] = kHapCVPixelFormat_YCoCg_DXT5;
             break;
         case kHapAlphaCodecSubType:
-            (*p->wantedDestinationPixelTypes)[2] = kHapCVPixelFormat_RGBA_DXT5;
+            (*p->wantedDestinationPixelTypes)[4] = kHapCVPixelFormat_RGBA_DXT5;
             break;
         case kHapYCoCgACodecSubType:
-            (*p->wantedDestinationPixelTypes)[2] = kHapCVPixelFormat_YCoCg_DXT5_A_RGTC1;
+            (*p->wantedDestinationPixelTypes)[4] = kHapCVPixelFormat_YCoCg_DXT5_A_RGTC1;
             break;
         default:
             err = internalComponentErr;
@@ -356,7 +307,7 @@ ComponentResult Hap_DPreflight(HapDecompressorGlobals glob, CodecDecompressParam
             break;
     }
 
-	(*p->wantedDestinationPixelTypes)[3] = 0;
+	(*p->wantedDestinationPixelTypes)[5] = 0;
     
 	// Specify the number of pixels the image must be extended in width and height if
 	// the component cannot accommodate the image at its given width and height.
@@ -399,18 +350,13 @@ ComponentResult Hap_DBeginBand(HapDecompressorGlobals glob, CodecDecompressParam
 {
 	OSStatus err = noErr;
 	HapDecompressRecord *myDrp = (HapDecompressRecord *)drp->userDecompressRecord;
-    unsigned int hap_result;
-    unsigned int frame_texture_count;
-
-	myDrp->width = (**p->imageDescription).width;
-	myDrp->height = (**p->imageDescription).height;
-    myDrp->dxtWidth = glob->dxtWidth;
-    myDrp->dxtHeight = glob->dxtHeight;
-    myDrp->convertBuffer = myDrp->dxtBuffer = myDrp->alphaBuffer = NULL;
-    myDrp->alphaIndex = myDrp->dxtIndex;
-    myDrp->hasAlpha = myDrp->hasColour = false;
-    
-    if (myDrp->width != glob->width || myDrp->height != glob->height)
+    long width = (**p->imageDescription).width;
+    long height = (**p->imageDescription).height;
+    unsigned int result;
+
+    myDrp->frame.colourBuffer = myDrp->frame.alphaBuffer = myDrp->frame.scratchBuffer = NULL;
+
+    if (width != glob->width || height != glob->height)
     {
         err = internalComponentErr;
         goto bail;
@@ -433,113 +379,20 @@ ComponentResult Hap_DBeginBand(HapDecompressorGlobals glob, CodecDecompressParam
     
 	myDrp->decoded = p->frameTime ? (0 != (p->frameTime->flags & icmFrameAlreadyDecoded)) : false;
     
-    myDrp->destFormat = p->dstPixMap.pixelFormat;
-    
-    // Inspect the frame header to discover the texture format(s)
-    hap_result = HapGetFrameTextureCount(drp->codecData, myDrp->dataSize, &frame_texture_count);
-    if (hap_result != HapResult_No_Error)
+    // Inspect the frame header to discover the texture format(s) and obtain any buffers we need
+    result = HapCodecDecoderBeginFrame(glob->decoder,
+                                       &myDrp->frame,
+                                       drp->codecData,
+                                       myDrp->dataSize,
+                                       (unsigned int)width,
+                                       (unsigned int)height,
+                                       p->dstPixMap.pixelFormat);
+    if (result != HapCodecResult_No_Error)
     {
-        err = internalComponentErr;
+        err = errorForHapCodecResult(result);
         goto bail;
     }
 
-    for (unsigned int i = 0; i < frame_texture_count; i++) {
-        unsigned int texture_format;
-        hap_result = HapGetFrameTextureFormat(drp->codecData, myDrp->dataSize, i, &texture_format);
-        if (hap_result != HapResult_No_Error)
-        {
-            err = internalComponentErr;
-            goto bail;
-        }
-        if (texture_format == HapTextureFormat_A_RGTC1)
-        {
-            myDrp->alphaIndex = i;
-            myDrp->hasAlpha = true;
-        }
-        else if (texture_format == HapTextureFormat_RGB_DXT1 || texture_format == HapTextureFormat_RGBA_DXT5 || texture_format == HapTextureFormat_YCoCg_DXT5)
-        {
-            myDrp->dxtIndex = i;
-            myDrp->dxtFormat = texture_format;
-            myDrp->hasColour = true;
-        }
-    }
-
-    if (!isDXTPixelFormat(myDrp->destFormat))
-    {
-        if (myDrp->hasColour)
-        {
-            unsigned long dxtBufferLength = dxtBytesForDimensions(myDrp->dxtWidth, myDrp->dxtHeight, glob->type);
-            if (glob->dxtBufferPool == NULL || dxtBufferLength != HapCodecBufferPoolGetBufferSize(glob->dxtBufferPool))
-            {
-                HapCodecBufferPoolDestroy(glob->dxtBufferPool);
-                glob->dxtBufferPool = HapCodecBufferPoolCreate(dxtBufferLength);
-            }
-            
-            myDrp->dxtBuffer = HapCodecBufferCreate(glob->dxtBufferPool);
-        }
-
-        if (myDrp->hasAlpha)
-        {
-            unsigned long dxtBufferLength = dxtBytesForDimensions(myDrp->dxtWidth, myDrp->dxtHeight, kHapAOnlyCodecSubType);
-            if (glob->alphaBufferPool == NULL || dxtBufferLength != HapCodecBufferPoolGetBufferSize(glob->alphaBufferPool))
-            {
-                HapCodecBufferPoolDestroy(glob->alphaBufferPool);
-                glob->alphaBufferPool = HapCodecBufferPoolCreate(dxtBufferLength);
-            }
-
-            myDrp->alphaBuffer = HapCodecBufferCreate(glob->alphaBufferPool);
-        }
-    }
-    
-    if (!isDXTPixelFormat(myDrp->destFormat) && myDrp->dxtFormat == HapTextureFormat_YCoCg_DXT5)
-    {
-        long convertBufferSize = glob->dxtWidth * glob->dxtHeight * 4;
-        if (glob->convertBufferPool == NULL || HapCodecBufferPoolGetBufferSize(glob->convertBufferPool) != convertBufferSize)
-        {
-            glob->convertBufferPool = HapCodecBufferPoolCreate(convertBufferSize);
-        }
-        if (glob->convertBufferPool == NULL)
-        {
-            err = internalComponentErr;
-            goto bail;
-        }
-        myDrp->convertBuffer = HapCodecBufferCreate(glob->convertBufferPool);
-        if (myDrp->convertBuffer == NULL)
-        {
-            err = internalComponentErr;
-            goto bail;
-        }
-    }
-    
-#ifdef HAP_GPU_DECODE
-    if (!isDXTPixelFormat(myDrp->destFormat))
-    {
-        unsigned int texture_format = myDrp->dxtFormat;
-        // The GL decoder is currently ignorant of YCoCg, we swizzle the format to one it understands
-        if (texture_format == HapTextureFormat_YCoCg_DXT5) texture_format = HapCodecGLCompressedFormat_RGBA_DXT5;
-        
-        // Rebuild the decoder if the format has changed
-        if (glob->glDecoder && texture_format != HapCodecGLGetCompressedFormat(glob->glDecoder))
-        {
-            HapCodecGLDestroy(glob->glDecoder);
-            glob->glDecoder = NULL;
-        }
-        if (glob->glDecoder == NULL)
-        {
-            glob->glDecoder = HapCodecGLCreateDecoder(myDrp->width, myDrp->height, texture_format);
-        }
-
-#ifndef HAP_SQUISH_DECODE
-        // Built without squish we're stuck if we failed to create a GL decoder, so bail
-        if (glob->glDecoder == NULL)
-        {
-            err = internalComponentErr;
-            goto bail;
-        }
-#endif
-    }
-#endif
-    
     // Classify the frame so that the base codec can do the right thing.
 	// It is very important to do this so that the base codec will know
 	// which frames it can drop if we're in danger of falling behind.
@@ -549,11 +402,7 @@ bail:
 	return err;
 }
 
-#if defined(DEBUG)
 ComponentResult Hap_DDecodeBand(HapDecompressorGlobals glob, ImageSubCodecDecompressRecord *drp, unsigned long flags HAP_ATTR_UNUSED)
-#else
-ComponentResult Hap_DDecodeBand(HapDecompressorGlobals glob HAP_ATTR_UNUSED, ImageSubCodecDecompressRecord *drp, unsigned long flags HAP_ATTR_UNUSED)
-#endif
 {
 	OSErr err = noErr;
 	HapDecompressRecord *myDrp = (HapDecompressRecord *)drp->userDecompressRecord;
@@ -569,54 +418,22 @@ ComponentResult Hap_DDecodeBand(HapDecompressorGlobals glob HAP_ATTR_UNUSED, Ima
         // them the data will be provided using data-loading procs.
         
         dataProc->dataProc( (Ptr *)&drp->codecData, myDrp->dataSize, dataProc->dataRefCon );
+
+        // The data may have moved, so find the frame's sections again
+        if (HapParseFrame(drp->codecData, myDrp->dataSize, &myDrp->frame.hapFrame) != HapResult_No_Error)
+        {
+            err = errorForHapCodecResult(HapCodecResult_Bad_Frame);
+            goto bail;
+        }
     }
     
-    if (!isDXTPixelFormat(myDrp->destFormat))
+    unsigned int result = HapCodecDecoderDecodeTextures(&myDrp->frame);
+    if (result != HapCodecResult_No_Error)
     {
-        if (myDrp->hasColour)
-        {
-            unsigned int hapResult = HapDecode(drp->codecData,
-                                               myDrp->dataSize,
-                                               myDrp->dxtIndex,
-                                               (HapDecodeCallback)HapMTDecode,
-                                               NULL,
-                                               HapCodecBufferGetBaseAddress(myDrp->dxtBuffer),
-                                               HapCodecBufferGetSize(myDrp->dxtBuffer),
-                                               NULL,
-                                               &myDrp->dxtFormat);
-            if (hapResult != HapResult_No_Error)
-            {
-                err = (hapResult == HapResult_Bad_Frame ? codecBadDataErr : internalComponentErr);
-                goto bail;
-            }
-            
-            if (myDrp->dxtFormat == HapTextureFormat_YCoCg_DXT5)
-            {
-                // For now we use the dedicated YCoCgDXT decoder but we could use a regular
-                // decoder if we add code to convert scaled YCoCg -> RGB
-                DeCompressYCoCgDXT5((const byte *)HapCodecBufferGetBaseAddress(myDrp->dxtBuffer), (byte *)HapCodecBufferGetBaseAddress(myDrp->convertBuffer), myDrp->width, myDrp->height, myDrp->dxtWidth * 4);
-            }
-        }
-        if (myDrp->hasAlpha)
-        {
-            unsigned int format;
-            unsigned int hapResult = HapDecode(drp->codecData,
-                                               myDrp->dataSize,
-                                               myDrp->alphaIndex,
-                                               (HapDecodeCallback)HapMTDecode,
-                                               NULL,
-                                               HapCodecBufferGetBaseAddress(myDrp->alphaBuffer),
-                                               HapCodecBufferGetSize(myDrp->alphaBuffer),
-                                               NULL,
-                                               &format);
-            if (hapResult != HapResult_No_Error)
-            {
-                err = (hapResult == HapResult_Bad_Frame ? codecBadDataErr : internalComponentErr);
-                goto bail;
-            }
-        }
+        err = errorForHapCodecResult(result);
+        goto bail;
     }
-        
+
 	myDrp->decoded = true;
 	
 bail:
@@ -650,126 +467,44 @@ ComponentResult Hap_DDrawBand(HapDecompressorGlobals glob, ImageSubCodecDecompre
 		if( err ) goto bail;
 	}
 
-    if (isDXTPixelFormat(myDrp->destFormat))
+    if (myDrp->frame.dstPixelFormat == kHapCVPixelFormat_YCoCg_DXT5_A_RGTC1)
     {
-        // Decompress the frame directly into the output buffer
-        //
-        // We only advertise the DXT type we contain, so we assume we never
-        // get asked for the wrong one here
-
-        if (myDrp->destFormat == kHapCVPixelFormat_YCoCg_DXT5_A_RGTC1)
+        // Decompress each texture directly into its plane of the output buffer
+        PlanarPixmapInfoHapYCoCgA *planes = (PlanarPixmapInfoHapYCoCgA *)drp->baseAddr;
+        if (planes)
         {
-            PlanarPixmapInfoHapYCoCgA *planes = (PlanarPixmapInfoHapYCoCgA *)drp->baseAddr;
-            if (planes)
+            unsigned int planeSize;
+            void *plane;
+            unsigned int result = HapCodecResult_No_Error;
+
+            if (myDrp->frame.hasAlpha)
             {
-                unsigned int planeSize;
-                void *plane;
-                unsigned int format;
-                unsigned int hapResult = HapResult_No_Error;
-
-                if (myDrp->hasAlpha)
-                {
-                    planeSize = dxtBytesForDimensions(myDrp->dxtWidth, myDrp->dxtHeight, kHapAOnlyCodecSubType);
-                    plane = drp->baseAddr + EndianS32_BtoN(planes->componentInfoARGTC1.offset);
-                    hapResult = HapDecode(drp->codecData, myDrp->dataSize, myDrp->alphaIndex, (HapDecodeCallback)HapMTDecode, NULL, plane, planeSize, NULL, &format);
-                }
-
-                if (hapResult == HapResult_No_Error && myDrp->hasColour)
-                {
-                    planeSize = dxtBytesForDimensions(myDrp->dxtWidth, myDrp->dxtHeight, kHapYCoCgCodecSubType);
-                    plane = drp->baseAddr + EndianS32_BtoN(planes->componentInfoYCoCgDXT5.offset);
-                    hapResult = HapDecode(drp->codecData, myDrp->dataSize, myDrp->dxtIndex, (HapDecodeCallback)HapMTDecode, NULL, plane, planeSize, NULL, &format);
-                }
-
-                if (hapResult != HapResult_No_Error)
-                {
-                    err = (hapResult == HapResult_Bad_Frame ? codecBadDataErr : internalComponentErr);
-                    goto bail;
-                }
+                planeSize = dxtBytesForDimensions(glob->dxtWidth, glob->dxtHeight, kHapAOnlyCodecSubType);
+                plane = drp->baseAddr + EndianS32_BtoN(planes->componentInfoARGTC1.offset);
+                result = HapCodecDecoderDecodeFrameTexture(&myDrp->frame, myDrp->frame.alphaIndex, plane, planeSize);
             }
-        }
-        else
-        {
-            unsigned int bufferSize = dxtBytesForDimensions(myDrp->dxtWidth, myDrp->dxtHeight, glob->type);
-            unsigned int hapResult = HapDecode(drp->codecData, myDrp->dataSize, myDrp->dxtIndex, (HapDecodeCallback)HapMTDecode, NULL, drp->baseAddr, bufferSize, NULL, &myDrp->dxtFormat);
-            if (hapResult != HapResult_No_Error)
+
+            if (result == HapCodecResult_No_Error && myDrp->frame.hasColour)
             {
-                err = (hapResult == HapResult_Bad_Frame ? codecBadDataErr : internalComponentErr);
-                goto bail;
+                planeSize = dxtBytesForDimensions(glob->dxtWidth, glob->dxtHeight, kHapYCoCgCodecSubType);
+                plane = drp->baseAddr + EndianS32_BtoN(planes->componentInfoYCoCgDXT5.offset);
+                result = HapCodecDecoderDecodeFrameTexture(&myDrp->frame, myDrp->frame.colourIndex, plane, planeSize);
             }
+
+            err = errorForHapCodecResult(result);
         }
     }
     else
     {
-        if (myDrp->hasColour)
-        {
-            if (myDrp->dxtFormat == HapTextureFormat_YCoCg_DXT5)
-            {
-                if (myDrp->destFormat == k32RGBAPixelFormat)
-                {
-                    ConvertCoCg_Y8888ToRGB_((uint8_t *)HapCodecBufferGetBaseAddress(myDrp->convertBuffer), (uint8_t *)drp->baseAddr, myDrp->width, myDrp->height, myDrp->dxtWidth * 4, drp->rowBytes, 1);
-                }
-                else
-                {
-                    ConvertCoCg_Y8888ToBGR_((uint8_t *)HapCodecBufferGetBaseAddress(myDrp->convertBuffer), (uint8_t *)drp->baseAddr, myDrp->width, myDrp->height, myDrp->dxtWidth * 4, drp->rowBytes, 1);
-                }
-            }
-            else
-            {
-    #ifdef HAP_GPU_DECODE
-                if (glob->glDecoder != NULL)
-                {
-                    int decodeResult = HapCodecGLDecode(glob->glDecoder,
-                                                        drp->rowBytes,
-                                                        (myDrp->destFormat == k32RGBAPixelFormat ? HapCodecGLPixelFormat_RGBA8 : HapCodecGLPixelFormat_BGRA8),
-                                                        HapCodecBufferGetBaseAddress(myDrp->dxtBuffer),
-                                                        drp->baseAddr);
-                    if (decodeResult != 0)
-                    {
-                        err = internalComponentErr;
-                        goto bail;
-                    }
-                }
-    #endif
-                
-    #ifdef HAP_SQUISH_DECODE
-    #ifdef HAP_GPU_DECODE
-                else
-                {
-    #endif
-                    int decompressFormat = 0;
-                    switch (myDrp->dxtFormat)
-                    {
-                    case HapTextureFormat_RGB_DXT1:
-                        decompressFormat = kHapCVPixelFormat_RGB_DXT1;
-                        break;
-                    case HapTextureFormat_RGBA_DXT5:
-                        decompressFormat = kHapCVPixelFormat_RGBA_DXT5;
-                        break;
-                    default:
-                        err = internalComponentErr;
-                        break;
-                    }
-                    if (err)
-                        goto bail;
-                    HapCodecSquishDecode(HapCodecBufferGetBaseAddress(myDrp->dxtBuffer),
-                        decompressFormat,
-                        drp->baseAddr,
-                        myDrp->destFormat,
-                        drp->rowBytes,
-                        glob->width,
-                        glob->height);
-    #ifdef HAP_GPU_DECODE
-                }
-    #endif
-    #endif // HAP_SQUISH_DECODE
-            }
-        }
-
-        if (myDrp->hasAlpha)
-        {
-            HapCodecSquishRGTC1Decode(HapCodecBufferGetBaseAddress(myDrp->alphaBuffer), drp->baseAddr, drp->rowBytes, glob->width, glob->height);
-        }
+        // For DXT destinations this decompresses the frame directly into the output buffer
+        //
+        // We only advertise the DXT type we contain, so we assume we never
+        // get asked for the wrong one here
+        unsigned int result = HapCodecDecoderDrawFrame(glob->decoder,
+                                                       &myDrp->frame,
+                                                       drp->baseAddr,
+                                                       drp->rowBytes);
+        err = errorForHapCodecResult(result);
     }
 
 bail:
@@ -789,12 +524,7 @@ bail:
 ComponentResult Hap_DEndBand(HapDecompressorGlobals glob HAP_ATTR_UNUSED, ImageSubCodecDecompressRecord *drp, OSErr result HAP_ATTR_UNUSED, long flags HAP_ATTR_UNUSED)
 {
 	HapDecompressRecord *myDrp = (HapDecompressRecord *)drp->userDecompressRecord;
-    HapCodecBufferReturn(myDrp->dxtBuffer);
-    myDrp->dxtBuffer = NULL;
-    HapCodecBufferReturn(myDrp->convertBuffer);
-    myDrp->convertBuffer = NULL;
-    HapCodecBufferReturn(myDrp->alphaBuffer);
-    myDrp->alphaBuffer = NULL;
+    HapCodecDecoderEndFrame(&myDrp->frame);
 	return noErr;
 }
 
@@ -25,11 +25,15 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+#ifndef HapCodec_HapPlatform_h
+#define HapCodec_HapPlatform_h
+
 #if defined(__APPLE__)
     #include <Availability.h>
     #define HAP_ATTR_UNUSED __attribute__((unused))
     #define HAP_FUNC __func__
     #define HAP_ALIGN_16 __attribute__((aligned (16)))
+    #define HAP_ALIGN_64 __attribute__((aligned (64)))
     #if !defined(DEBUG)
         #define HAP_INLINE inline __attribute__((__always_inline__))
     #else
@@ -38,10 +42,11 @@
     #if defined(MAC_OS_X_VERSION_MIN_REQUIRED) && MAC_OS_X_VERSION_MIN_REQUIRED >= 1070
         #define HAP_SSSE3_ALWAYS_AVAILABLE
     #endif
-#else
+#elif defined(_WIN32)
     #define HAP_ATTR_UNUSED
     #define HAP_FUNC __FUNCTION__
     #define HAP_ALIGN_16 __declspec(align(16))
+    #define HAP_ALIGN_64 __declspec(align(64))
     #if defined(NDEBUG)
         #define HAP_INLINE __forceinline
     #elif defined(__cplusplus)
@@ -49,4 +54,23 @@
     #else
         #define HAP_INLINE __inline
     #endif
+#else
+    #include <stdbool.h>
+    #include <stdint.h>
+    #define HAP_ATTR_UNUSED __attribute__((unused))
+    #define HAP_FUNC __func__
+    #define HAP_ALIGN_16 __attribute__((aligned (16)))
+    #define HAP_ALIGN_64 __attribute__((aligned (64)))
+    #if defined(NDEBUG)
+        #define HAP_INLINE inline __attribute__((__always_inline__))
+    #else
+        #define HAP_INLINE inline
+    #endif
+    /*
+     Without MacTypes.h we provide the few Mac types used by the codec core
+     */
+    typedef uint32_t OSType;
+    typedef unsigned char Boolean;
+#endif
+
 #endif
@@ -43,8 +43,40 @@
 #include <Accelerate/Accelerate.h>
 #endif
 
+#if !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
+#include "ImageMathSIMD.h"
+#include "DXTBlocks.h"
+#endif
+
 #define CLAMP_UINT8( x ) ( (x) < 0 ? (0) : ( (x) > 255 ? 255 : (x) ) )
 
+#if !defined(IMAGE_MATH_USE_V_IMAGE) || defined(IMAGE_MATH_USE_V_IMAGE_WEAK_LINKED)
+// Returns log2(divisor) if divisor is a power of two, otherwise -1
+static int ImageMath_DivisorShift(int32_t divisor)
+{
+    int shift = 0;
+    if (divisor <= 0 || (divisor & (divisor - 1)) != 0)
+        return -1;
+    while ((1 << shift) != divisor)
+        shift++;
+    return shift;
+}
+
+// The vector implementations work in 16 bits until the multiply
+static int ImageMath_PreBiasFitsInt16(const int16_t *pre_bias)
+{
+    int i;
+    if (pre_bias == NULL)
+        return 1;
+    for (i = 0; i < 4; i++)
+    {
+        if (pre_bias[i] > INT16_MAX - 255)
+            return 0;
+    }
+    return 1;
+}
+#endif
+
 void ImageMath_MatrixMultiply8888(const void *src,
                                   size_t src_bytes_per_row,
                                   void *dst,
@@ -93,11 +125,42 @@ void ImageMath_MatrixMultiply8888(const void *src,
         unsigned long y, x;
         const uint8_t *pixel_src = (const uint8_t *)src;
         uint8_t *pixel_dst = (uint8_t *)dst;
-        size_t src_bytes_extra_per_row = src_bytes_per_row - (width * 4);
-        size_t dst_bytes_extra_per_row = dst_bytes_per_row - (width * 4);
+        size_t src_bytes_extra_per_row;
+        size_t dst_bytes_extra_per_row;
+        unsigned long vector_width = 0;
+        int shift = ImageMath_DivisorShift(divisor);
+
+        /*
+         Convert as much as possible with a vector implementation, and the remainder of each row below
+         */
+        if (shift >= 0 && ImageMath_PreBiasFitsInt16(pre_bias))
+        {
+            const int16_t no_pre_bias[4] = { 0, 0, 0, 0 };
+            const int32_t no_post_bias[4] = { 0, 0, 0, 0 };
+
+            if (HapCodecHasAVX2())
+            {
+                vector_width = ImageMath_MatrixMultiply8888AVX2(pixel_src, src_bytes_per_row, pixel_dst, dst_bytes_per_row,
+                                                                width, height, matrix, shift,
+                                                                (pre_bias ? pre_bias : no_pre_bias),
+                                                                (post_bias ? post_bias : no_post_bias));
+            }
+            else
+            {
+                vector_width = ImageMath_MatrixMultiply8888SSE2(pixel_src, src_bytes_per_row, pixel_dst, dst_bytes_per_row,
+                                                                width, height, matrix, shift,
+                                                                (pre_bias ? pre_bias : no_pre_bias),
+                                                                (post_bias ? post_bias : no_post_bias));
+            }
+            pixel_src += vector_width * 4;
+            pixel_dst += vector_width * 4;
+        }
+
+        src_bytes_extra_per_row = src_bytes_per_row - ((width - vector_width) * 4);
+        dst_bytes_extra_per_row = dst_bytes_per_row - ((width - vector_width) * 4);
 
         for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++) {
+            for (x = vector_width; x < width; x++) {
                 
                 int32_t result[4];
                 int32_t source[4] = { pixel_src[0], pixel_src[1], pixel_src[2], pixel_src[3] };
@@ -190,12 +253,35 @@ void ImageMath_Permute8888(const void *src,
         int i;
         const uint8_t *pixel_src = (const uint8_t *)src;
         uint8_t *pixel_dst = (uint8_t *)dst;
-        size_t src_bytes_extra_per_row = src_bytes_per_row - (width * 4);
-        size_t dst_bytes_extra_per_row = dst_bytes_per_row - (width * 4);
+        size_t src_bytes_extra_per_row;
+        size_t dst_bytes_extra_per_row;
+        unsigned long vector_width;
+
+        if (HapCodecHasAVX2())
+        {
+            vector_width = ImageMath_Permute8888AVX2(pixel_src, src_bytes_per_row, pixel_dst, dst_bytes_per_row, width, height, permuteMap);
+        }
+#if !defined(HAP_SSSE3_ALWAYS_AVAILABLE)
+        else if (!HapCodecHasSSSE3())
+        {
+            vector_width = 0;
+        }
+#endif
+        else
+        {
+            vector_width = ImageMath_Permute8888SSSE3(pixel_src, src_bytes_per_row, pixel_dst, dst_bytes_per_row, width, height, permuteMap);
+        }
+        pixel_src += vector_width * 4;
+        pixel_dst += vector_width * 4;
+
+        src_bytes_extra_per_row = src_bytes_per_row - ((width - vector_width) * 4);
+        dst_bytes_extra_per_row = dst_bytes_per_row - ((width - vector_width) * 4);
         for (y = 0; y < height; y++) {
-            for (x = 0; x < width; x++) {
+            for (x = vector_width; x < width; x++) {
+                // Read the whole pixel first in case src is dst
+                uint8_t pixel[4] = { pixel_src[0], pixel_src[1], pixel_src[2], pixel_src[3] };
                 for(i = 0; i < 4; i++ ) {
-                    pixel_dst[i] = pixel_src[permuteMap[i]];
+                    pixel_dst[i] = pixel[permuteMap[i]];
                 }
                 pixel_src += 4;
                 pixel_dst += 4;
@@ -50,6 +50,7 @@ void ImageMath_MatrixMultiply8888(const void *src,
                                   const int32_t *post_bias,	// An array of 4 int32_t or NULL, added after matrix op
                                   int allow_tile); // if non-zero, operation may be tiled and multithreaded
 
+// src may be dst to permute in place, if the bytes per row are the same
 void ImageMath_Permute8888(const void *src,
                            size_t src_bytes_per_row,
                            void *dst,
@@ -0,0 +1,122 @@
+/*
+ ImageMathAVX2.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ImageMathSIMD.h"
+#include <immintrin.h>
+
+/*
+ As ImageMath_MatrixMultiply8888SSE2(), eight pixels at a time. Unpacking works within 128-bit lanes, so pixels
+ 0-3 are converted in the low lane while 4-7 are converted in the high, and the packs put them back in order.
+ */
+unsigned long ImageMath_MatrixMultiply8888AVX2(const uint8_t *src,
+                                               size_t src_bytes_per_row,
+                                               uint8_t *dst,
+                                               size_t dst_bytes_per_row,
+                                               unsigned long width,
+                                               unsigned long height,
+                                               const int16_t matrix[4*4],
+                                               int shift,
+                                               const int16_t pre_bias[4],
+                                               const int32_t post_bias[4])
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i weights_01 = _mm256_setr_epi16(matrix[0], matrix[4], matrix[1], matrix[5], matrix[2], matrix[6], matrix[3], matrix[7],
+                                                 matrix[0], matrix[4], matrix[1], matrix[5], matrix[2], matrix[6], matrix[3], matrix[7]);
+    const __m256i weights_23 = _mm256_setr_epi16(matrix[8], matrix[12], matrix[9], matrix[13], matrix[10], matrix[14], matrix[11], matrix[15],
+                                                 matrix[8], matrix[12], matrix[9], matrix[13], matrix[10], matrix[14], matrix[11], matrix[15]);
+    const __m256i pre = _mm256_setr_epi16(pre_bias[0], pre_bias[1], pre_bias[2], pre_bias[3], pre_bias[0], pre_bias[1], pre_bias[2], pre_bias[3],
+                                          pre_bias[0], pre_bias[1], pre_bias[2], pre_bias[3], pre_bias[0], pre_bias[1], pre_bias[2], pre_bias[3]);
+    const __m256i post = _mm256_setr_epi32(post_bias[0], post_bias[1], post_bias[2], post_bias[3],
+                                           post_bias[0], post_bias[1], post_bias[2], post_bias[3]);
+    const __m128i shift_count = _mm_cvtsi32_si128(shift);
+    unsigned long count = width & ~7UL;
+    unsigned long y, x;
+
+    for (y = 0; y < height; y++)
+    {
+        const uint8_t *pixel_src = src + (src_bytes_per_row * y);
+        uint8_t *pixel_dst = dst + (dst_bytes_per_row * y);
+        for (x = 0; x < count; x += 8)
+        {
+            __m256i pixels = _mm256_loadu_si256((const __m256i *)(pixel_src + (x * 4)));
+            // Pixels 0, 1 and 4, 5 then 2, 3 and 6, 7
+            __m256i wide[2];
+            __m256i result[4];
+            int i;
+            wide[0] = _mm256_add_epi16(_mm256_unpacklo_epi8(pixels, zero), pre);
+            wide[1] = _mm256_add_epi16(_mm256_unpackhi_epi8(pixels, zero), pre);
+            for (i = 0; i < 4; i++)
+            {
+                __m256i pair_01, pair_23, sum;
+                if (i & 1)
+                {
+                    pair_01 = _mm256_shuffle_epi32(wide[i >> 1], _MM_SHUFFLE(2, 2, 2, 2));
+                    pair_23 = _mm256_shuffle_epi32(wide[i >> 1], _MM_SHUFFLE(3, 3, 3, 3));
+                }
+                else
+                {
+                    pair_01 = _mm256_shuffle_epi32(wide[i >> 1], _MM_SHUFFLE(0, 0, 0, 0));
+                    pair_23 = _mm256_shuffle_epi32(wide[i >> 1], _MM_SHUFFLE(1, 1, 1, 1));
+                }
+                sum = _mm256_add_epi32(_mm256_madd_epi16(pair_01, weights_01), _mm256_madd_epi16(pair_23, weights_23));
+                // An arithmetic shift rounds negative results down rather than towards zero, but they clamp to 0 either way
+                result[i] = _mm256_sra_epi32(_mm256_add_epi32(sum, post), shift_count);
+            }
+            pixels = _mm256_packus_epi16(_mm256_packs_epi32(result[0], result[1]), _mm256_packs_epi32(result[2], result[3]));
+            _mm256_storeu_si256((__m256i *)(pixel_dst + (x * 4)), pixels);
+        }
+    }
+    return count;
+}
+
+unsigned long ImageMath_Permute8888AVX2(const uint8_t *src,
+                                        size_t src_bytes_per_row,
+                                        uint8_t *dst,
+                                        size_t dst_bytes_per_row,
+                                        unsigned long width,
+                                        unsigned long height,
+                                        const uint8_t permuteMap[4])
+{
+    // vpshufb works within 128-bit lanes, which suits pixels which never cross them
+    const __m256i mask = _mm256_add_epi8(_mm256_set1_epi32((int)(permuteMap[0] | (permuteMap[1] << 8) | (permuteMap[2] << 16) | ((uint32_t)permuteMap[3] << 24))),
+                                         _mm256_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12,
+                                                          0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12));
+    unsigned long count = width & ~7UL;
+    unsigned long y, x;
+
+    for (y = 0; y < height; y++)
+    {
+        const uint8_t *pixel_src = src + (src_bytes_per_row * y);
+        uint8_t *pixel_dst = dst + (dst_bytes_per_row * y);
+        for (x = 0; x < count; x += 8)
+        {
+            __m256i pixels = _mm256_loadu_si256((const __m256i *)(pixel_src + (x * 4)));
+            _mm256_storeu_si256((__m256i *)(pixel_dst + (x * 4)), _mm256_shuffle_epi8(pixels, mask));
+        }
+    }
+    return count;
+}
@@ -0,0 +1,93 @@
+/*
+ ImageMathSIMD.h
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef Pxlz_ImageMathSIMD_h
+#define Pxlz_ImageMathSIMD_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ Vectorised matrix multiplies for ImageMath_MatrixMultiply8888(), selected at runtime. They match its scalar
+ loop exactly for divisors of 1 << shift, and require every source value plus its pre_bias to fit in an int16_t.
+ pre_bias and post_bias may not be NULL. Only whole groups of 4 (SSE2) or 8 (AVX2) pixels are converted, and the
+ number of pixels converted at the start of each row is returned, leaving the rest of each row to the caller.
+ */
+
+unsigned long ImageMath_MatrixMultiply8888SSE2(const uint8_t *src,
+                                               size_t src_bytes_per_row,
+                                               uint8_t *dst,
+                                               size_t dst_bytes_per_row,
+                                               unsigned long width,
+                                               unsigned long height,
+                                               const int16_t matrix[4*4],
+                                               int shift,
+                                               const int16_t pre_bias[4],
+                                               const int32_t post_bias[4]);
+
+unsigned long ImageMath_MatrixMultiply8888AVX2(const uint8_t *src,
+                                               size_t src_bytes_per_row,
+                                               uint8_t *dst,
+                                               size_t dst_bytes_per_row,
+                                               unsigned long width,
+                                               unsigned long height,
+                                               const int16_t matrix[4*4],
+                                               int shift,
+                                               const int16_t pre_bias[4],
+                                               const int32_t post_bias[4]);
+
+/*
+ Vectorised channel permutes for ImageMath_Permute8888(), selected at runtime. Any permuteMap is a single byte
+ shuffle, so BGRA <-> RGBA costs no more than a copy. As above, whole groups of 4 (SSSE3) or 8 (AVX2) pixels are
+ converted and the number converted at the start of each row is returned. src may be dst.
+ */
+
+unsigned long ImageMath_Permute8888SSSE3(const uint8_t *src,
+                                         size_t src_bytes_per_row,
+                                         uint8_t *dst,
+                                         size_t dst_bytes_per_row,
+                                         unsigned long width,
+                                         unsigned long height,
+                                         const uint8_t permuteMap[4]);
+
+unsigned long ImageMath_Permute8888AVX2(const uint8_t *src,
+                                        size_t src_bytes_per_row,
+                                        uint8_t *dst,
+                                        size_t dst_bytes_per_row,
+                                        unsigned long width,
+                                        unsigned long height,
+                                        const uint8_t permuteMap[4]);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+/*
+ ImageMathSSSE3.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "ImageMathSIMD.h"
+#include <tmmintrin.h>
+
+unsigned long ImageMath_Permute8888SSSE3(const uint8_t *src,
+                                         size_t src_bytes_per_row,
+                                         uint8_t *dst,
+                                         size_t dst_bytes_per_row,
+                                         unsigned long width,
+                                         unsigned long height,
+                                         const uint8_t permuteMap[4])
+{
+    // Each pixel's map offset by the position of the pixel
+    const __m128i mask = _mm_add_epi8(_mm_set1_epi32((int)(permuteMap[0] | (permuteMap[1] << 8) | (permuteMap[2] << 16) | ((uint32_t)permuteMap[3] << 24))),
+                                      _mm_setr_epi8(0, 0, 0, 0, 4, 4, 4, 4, 8, 8, 8, 8, 12, 12, 12, 12));
+    unsigned long count = width & ~3UL;
+    unsigned long y, x;
+
+    for (y = 0; y < height; y++)
+    {
+        const uint8_t *pixel_src = src + (src_bytes_per_row * y);
+        uint8_t *pixel_dst = dst + (dst_bytes_per_row * y);
+        for (x = 0; x < count; x += 4)
+        {
+            __m128i pixels = _mm_loadu_si128((const __m128i *)(pixel_src + (x * 4)));
+            _mm_storeu_si128((__m128i *)(pixel_dst + (x * 4)), _mm_shuffle_epi8(pixels, mask));
+        }
+    }
+    return count;
+}
@@ -57,4 +57,38 @@ void HapCodecLockUnlock(HapCodecLock *lock)
     LeaveCriticalSection((LPCRITICAL_SECTION)(*lock));
 }
 
+#elif !defined(__APPLE__)
+#include <pthread.h>
+#include <stdlib.h>
+
+HapCodecLock HapCodecLockInit()
+{
+    pthread_mutex_t *mutex = (pthread_mutex_t *)malloc(sizeof(pthread_mutex_t));
+    if (mutex && pthread_mutex_init(mutex, NULL) != 0)
+    {
+        free(mutex);
+        mutex = NULL;
+    }
+    return (HapCodecLock)mutex;
+}
+
+void HapCodecLockDestroy(HapCodecLock *lock)
+{
+    if (*lock)
+    {
+        pthread_mutex_destroy((pthread_mutex_t *)(*lock));
+        free(*lock);
+    }
+}
+
+void HapCodecLockLock(HapCodecLock *lock)
+{
+    pthread_mutex_lock((pthread_mutex_t *)(*lock));
+}
+
+void HapCodecLockUnlock(HapCodecLock *lock)
+{
+    pthread_mutex_unlock((pthread_mutex_t *)(*lock));
+}
+
 #endif
@@ -26,11 +26,314 @@
  */
 
 #include "ParallelLoops.h"
+#include <atomic>
 #if defined(__APPLE__)
-#else
+#include <unistd.h>
+#elif defined(_WIN32)
 #include <ppl.h>
+#else
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <stdint.h>
 #endif
 
+// 0 for the default
+static std::atomic<unsigned int> hapParallelWorkerLimit(0);
+
+
+#if !defined(__APPLE__) && !defined(_WIN32)
+
+/*
+ A persistent work-stealing pool for platforms without libdispatch or PPL.
+
+ Each call to HapParallelFor becomes a job whose index range is divided between
+ one slot per participant (the calling thread plus every worker). A participant
+ takes small chunks from the front of its own slot and, once that is empty,
+ steals half of what remains from the back of another slot. A slot's range is
+ packed into one 64-bit word so both ends can be claimed with a single CAS.
+
+ Workers are started as the worker limit requires them. Idle workers join the
+ job with the fewest participants, so concurrent sessions share them evenly,
+ and run calls from HapParallelAsync() when no job needs them.
+ */
+
+#define kHapParallelMaxParticipants 128U
+
+struct HapParallelSlot {
+    std::atomic<uint64_t>   range; // begin in the high 32 bits, end in the low 32 bits
+    char                    padding[64 - sizeof(std::atomic<uint64_t>)];
+};
+
+struct HapParallelJob {
+    HapParallelFunction     function;
+    void                    *info;
+    unsigned int            grain;
+    unsigned int            slotCount;
+    HapParallelSlot         *slots;
+    std::atomic<unsigned int> remaining;
+    std::atomic<bool>       exhausted;
+    unsigned int            participants; // workers currently inside this job, guarded by the pool mutex
+    HapParallelJob          *next;
+};
+
+struct HapParallelAsyncCall {
+    HapParallelAsyncFunction function;
+    void                    *info;
+    HapParallelAsyncCall    *next;
+};
+
+static inline uint64_t HapParallelPackRange(unsigned int begin, unsigned int end)
+{
+    return ((uint64_t)begin << 32) | end;
+}
+
+class HapParallelPool {
+public:
+    static HapParallelPool *shared()
+    {
+        static std::once_flag once;
+        static HapParallelPool *pool = NULL;
+        std::call_once(once, []() {
+            // Never destroyed: workers live for the life of the process
+            pool = new (std::nothrow) HapParallelPool();
+        });
+        return pool;
+    }
+
+    // Runs the job on the calling thread and up to helpers workers
+    void run(HapParallelFunction function, void *info, unsigned int count, unsigned int helpers)
+    {
+        HapParallelSlot slots[kHapParallelMaxParticipants];
+        HapParallelJob job;
+        unsigned int slotCount;
+        unsigned int begin = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            startWorkers(helpers);
+            slotCount = (workerCount < helpers ? workerCount : helpers) + 1;
+        }
+        if (slotCount == 1)
+        {
+            for (unsigned int i = 0; i < count; i++)
+            {
+                function(info, i);
+            }
+            return;
+        }
+
+        job.function = function;
+        job.info = info;
+        job.slotCount = slotCount;
+        job.slots = slots;
+        job.remaining.store(count, std::memory_order_relaxed);
+        job.exhausted.store(false, std::memory_order_relaxed);
+        job.participants = 0;
+        // Several chunks per participant lets stealing even out uneven work
+        job.grain = count / (slotCount * 4);
+        if (job.grain == 0)
+            job.grain = 1;
+
+        for (unsigned int i = 0; i < slotCount; i++)
+        {
+            unsigned int end = begin + (count / slotCount) + (i < count % slotCount ? 1 : 0);
+            slots[i].range.store(HapParallelPackRange(begin, end), std::memory_order_relaxed);
+            begin = end;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job.next = jobs;
+            jobs = &job;
+        }
+        workAvailable.notify_all();
+
+        work(&job, 0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        HapParallelJob **link = &jobs;
+        while (*link != &job)
+            link = &(*link)->next;
+        *link = job.next;
+        while (job.participants != 0 || job.remaining.load(std::memory_order_acquire) != 0)
+            jobDone.wait(lock);
+    }
+
+    bool async(HapParallelAsyncFunction function, void *info)
+    {
+        HapParallelAsyncCall *call = new (std::nothrow) HapParallelAsyncCall;
+        if (call == NULL)
+            return false;
+        call->function = function;
+        call->info = info;
+        call->next = NULL;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            startWorkers(HapParallelGetWorkerLimit());
+            if (workerCount == 0)
+            {
+                delete call;
+                return false;
+            }
+            if (lastCall)
+                lastCall->next = call;
+            else
+                calls = call;
+            lastCall = call;
+        }
+        workAvailable.notify_all();
+        return true;
+    }
+
+private:
+    HapParallelPool() : workerCount(0), jobs(NULL), calls(NULL), lastCall(NULL) {}
+
+    // Starts workers until there are count, called with the mutex held
+    void startWorkers(unsigned int count)
+    {
+        if (count > kHapParallelMaxParticipants - 1)
+            count = kHapParallelMaxParticipants - 1;
+        while (workerCount < count)
+        {
+            try {
+                std::thread(&HapParallelPool::workerMain, this, workerCount + 1).detach();
+                workerCount++;
+            } catch (...) {
+                break;
+            }
+        }
+    }
+
+    void workerMain(unsigned int slot)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;)
+        {
+            // Join whichever job has the fewest participants, so concurrent callers share the workers evenly
+            HapParallelJob *job = NULL;
+            for (HapParallelJob *candidate = jobs; candidate; candidate = candidate->next)
+            {
+                if (slot < candidate->slotCount
+                    && candidate->exhausted.load(std::memory_order_relaxed) == false
+                    && (job == NULL || candidate->participants < job->participants))
+                {
+                    job = candidate;
+                }
+            }
+            if (job == NULL)
+            {
+                // Jobs have a caller waiting on them, so come before asynchronous calls
+                HapParallelAsyncCall *call = calls;
+                if (call)
+                {
+                    calls = call->next;
+                    if (calls == NULL)
+                        lastCall = NULL;
+                    lock.unlock();
+
+                    call->function(call->info);
+                    delete call;
+
+                    lock.lock();
+                }
+                else
+                {
+                    workAvailable.wait(lock);
+                }
+                continue;
+            }
+            job->participants++;
+            lock.unlock();
+
+            work(job, slot);
+
+            lock.lock();
+            job->participants--;
+            if (job->participants == 0)
+                jobDone.notify_all();
+        }
+    }
+
+    // Claims and runs chunks until no slot of the job has any indices left
+    void work(HapParallelJob *job, unsigned int slot)
+    {
+        unsigned int begin, end;
+        while (claim(job, slot, &begin, &end))
+        {
+            for (unsigned int i = begin; i < end; i++)
+            {
+                job->function(job->info, i);
+            }
+            if (job->remaining.fetch_sub(end - begin, std::memory_order_acq_rel) == end - begin)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                jobDone.notify_all();
+            }
+        }
+        job->exhausted.store(true, std::memory_order_relaxed);
+    }
+
+    bool claim(HapParallelJob *job, unsigned int slot, unsigned int *outBegin, unsigned int *outEnd)
+    {
+        HapParallelSlot *own = &job->slots[slot];
+        for (;;)
+        {
+            // Take a chunk from the front of our own range
+            uint64_t range = own->range.load(std::memory_order_acquire);
+            unsigned int begin = (unsigned int)(range >> 32);
+            unsigned int end = (unsigned int)range;
+            while (begin < end)
+            {
+                unsigned int taken = end - begin < job->grain ? end - begin : job->grain;
+                if (own->range.compare_exchange_weak(range, HapParallelPackRange(begin + taken, end), std::memory_order_acq_rel))
+                {
+                    *outBegin = begin;
+                    *outEnd = begin + taken;
+                    return true;
+                }
+                begin = (unsigned int)(range >> 32);
+                end = (unsigned int)range;
+            }
+
+            // Our range is empty, steal half of the back of someone else's
+            bool stole = false;
+            for (unsigned int i = 1; i < job->slotCount && stole == false; i++)
+            {
+                HapParallelSlot *victim = &job->slots[(slot + i) % job->slotCount];
+                range = victim->range.load(std::memory_order_acquire);
+                begin = (unsigned int)(range >> 32);
+                end = (unsigned int)range;
+                while (begin < end)
+                {
+                    unsigned int split = end - ((end - begin + 1) / 2);
+                    if (victim->range.compare_exchange_weak(range, HapParallelPackRange(begin, split), std::memory_order_acq_rel))
+                    {
+                        // Only we add to our own empty slot, so a plain store is safe
+                        own->range.store(HapParallelPackRange(split, end), std::memory_order_release);
+                        stole = true;
+                        break;
+                    }
+                    begin = (unsigned int)(range >> 32);
+                    end = (unsigned int)range;
+                }
+            }
+            if (stole == false)
+                return false;
+        }
+    }
+
+    unsigned int            workerCount;
+    std::mutex              mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable jobDone;
+    HapParallelJob          *jobs;
+    HapParallelAsyncCall    *calls;
+    HapParallelAsyncCall    *lastCall;
+};
+
+#endif
 
 extern "C" void HapParallelFor(HapParallelFunction function, void *info, unsigned int count)
 {
@@ -38,9 +341,68 @@ extern "C" void HapParallelFor(HapParallelFunction function, void *info, unsigne
     dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t index) {
         function(info, (unsigned int)index);
     });
-#else
+#elif defined(_WIN32)
     concurrency::parallel_for((unsigned int)0, count, [&](unsigned int i) {
         function(info, i);
     });
+#else
+    HapParallelPool *pool = HapParallelPool::shared();
+    unsigned int limit = HapParallelGetWorkerLimit();
+    if (count < 2 || pool == NULL || limit < 2)
+    {
+        for (unsigned int i = 0; i < count; i++)
+        {
+            function(info, i);
+        }
+    }
+    else
+    {
+        pool->run(function, info, count, limit - 1);
+    }
+#endif
+}
+
+extern "C" int HapParallelAsync(HapParallelAsyncFunction function, void *info)
+{
+#if defined(__APPLE__)
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        function(info);
+    });
+    return 1;
+#elif defined(_WIN32)
+    try {
+        // The same scheduler as parallel_for
+        concurrency::CurrentScheduler::ScheduleTask(function, info);
+    } catch (...) {
+        return 0;
+    }
+    return 1;
+#else
+    HapParallelPool *pool = HapParallelPool::shared();
+    return (pool != NULL && pool->async(function, info)) ? 1 : 0;
+#endif
+}
+
+extern "C" void HapParallelSetWorkerLimit(unsigned int limit)
+{
+    hapParallelWorkerLimit.store(limit, std::memory_order_relaxed);
+}
+
+extern "C" unsigned int HapParallelGetWorkerLimit(void)
+{
+    unsigned int limit = hapParallelWorkerLimit.load(std::memory_order_relaxed);
+    return limit > 0 ? limit : HapParallelGetProcessorCount();
+}
+
+extern "C" unsigned int HapParallelGetProcessorCount(void)
+{
+#if defined(__APPLE__)
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    return processors > 0 ? (unsigned int)processors : 1U;
+#elif defined(_WIN32)
+    return concurrency::GetProcessorCount();
+#else
+    unsigned int processors = std::thread::hardware_concurrency();
+    return processors > 0 ? processors : 1U;
 #endif
 }
@@ -40,6 +40,25 @@ typedef void (*HapParallelFunction)(void *p, unsigned int index);
 
 void HapParallelFor(HapParallelFunction function, void *info, unsigned int count);
 
+typedef void (*HapParallelAsyncFunction)(void *info);
+
+/*
+ Calls function(info) once, later, on one of the process's shared worker threads. Returns 0 if it can't be scheduled.
+ */
+int HapParallelAsync(HapParallelAsyncFunction function, void *info);
+
+/*
+ Every session in the process shares one set of worker threads. This sets how many threads may work for them at
+ once, including the thread calling HapParallelFor(). Passing 0 restores the default, the number of processors.
+ */
+void HapParallelSetWorkerLimit(unsigned int limit);
+unsigned int HapParallelGetWorkerLimit(void);
+
+/*
+ Returns the number of processors available to HapParallelFor().
+ */
+unsigned int HapParallelGetProcessorCount(void);
+
 #ifdef __cplusplus
 }
 #endif
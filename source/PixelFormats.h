@@ -28,6 +28,13 @@
 #ifndef HapCodec_PixelFormats_h
 #define HapCodec_PixelFormats_h
 
+/*
+ 32-bit RGBA and BGRA, the same values as QuickTime's k32RGBAPixelFormat and k32BGRAPixelFormat,
+ for code which doesn't include QuickTime
+ */
+#define kHapCVPixelFormat_RGBA 'RGBA'
+#define kHapCVPixelFormat_BGRA 'BGRA'
+
 /*
  S3TC RGB DXT1
  */
@@ -50,6 +57,16 @@
  */
 #define kHapCVPixelFormat_CoCgXY 'CCXY'
 
+/*
+ Video-range 4:2:2 Y'CbCr, the same values as kCVPixelFormatType_422YpCbCr8 (Cb Y0 Cr Y1, 8 bits each) and
+ kCVPixelFormatType_422YpCbCr10 (six pixels packed in 16 bytes as 10-bit values)
+
+ These are accepted by the Hap Q compressor, which converts them to YCoCg a block at a time, and emitted by the
+ decompressor, which converts to them from each row of decoded blocks
+ */
+#define kHapCVPixelFormat_2vuy '2vuy'
+#define kHapCVPixelFormat_v210 'v210'
+
 /*
  Planar Scaled YCoCg in SRTC RGBA DXT5 + Alpha in RGTC1
  */
@@ -62,4 +79,16 @@
  */
 #define kHapCVPixelFormat_A_RGTC1 'RGA1'
 
+/*
+ Boolean isDXTPixelFormat(OSType fmt)
+ 
+ For our purposes we treat YCoCg DXT as a DXT format
+ as this function is used to differentiate cases where
+ a DXT encode or decode stage is required.
+ */
+#define isDXTPixelFormat(fmt) (((fmt) == kHapCVPixelFormat_RGB_DXT1 \
+                                || (fmt) == kHapCVPixelFormat_RGBA_DXT5 \
+                                || (fmt) == kHapCVPixelFormat_YCoCg_DXT5 \
+                                || (fmt) == kHapCVPixelFormat_YCoCg_DXT5_A_RGTC1) ? true : false)
+
 #endif
@@ -28,56 +28,58 @@
 #include "SquishDecoder.h"
 #include "HapPlatform.h"
 #include "DXTBlocks.h"
+#include "DXTDecodeSIMD.h"
+#include "ParallelLoops.h"
 #include <stdint.h>
-#include <string.h>
-#include <tmmintrin.h>
-#include "squish-c.h"
 
 /*
     This file only used by the Windows codec
+
+    Blocks are decoded by the vectorised decoders in DXTDecodeSIMD.h rather than squish, whose output they match.
 */
 
-static HAP_INLINE void HapCodecSquishWriteBlockRGBA(uint8_t *block, uint8_t *dst, unsigned int dst_bytes_per_row)
+// Bands of block rows are decoded in parallel
+#define kHapCodecSquishDecodeMaxSliceCount 30U
+
+typedef struct HapCodecSquishDecodeTask {
+    const uint8_t   *src;
+    unsigned int    src_pixel_format;
+    uint8_t         *dst;
+    unsigned int    dst_pixel_format;
+    unsigned int    dst_bytes_per_row;
+    unsigned int    width;
+    unsigned int    height;
+    unsigned int    slice_height;
+    int             has_avx2;
+} HapCodecSquishDecodeTask;
+
+static void HapCodecSquishDecodeSlice(void *p, unsigned int index)
 {
-    int py;
-    for (py = 0; py < 4; py++)
+    HapCodecSquishDecodeTask *task = (HapCodecSquishDecodeTask *)p;
+    unsigned int bytes_per_block = (task->src_pixel_format == kHapCVPixelFormat_RGB_DXT1 ? 8 : 16);
+    unsigned int first_row = index * task->slice_height;
+    unsigned int last_row = first_row + task->slice_height;
+    unsigned int y;
+    const uint8_t *src_block = task->src + ((first_row / 4) * ((task->width + 3) / 4) * bytes_per_block);
+    unsigned int block_count = (task->width + 3) / 4;
+    int dxt5 = (task->src_pixel_format == kHapCVPixelFormat_RGB_DXT1 ? 0 : 1);
+    int bgra = (task->dst_pixel_format == 'RGBA' ? 0 : 1);
+    if (last_row > task->height)
     {
-        memcpy(dst, block, 16);
-        dst += dst_bytes_per_row;
-        block += 16;
+        last_row = task->height;
     }
-}
-
-static HAP_INLINE void HapCodecSquishWriteBlockBGRAScalar(uint8_t *block, uint8_t *dst, unsigned int dst_bytes_per_row)
-{
-    int y, x;
-    for (y = 0; y < 4; y++)
+    for (y = first_row; y < last_row; y+= 4)
     {
-        for (x = 0; x < 4; x++)
+        uint8_t *dst_base = task->dst + (task->dst_bytes_per_row * y);
+        if (task->has_avx2)
         {
-            dst[0] = block[2];
-            dst[1] = block[1];
-            dst[2] = block[0];
-            dst[3] = block[3];
-            dst += 4;
-            block += 4;
+            HapCodecDXTDecodeBlocksAVX2(src_block, dst_base, task->dst_bytes_per_row, block_count, dxt5, bgra);
         }
-        dst += dst_bytes_per_row - 16;
-    }
-}
-
-static HAP_INLINE void HapCodecSquishWriteBlockBGRASSE3(uint8_t *block, uint8_t *dst, unsigned int dst_bytes_per_row)
-{
-    int y;
-    __m128i a;
-    const __m128i mask = _mm_set_epi8(0x0F, 0x0C, 0x0D, 0x0E, 0x0B, 0x08, 0x09, 0x0A, 0x07, 0x04, 0x05, 0x06, 0x03, 0x00, 0x01, 0x02);
-
-    for (y = 0; y < 4; y++)
-    {
-        a = _mm_load_si128((__m128i *)block);
-        _mm_store_si128((__m128i *)dst, _mm_shuffle_epi8(a, mask));
-        dst += dst_bytes_per_row;
-        block += 16;
+        else
+        {
+            HapCodecDXTDecodeBlocksSSE2(src_block, dst_base, task->dst_bytes_per_row, block_count, dxt5, bgra);
+        }
+        src_block += block_count * bytes_per_block;
     }
 }
 
@@ -89,35 +91,22 @@ void HapCodecSquishDecode(const void *src,
                           unsigned int width,
                           unsigned int height)
 {
-    unsigned int y,x;
-    int bytes_per_block = (src_pixel_format == kHapCVPixelFormat_RGB_DXT1 ? 8 : 16);
-    uint8_t *src_block = (uint8_t *)src;
-    int flags = (src_pixel_format == kHapCVPixelFormat_RGB_DXT1 ? kDxt1 : kDxt5);
-    int hasSSSE3 = 0;
-    if (dst_pixel_format != 'RGBA')
+    HapCodecSquishDecodeTask task;
+    unsigned int block_rows = (height + 3) / 4;
+    unsigned int slice_count = block_rows < kHapCodecSquishDecodeMaxSliceCount ? block_rows : kHapCodecSquishDecodeMaxSliceCount;
+    if (slice_count == 0)
     {
-        hasSSSE3 = HapCodecHasSSSE3();
-    }
-    for (y = 0; y < height; y+= 4)
-    {
-        for (x = 0; x < width; x += 4)
-        {
-            HAP_ALIGN_16 uint8_t block_rgba[16*4];
-            uint8_t *dst_base = ((uint8_t *)dst) + (dst_bytes_per_row * y) + (4 * x);
-            SquishDecompress(block_rgba, src_block, flags);
-            if (dst_pixel_format == 'RGBA')
-            {
-                HapCodecSquishWriteBlockRGBA(block_rgba, dst_base, dst_bytes_per_row);
-            }
-            else if (hasSSSE3)
-            {
-                HapCodecSquishWriteBlockBGRASSE3(block_rgba, dst_base, dst_bytes_per_row);
-            }
-            else
-            {
-                HapCodecSquishWriteBlockBGRAScalar(block_rgba, dst_base, dst_bytes_per_row);
-            }
-            src_block += bytes_per_block;
-        }
+        return;
     }
+    task.src = (const uint8_t *)src;
+    task.src_pixel_format = src_pixel_format;
+    task.dst = (uint8_t *)dst;
+    task.dst_pixel_format = dst_pixel_format;
+    task.dst_bytes_per_row = dst_bytes_per_row;
+    task.width = width;
+    task.height = height;
+    task.slice_height = ((block_rows + slice_count - 1) / slice_count) * 4;
+    task.has_avx2 = HapCodecHasAVX2();
+    slice_count = (block_rows * 4 + task.slice_height - 1) / task.slice_height;
+    HapParallelFor(HapCodecSquishDecodeSlice, &task, slice_count);
 }
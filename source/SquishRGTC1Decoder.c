@@ -25,23 +25,58 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "SquishDecoder.h"
+#include "SquishRGTC1Decoder.h"
 #include "HapPlatform.h"
 #include "DXTBlocks.h"
+#include "DXTDecodeSIMD.h"
+#include "ParallelLoops.h"
 #include <stdint.h>
-#include <string.h>
-#include "squish-c.h"
 
-static HAP_INLINE void HapCodecDXTWriteAlphaBlockXXXA(const uint8_t *copy_src, uint8_t *copy_dst, unsigned int dst_bytes_per_row)
+// Bands of block rows are decoded in parallel
+#define kHapCodecSquishRGTC1DecodeMaxSliceCount 30U
+
+typedef struct HapCodecSquishRGTC1DecodeTask {
+    const uint8_t                       *src;
+    uint8_t                             *dst;
+    unsigned int                        dst_bytes_per_row;
+    unsigned int                        width;
+    unsigned int                        height;
+    unsigned int                        slice_height;
+    int                                 has_avx2;
+    HapCodecSquishRGTC1ColourFunction   colour_function;
+    void                                *colour_info;
+} HapCodecSquishRGTC1DecodeTask;
+
+static void HapCodecSquishRGTC1DecodeSlice(void *p, unsigned int index)
 {
-    int i, j;
-    for (i = 0; i < 4; i++) {
-        for (j = 0; j < 4; j++) {
-            copy_dst[3] = copy_src[3];
-            copy_dst += 4;
-            copy_src += 4;
+    HapCodecSquishRGTC1DecodeTask *task = (HapCodecSquishRGTC1DecodeTask *)p;
+    unsigned int first_row = index * task->slice_height;
+    unsigned int last_row = first_row + task->slice_height;
+    unsigned int block_count = (task->width + 3) / 4;
+    unsigned int y;
+    const uint8_t *src_block = task->src + ((first_row / 4) * block_count * 8);
+
+    if (last_row > task->height)
+    {
+        last_row = task->height;
+    }
+    for (y = first_row; y < last_row; y+= 4)
+    {
+        uint8_t *dst_base = task->dst + (task->dst_bytes_per_row * y);
+        if (task->colour_function)
+        {
+            // Write the colour of this row of blocks while it is in cache for the alpha
+            task->colour_function(task->colour_info, y, (last_row - y) < 4 ? last_row - y : 4);
         }
-        copy_dst += dst_bytes_per_row - 16;
+        if (task->has_avx2)
+        {
+            HapCodecRGTC1DecodeBlocksAVX2(src_block, dst_base, task->dst_bytes_per_row, block_count);
+        }
+        else
+        {
+            HapCodecRGTC1DecodeBlocksSSE2(src_block, dst_base, task->dst_bytes_per_row, block_count);
+        }
+        src_block += block_count * 8;
     }
 }
 
@@ -49,22 +84,26 @@ void HapCodecSquishRGTC1Decode(const void *src,
                                void *dst,
                                unsigned int dst_bytes_per_row,
                                unsigned int width,
-                               unsigned int height)
+                               unsigned int height,
+                               HapCodecSquishRGTC1ColourFunction colour_function,
+                               void *colour_info)
 {
-    unsigned int y,x;
-    uint8_t *src_block = (uint8_t *)src;
-
-    // TODO: SSE3 version if needed
-
-    for (y = 0; y < height; y+= 4)
+    HapCodecSquishRGTC1DecodeTask task;
+    unsigned int block_rows = (height + 3) / 4;
+    unsigned int slice_count = block_rows < kHapCodecSquishRGTC1DecodeMaxSliceCount ? block_rows : kHapCodecSquishRGTC1DecodeMaxSliceCount;
+    if (slice_count == 0)
     {
-        for (x = 0; x < width; x += 4)
-        {
-            HAP_ALIGN_16 uint8_t block_rgba[16*4];
-            uint8_t *dst_base = ((uint8_t *)dst) + (dst_bytes_per_row * y) + (4 * x);
-            SquishDecompress(block_rgba, src_block, kRgtc1A);
-            HapCodecDXTWriteAlphaBlockXXXA(block_rgba, dst_base, dst_bytes_per_row);
-            src_block += 8;
-        }
+        return;
     }
+    task.src = (const uint8_t *)src;
+    task.dst = (uint8_t *)dst;
+    task.dst_bytes_per_row = dst_bytes_per_row;
+    task.width = width;
+    task.height = height;
+    task.slice_height = ((block_rows + slice_count - 1) / slice_count) * 4;
+    task.has_avx2 = HapCodecHasAVX2();
+    task.colour_function = colour_function;
+    task.colour_info = colour_info;
+    slice_count = (block_rows * 4 + task.slice_height - 1) / task.slice_height;
+    HapParallelFor(HapCodecSquishRGTC1DecodeSlice, &task, slice_count);
 }
@@ -27,8 +27,19 @@
 
 #include "PixelFormats.h"
 
+/*
+ Called before the alpha of each row of blocks is written, with the range of pixel rows, so a colour pass
+ can write the same rows while they are in cache. Calls for different rows may be made in parallel.
+ */
+typedef void (*HapCodecSquishRGTC1ColourFunction)(void *info, unsigned int first_row, unsigned int row_count);
+
+/*
+ Replaces the alpha of the pixels in dst with that decoded from src. colour_function may be NULL.
+ */
 void HapCodecSquishRGTC1Decode(const void *src,
                                void *dst,
                                unsigned int dst_bytes_per_row,
                                unsigned int width,
-                               unsigned int height);
+                               unsigned int height,
+                               HapCodecSquishRGTC1ColourFunction colour_function,
+                               void *colour_info);
@@ -26,227 +26,242 @@
  */
 
 #include "Tasks.h"
+#include "ParallelLoops.h"
+#include "HapPlatform.h"
+#include <stdlib.h>
+#if defined(_WIN32)
+#include <Windows.h>
+#else
+#include <pthread.h>
+#endif
+
+/*
+ Every task group in the process is a session of one scheduler. Tasks wait in their group's queue, and groups with
+ tasks waiting are kept in a ring which runners serve a task at a time, moving each group to the back once it has had
+ its turn, so one busy session can't hold up the others. Runners are started with HapParallelAsync() on the process's
+ shared worker threads, never more at once than HapParallelGetWorkerLimit(), and each runs tasks until none are left.
+ If no runner can be started a session runs its own tasks on the calling thread, and never those of other sessions.
+ */
+
+#if defined(_WIN32)
+typedef SRWLOCK HapCodecTasksLock;
+typedef CONDITION_VARIABLE HapCodecTasksCondition;
+#define kHapCodecTasksLockInitializer SRWLOCK_INIT
+#define HapCodecTasksLockAcquire(lock) AcquireSRWLockExclusive(lock)
+#define HapCodecTasksLockRelease(lock) ReleaseSRWLockExclusive(lock)
+#define HapCodecTasksConditionInit(condition) (InitializeConditionVariable(condition), 0)
+#define HapCodecTasksConditionDestroy(condition)
+#define HapCodecTasksConditionWait(condition, lock) SleepConditionVariableSRW((condition), (lock), INFINITE, 0)
+#define HapCodecTasksConditionBroadcast(condition) WakeAllConditionVariable(condition)
+#else
+typedef pthread_mutex_t HapCodecTasksLock;
+typedef pthread_cond_t HapCodecTasksCondition;
+#define kHapCodecTasksLockInitializer PTHREAD_MUTEX_INITIALIZER
+#define HapCodecTasksLockAcquire(lock) pthread_mutex_lock(lock)
+#define HapCodecTasksLockRelease(lock) pthread_mutex_unlock(lock)
+#define HapCodecTasksConditionInit(condition) pthread_cond_init((condition), NULL)
+#define HapCodecTasksConditionDestroy(condition) pthread_cond_destroy(condition)
+#define HapCodecTasksConditionWait(condition, lock) pthread_cond_wait((condition), (lock))
+#define HapCodecTasksConditionBroadcast(condition) pthread_cond_broadcast(condition)
+#endif
 
-#if defined(__APPLE__)
 struct HapCodecTaskGroup {
     HapCodecTaskWorkFunction    task;
-    dispatch_group_t            group;
-    dispatch_queue_t            queue;
-    dispatch_semaphore_t        semaphore;
+    unsigned int                maxTasks;
+    void **                     contexts; // a ring of maxTasks queued contexts
+    /*
+    Below this line members are guarded by the scheduler's lock
+    */
+    unsigned int                firstQueued;
+    unsigned int                queued;
+    unsigned int                outstanding; // queued or running
+    int                         inRing;
+    HapCodecTaskGroupRef        next; // in the ring of groups with queued tasks
+    HapCodecTasksCondition      changed; // broadcast as each task completes
 };
 
-void HapCodecTasksAddTask(HapCodecTaskGroupRef group, void *context)
-{
-    if (group && group->group && group->queue && group->task && group->semaphore)
-    {
-        dispatch_semaphore_wait(group->semaphore, DISPATCH_TIME_FOREVER);
-        // Copy values in case group is released before execution
-        HapCodecTaskWorkFunction task = group->task;
-        dispatch_semaphore_t semaphore = group->semaphore;
-        // Retain semaphore for block
-        dispatch_retain(semaphore);
-        dispatch_group_async(group->group, group->queue, ^{
-            task(context);
-            dispatch_semaphore_signal(semaphore);
-            dispatch_release(semaphore);
-        });
-    }
-}
+static HapCodecTasksLock hapCodecTasksLock = kHapCodecTasksLockInitializer;
+static HapCodecTaskGroupRef hapCodecTasksRingFirst = NULL;
+static HapCodecTaskGroupRef hapCodecTasksRingLast = NULL;
+static unsigned int hapCodecTasksRunners = 0;
 
-void HapCodecTasksWaitForGroupToComplete(HapCodecTaskGroupRef group)
+// Called with the lock held
+static void HapCodecTasksRingAppend(HapCodecTaskGroupRef group)
 {
-    if (group && group->group) dispatch_group_wait(group->group, DISPATCH_TIME_FOREVER);
+    group->next = NULL;
+    group->inRing = 1;
+    if (hapCodecTasksRingLast)
+        hapCodecTasksRingLast->next = group;
+    else
+        hapCodecTasksRingFirst = group;
+    hapCodecTasksRingLast = group;
 }
 
-HapCodecTaskGroupRef HapCodecTasksCreateGroup(HapCodecTaskWorkFunction task, unsigned int maxTasks)
+// Called with the lock held, takes a task from the group at the front of the ring
+static int HapCodecTasksTakeNext(HapCodecTaskGroupRef *outGroup, void **outContext)
 {
-    HapCodecTaskGroupRef group = NULL;
-    if (task)
-    {
-        group = malloc(sizeof(struct HapCodecTaskGroup));
-        if (group)
-        {
-            group->task = task;
-            group->group = dispatch_group_create();
-            group->queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
-            group->semaphore = dispatch_semaphore_create(maxTasks);
-            if (group->group == NULL || group->queue == NULL || group->semaphore == NULL)
-            {
-                HapCodecTasksDestroyGroup(group);
-                group = NULL;
-            }
-        }
-    }
-    return group;
+    HapCodecTaskGroupRef group = hapCodecTasksRingFirst;
+    if (group == NULL)
+        return 0;
+
+    *outGroup = group;
+    *outContext = group->contexts[group->firstQueued];
+    group->firstQueued = (group->firstQueued + 1) % group->maxTasks;
+    group->queued--;
+
+    hapCodecTasksRingFirst = group->next;
+    if (hapCodecTasksRingFirst == NULL)
+        hapCodecTasksRingLast = NULL;
+    group->inRing = 0;
+    if (group->queued)
+        HapCodecTasksRingAppend(group);
+    return 1;
 }
 
-void HapCodecTasksDestroyGroup(HapCodecTaskGroupRef group)
+// Called with the lock held, runs tasks until none are queued or there are more runners than the limit allows
+static void HapCodecTasksRunQueued(void)
 {
-    if (group)
+    HapCodecTaskGroupRef group;
+    void *context;
+    while (hapCodecTasksRunners <= HapParallelGetWorkerLimit() && HapCodecTasksTakeNext(&group, &context))
     {
-        if (group->group) dispatch_release(group->group);
-        if (group->queue) dispatch_release(group->queue);
-        if (group->semaphore) dispatch_release(group->semaphore);
-        free(group);
+        HapCodecTasksLockRelease(&hapCodecTasksLock);
+
+        group->task(context);
+
+        HapCodecTasksLockAcquire(&hapCodecTasksLock);
+        group->outstanding--;
+        HapCodecTasksConditionBroadcast(&group->changed);
     }
 }
 
-#else
+// Called with the lock held, runs the group's next queued task on the calling thread, returning zero if it had none
+static int HapCodecTasksRunFromGroup(HapCodecTaskGroupRef group)
+{
+    HapCodecTaskGroupRef *link;
+    HapCodecTaskGroupRef previous = NULL;
+    void *context;
 
-#include <Windows.h>
-#include <malloc.h>
+    if (group->queued == 0)
+        return 0;
 
-struct HapCodecTaskGroup {
-    HapCodecTaskWorkFunction    task;
-    unsigned int                maxTasks;
-    PTP_POOL                    pool;
-    PTP_WORK                    work;
-    PTP_CLEANUP_GROUP           cleanup;
-    /*
-    Below this line members are shared between threads
-    */ 
-    HANDLE                      sharedSemaphore;
-    CRITICAL_SECTION            sharedCritical;
-    void **                     sharedContexts;
-};
+    context = group->contexts[group->firstQueued];
+    group->firstQueued = (group->firstQueued + 1) % group->maxTasks;
+    group->queued--;
 
-static void NTAPI HapCodecTasksWorkCallback(PTP_CALLBACK_INSTANCE instance, PVOID context, PTP_WORK work)
-{
-    struct HapCodecTaskGroup *group = (struct HapCodecTaskGroup *)context;
-    if (group)
+    if (group->queued == 0)
     {
-        void *userContext = NULL;
-        unsigned int i;
-
-        EnterCriticalSection(&(group->sharedCritical));
-
-        // Get the first item from the queue
-        userContext = group->sharedContexts[0];
+        // Take the group out of the ring, wherever it is
+        for (link = &hapCodecTasksRingFirst; *link != group; link = &(*link)->next)
+            previous = *link;
+        *link = group->next;
+        if (hapCodecTasksRingLast == group)
+            hapCodecTasksRingLast = previous;
+        group->inRing = 0;
+    }
 
-        // Move queue items down so we behave as a FIFO queue
-        for (i = 0; i < group->maxTasks - 1; i++)
-        {
-            group->sharedContexts[i] = group->sharedContexts[i+1];
-        }
-        group->sharedContexts[group->maxTasks - 1] = NULL;
+    HapCodecTasksLockRelease(&hapCodecTasksLock);
 
-        LeaveCriticalSection(&(group->sharedCritical));
+    group->task(context);
 
-        group->task(userContext);
+    HapCodecTasksLockAcquire(&hapCodecTasksLock);
+    group->outstanding--;
+    HapCodecTasksConditionBroadcast(&group->changed);
+    return 1;
+}
 
-        ReleaseSemaphoreWhenCallbackReturns(instance, group->sharedSemaphore, 1);
+// Called with the lock held as a runner stops. When none are left, sessions waiting on queued tasks are woken to run them
+static void HapCodecTasksRunnerStopped(void)
+{
+    HapCodecTaskGroupRef group;
+    hapCodecTasksRunners--;
+    if (hapCodecTasksRunners == 0)
+    {
+        for (group = hapCodecTasksRingFirst; group != NULL; group = group->next)
+            HapCodecTasksConditionBroadcast(&group->changed);
     }
 }
 
-static void NTAPI HapCodecTasksCleanupCallback(PVOID ObjectContext, PVOID CleanupContext)
+static void HapCodecTasksRunner(void *info HAP_ATTR_UNUSED)
 {
-    // For now we have no cleanup to perform here
+    HapCodecTasksLockAcquire(&hapCodecTasksLock);
+    HapCodecTasksRunQueued();
+    HapCodecTasksRunnerStopped();
+    HapCodecTasksLockRelease(&hapCodecTasksLock);
 }
 
 void HapCodecTasksAddTask(HapCodecTaskGroupRef group, void *context)
 {
-    if (group && group->work && group->sharedSemaphore)
+    if (group)
     {
-        unsigned int i;
-        // TODO: If we can coordinate waiting for ALL threads to finish
-        // we can make this much simpler using
-        // TrySubmitThreadpoolCallback(....) and 
-        WaitForSingleObject(group->sharedSemaphore, INFINITE);
-        
-        EnterCriticalSection(&(group->sharedCritical));
-        for (i = 0; i < group->maxTasks; i++)
+        int startRunner = 0;
+
+        HapCodecTasksLockAcquire(&hapCodecTasksLock);
+
+        while (group->outstanding >= group->maxTasks)
         {
-            if (group->sharedContexts[i] == NULL)
-            {
-                group->sharedContexts[i] = context;
-                break;
-            }
+            // With no runners, queued tasks only run if their group runs them
+            if (hapCodecTasksRunners == 0 && HapCodecTasksRunFromGroup(group))
+                continue;
+            HapCodecTasksConditionWait(&group->changed, &hapCodecTasksLock);
+        }
+        group->contexts[(group->firstQueued + group->queued) % group->maxTasks] = context;
+        group->queued++;
+        group->outstanding++;
+        if (group->inRing == 0)
+            HapCodecTasksRingAppend(group);
+
+        if (hapCodecTasksRunners < HapParallelGetWorkerLimit())
+        {
+            hapCodecTasksRunners++;
+            startRunner = 1;
+        }
+
+        HapCodecTasksLockRelease(&hapCodecTasksLock);
+
+        if (startRunner && HapParallelAsync(HapCodecTasksRunner, NULL) == 0)
+        {
+            // Without a worker one of this group's tasks is run here, leaving other sessions' tasks to their own
+            HapCodecTasksLockAcquire(&hapCodecTasksLock);
+            HapCodecTasksRunnerStopped();
+            HapCodecTasksRunFromGroup(group);
+            HapCodecTasksLockRelease(&hapCodecTasksLock);
         }
-        LeaveCriticalSection(&(group->sharedCritical));
-        
-        SubmitThreadpoolWork(group->work);
     }
 }
 
 void HapCodecTasksWaitForGroupToComplete(HapCodecTaskGroupRef group)
 {
-    if (group && group->work) WaitForThreadpoolWorkCallbacks(group->work, FALSE);
+    if (group)
+    {
+        HapCodecTasksLockAcquire(&hapCodecTasksLock);
+        while (group->outstanding != 0)
+        {
+            if (hapCodecTasksRunners == 0 && HapCodecTasksRunFromGroup(group))
+                continue;
+            HapCodecTasksConditionWait(&group->changed, &hapCodecTasksLock);
+        }
+        HapCodecTasksLockRelease(&hapCodecTasksLock);
+    }
 }
 
 HapCodecTaskGroupRef HapCodecTasksCreateGroup(HapCodecTaskWorkFunction task, unsigned int maxTasks)
 {
     HapCodecTaskGroupRef group = NULL;
-    if (task)
+    if (task && maxTasks > 0)
     {
-        group = (HapCodecTaskGroupRef)malloc(sizeof(struct HapCodecTaskGroup));
+        group = (HapCodecTaskGroupRef)calloc(1, sizeof(struct HapCodecTaskGroup));
         if (group)
         {
-            BOOL success = FALSE;
-            TP_CALLBACK_ENVIRON         callbackEnviron;
-            SYSTEM_INFO system;
-            
-            GetSystemInfo(&system);
-
-            InitializeThreadpoolEnvironment(&callbackEnviron);
-
-            InitializeCriticalSection(&group->sharedCritical);
-
             group->task = task;
             group->maxTasks = maxTasks;
-            group->pool = CreateThreadpool(NULL);
-            group->work = NULL;
-            group->cleanup = NULL;
-            group->sharedSemaphore = NULL;
-            group->sharedContexts = NULL;
-
-            if (group->pool)
-            {
-                SetThreadpoolThreadMaximum(group->pool, system.dwNumberOfProcessors);
-                success = SetThreadpoolThreadMinimum(group->pool, 1);
-            }
-            if (success)
-            {
-                SetThreadpoolCallbackPool(&callbackEnviron, group->pool);
-            }
-            if (success)
-            {
-                group->cleanup = CreateThreadpoolCleanupGroup();
-                if (group->cleanup == NULL) success = FALSE;
-            }
-            if (success)
-            {
-                SetThreadpoolCallbackCleanupGroup(&callbackEnviron, group->cleanup, (PTP_CLEANUP_GROUP_CANCEL_CALLBACK)HapCodecTasksCleanupCallback);
-            }
-            if (success)
-            {
-                group->work = CreateThreadpoolWork((PTP_WORK_CALLBACK)HapCodecTasksWorkCallback, group, &callbackEnviron);
-                if (group->work == NULL) success = FALSE;
-            }
-            if (success)
-            {
-                group->sharedSemaphore = CreateSemaphore(NULL, maxTasks, maxTasks, NULL);
-                if (group->sharedSemaphore == NULL) success = FALSE;
-            }
-            if (success)
-            {
-                unsigned int i;
-                group->sharedContexts = (void **)malloc(sizeof(void *) * maxTasks);
-                if (group->sharedContexts)
-                {
-                    for (i = 0; i < maxTasks; i++)
-                        group->sharedContexts[i] = NULL;
-                }
-                else
-                {
-                    success = FALSE;
-                }
-            }
-            if (success == FALSE)
+            group->contexts = (void **)malloc(sizeof(void *) * maxTasks);
+            if (group->contexts == NULL || HapCodecTasksConditionInit(&group->changed) != 0)
             {
-                HapCodecTasksDestroyGroup(group);
+                free(group->contexts);
+                free(group);
                 group = NULL;
             }
-            DestroyThreadpoolEnvironment(&callbackEnviron);
         }
     }
     return group;
@@ -256,25 +271,10 @@ void HapCodecTasksDestroyGroup(HapCodecTaskGroupRef group)
 {
     if (group)
     {
-        DeleteCriticalSection(&(group->sharedCritical));
-        if (group->cleanup)
-        {
-            CloseThreadpoolCleanupGroupMembers(group->cleanup, FALSE, NULL);
-            CloseThreadpoolCleanupGroup(group->cleanup);
-        }
-        if (group->pool)
-        {
-            CloseThreadpool(group->pool);
-        }
-        if (group->sharedSemaphore)
-        {
-            CloseHandle(group->sharedSemaphore);
-        }
-        if (group->sharedContexts)
-        {
-            free(group->sharedContexts);
-        }
+        // Let queued work finish, after which no runner holds the group
+        HapCodecTasksWaitForGroupToComplete(group);
+        HapCodecTasksConditionDestroy(&group->changed);
+        free(group->contexts);
         free(group);
     }
 }
-#endif
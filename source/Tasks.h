@@ -25,6 +25,12 @@
  SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
+/*
+ A task group is one session's queue of work for the process's shared worker threads. Groups take turns a task at a
+ time, and no more tasks run at once across all groups than HapParallelGetWorkerLimit() allows. HapCodecTasksAddTask()
+ blocks while a group has maxTasks tasks queued or running.
+ */
+
 typedef struct HapCodecTaskGroup * HapCodecTaskGroupRef;
 
 typedef void (*HapCodecTaskWorkFunction)(void *context);
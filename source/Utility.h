@@ -44,18 +44,6 @@ int roundUpToMultipleOf16( int n );
 
 unsigned long dxtBytesForDimensions(int width, int height, OSType codecSubType);
 
-/*
- Boolean isDXTPixelFormat(OSType fmt)
- 
- For our purposes we treat YCoCg DXT as a DXT format
- as this function is used to differentiate cases where
- a DXT encode or decode stage is required.
- */
-#define isDXTPixelFormat(fmt) (((fmt) == kHapCVPixelFormat_RGB_DXT1 \
-                                || (fmt) == kHapCVPixelFormat_RGBA_DXT5 \
-                                || (fmt) == kHapCVPixelFormat_YCoCg_DXT5 \
-                                || (fmt) == kHapCVPixelFormat_YCoCg_DXT5_A_RGTC1) ? true : false)
-
 SInt16 resourceIDForComponentType(OSType componentType, OSType resourceType);
 
 int hapCodecMaxTasks();
@@ -0,0 +1,372 @@
+/*
+ YCbCr.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "YCbCr.h"
+#include "HapPlatform.h"
+#include <emmintrin.h>
+
+/*
+ Coefficients are in 2.13 fixed point and apply to 10-bit values, so 8-bit values are scaled by 4 first and the
+ results shifted down by 15 bits. Luma is offset by 64 and chroma by 512 (16 and 128 at 8 bits). Every coefficient
+ and offset value fits in 16 bits, so the SSE2 path below can use madd and gives the same results.
+ */
+typedef struct HapCodecYCbCrCoefficients {
+    int16_t y;
+    int16_t cr_r;
+    int16_t cb_g;
+    int16_t cr_g;
+    int16_t cb_b;
+} HapCodecYCbCrCoefficients;
+
+static const HapCodecYCbCrCoefficients kHapCodecYCbCrToRGB[2] = {
+    // ITU-R BT.601: 255/219, then 1.402, 0.344136, 0.714136 and 1.772 scaled by 255/224
+    { 9539, 13075, 3209, 6660, 16525 },
+    // ITU-R BT.709: 255/219, then 1.5748, 0.187324, 0.468124 and 1.8556 scaled by 255/224
+    { 9539, 14686, 1747, 4366, 17305 }
+};
+
+#define kHapCodecYCbCrRound (1 << 14)
+
+#define HapCodecYCbCrClamp(x) ((x) < 0 ? 0 : ((x) > 255 ? 255 : (x)))
+
+// y, cb and cr are 10-bit values less their offsets
+static void HapCodecYCbCrPixelToRGBA(int y, int cb, int cr, const HapCodecYCbCrCoefficients *k, uint8_t *dst)
+{
+    int32_t luma = (y * k->y) + kHapCodecYCbCrRound;
+    int32_t r = (luma + (cr * k->cr_r)) >> 15;
+    int32_t g = (luma - (cb * k->cb_g) - (cr * k->cr_g)) >> 15;
+    int32_t b = (luma + (cb * k->cb_b)) >> 15;
+    dst[0] = HapCodecYCbCrClamp(r);
+    dst[1] = HapCodecYCbCrClamp(g);
+    dst[2] = HapCodecYCbCrClamp(b);
+    dst[3] = 255;
+}
+
+// Eight pixels as HapCodecYCbCrPixelToRGBA(), from 16-bit values less their offsets
+static HAP_INLINE void HapCodecYCbCrPixelsToRGBASSE2(__m128i y, __m128i cb, __m128i cr, const HapCodecYCbCrCoefficients *k, uint8_t *dst)
+{
+    const __m128i round = _mm_set1_epi32(kHapCodecYCbCrRound);
+    const __m128i r_weights = _mm_set1_epi32((int)((uint16_t)k->y | ((uint32_t)(uint16_t)k->cr_r << 16)));
+    const __m128i b_weights = _mm_set1_epi32((int)((uint16_t)k->y | ((uint32_t)(uint16_t)k->cb_b << 16)));
+    const __m128i g_weights = _mm_set1_epi32((int)((uint16_t)k->y | ((uint32_t)(uint16_t)-k->cb_g << 16)));
+    // The rounding is applied to green through its second pair, as Cr and 1
+    const __m128i g_cr_weights = _mm_set1_epi32((int)((uint16_t)-k->cr_g | ((uint32_t)kHapCodecYCbCrRound << 16)));
+    const __m128i one = _mm_set1_epi16(1);
+    __m128i r_lo, r_hi, g_lo, g_hi, b_lo, b_hi, r, g, b, rb, ga, rg, ba;
+
+    r_lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, cr), r_weights), round), 15);
+    r_hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, cr), r_weights), round), 15);
+    b_lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, cb), b_weights), round), 15);
+    b_hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, cb), b_weights), round), 15);
+    g_lo = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(y, cb), g_weights),
+                                        _mm_madd_epi16(_mm_unpacklo_epi16(cr, one), g_cr_weights)), 15);
+    g_hi = _mm_srai_epi32(_mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(y, cb), g_weights),
+                                        _mm_madd_epi16(_mm_unpackhi_epi16(cr, one), g_cr_weights)), 15);
+
+    r = _mm_packs_epi32(r_lo, r_hi);
+    g = _mm_packs_epi32(g_lo, g_hi);
+    b = _mm_packs_epi32(b_lo, b_hi);
+
+    // The saturating packs clamp to 0...255
+    rb = _mm_packus_epi16(r, b);
+    ga = _mm_packus_epi16(g, _mm_set1_epi16(255));
+    rg = _mm_unpacklo_epi8(rb, ga);
+    ba = _mm_unpackhi_epi8(rb, ga);
+    _mm_storeu_si128((__m128i *)dst, _mm_unpacklo_epi16(rg, ba));
+    _mm_storeu_si128((__m128i *)(dst + 16), _mm_unpackhi_epi16(rg, ba));
+}
+
+size_t HapCodecYCbCrBytesPerRow(unsigned int pixel_format, unsigned long width)
+{
+    switch (pixel_format) {
+        case kHapCVPixelFormat_2vuy:
+            // Cb Y0 Cr Y1 for each pair of pixels
+            return ((width + 1) / 2) * 4;
+        case kHapCVPixelFormat_v210:
+            // Three 10-bit values in each 32-bit word, four words for six pixels
+            return ((width + 5) / 6) * 16;
+        default:
+            return 0;
+    }
+}
+
+static uint32_t HapCodecYCbCrReadWord(const uint8_t *src)
+{
+    return (uint32_t)src[0] | ((uint32_t)src[1] << 8) | ((uint32_t)src[2] << 16) | ((uint32_t)src[3] << 24);
+}
+
+// The number of v210 pixels unpacked at a time, a multiple of 8
+#define kHapCodecYCbCrV210BatchLength 48U
+
+void HapCodecYCbCrRowToRGBA(const uint8_t *src, unsigned int pixel_format, unsigned long first, unsigned long count, uint8_t *dst, int matrix)
+{
+    const HapCodecYCbCrCoefficients *k = &kHapCodecYCbCrToRGB[matrix == HapCodecYCbCrMatrix_ITU_R_709 ? 1 : 0];
+    unsigned long x = first;
+    unsigned long end = first + count;
+
+    if (pixel_format == kHapCVPixelFormat_2vuy)
+    {
+        const __m128i low_bytes = _mm_set1_epi16(0xFF);
+        const __m128i luma_offset = _mm_set1_epi16(64);
+        const __m128i chroma_offset = _mm_set1_epi16(512);
+        for (; x < end; x++)
+        {
+            const uint8_t *pair = src + ((x / 2) * 4);
+            // Once at the start of a pair, convert eight pixels at a time
+            if ((x & 1) == 0 && end - x >= 8)
+            {
+                __m128i pixels = _mm_loadu_si128((const __m128i *)pair);
+                __m128i y = _mm_sub_epi16(_mm_slli_epi16(_mm_srli_epi16(pixels, 8), 2), luma_offset);
+                __m128i c = _mm_sub_epi16(_mm_slli_epi16(_mm_and_si128(pixels, low_bytes), 2), chroma_offset);
+                __m128i cb = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(2, 2, 0, 0)), _MM_SHUFFLE(2, 2, 0, 0));
+                __m128i cr = _mm_shufflehi_epi16(_mm_shufflelo_epi16(c, _MM_SHUFFLE(3, 3, 1, 1)), _MM_SHUFFLE(3, 3, 1, 1));
+                HapCodecYCbCrPixelsToRGBASSE2(y, cb, cr, k, dst);
+                dst += 32;
+                x += 7;
+            }
+            else
+            {
+                HapCodecYCbCrPixelToRGBA((pair[1 + ((x & 1) * 2)] << 2) - 64, (pair[0] << 2) - 512, (pair[2] << 2) - 512, k, dst);
+                dst += 4;
+            }
+        }
+    }
+    else if (pixel_format == kHapCVPixelFormat_v210)
+    {
+        while (x < end)
+        {
+            // Unpack a batch of pixels, then convert them eight at a time
+            HAP_ALIGN_16 int16_t y[kHapCodecYCbCrV210BatchLength];
+            HAP_ALIGN_16 int16_t cb[kHapCodecYCbCrV210BatchLength];
+            HAP_ALIGN_16 int16_t cr[kHapCodecYCbCrV210BatchLength];
+            unsigned long batch = end - x < kHapCodecYCbCrV210BatchLength ? end - x : kHapCodecYCbCrV210BatchLength;
+            unsigned long i = 0;
+
+            while (i < batch)
+            {
+                const uint8_t *group = src + ((x / 6) * 16);
+                uint32_t w0 = HapCodecYCbCrReadWord(group);
+                uint32_t w1 = HapCodecYCbCrReadWord(group + 4);
+                uint32_t w2 = HapCodecYCbCrReadWord(group + 8);
+                uint32_t w3 = HapCodecYCbCrReadWord(group + 12);
+                int group_y[6], group_cb[3], group_cr[3];
+                unsigned int j;
+
+                group_cb[0] = w0 & 0x3FF;   group_y[0] = (w0 >> 10) & 0x3FF;    group_cr[0] = (w0 >> 20) & 0x3FF;
+                group_y[1] = w1 & 0x3FF;    group_cb[1] = (w1 >> 10) & 0x3FF;   group_y[2] = (w1 >> 20) & 0x3FF;
+                group_cr[1] = w2 & 0x3FF;   group_y[3] = (w2 >> 10) & 0x3FF;    group_cb[2] = (w2 >> 20) & 0x3FF;
+                group_y[4] = w3 & 0x3FF;    group_cr[2] = (w3 >> 10) & 0x3FF;   group_y[5] = (w3 >> 20) & 0x3FF;
+
+                for (j = x % 6; j < 6 && i < batch; j++, i++, x++)
+                {
+                    y[i] = (int16_t)(group_y[j] - 64);
+                    cb[i] = (int16_t)(group_cb[j / 2] - 512);
+                    cr[i] = (int16_t)(group_cr[j / 2] - 512);
+                }
+            }
+
+            for (i = 0; i + 8 <= batch; i += 8)
+            {
+                HapCodecYCbCrPixelsToRGBASSE2(_mm_load_si128((const __m128i *)(y + i)),
+                                              _mm_load_si128((const __m128i *)(cb + i)),
+                                              _mm_load_si128((const __m128i *)(cr + i)),
+                                              k, dst);
+                dst += 32;
+            }
+            for (; i < batch; i++)
+            {
+                HapCodecYCbCrPixelToRGBA(y[i], cb[i], cr[i], k, dst);
+                dst += 4;
+            }
+        }
+    }
+}
+
+/*
+ Coefficients for the other direction are scaled by 8192 and give 10-bit values from 8-bit ones. Chroma is found from
+ the sum of a pair of pixels, so is shifted down by one more bit than luma. For 8-bit values both are shifted down by
+ two more bits. Each row of chroma coefficients sums to zero, so greys have no chroma.
+ */
+typedef struct HapCodecRGBToYCbCrCoefficients {
+    int16_t y_r, y_g, y_b;
+    int16_t cb_r, cb_g, cb_b;
+    int16_t cr_r, cr_g, cr_b;
+} HapCodecRGBToYCbCrCoefficients;
+
+static const HapCodecRGBToYCbCrCoefficients kHapCodecRGBToYCbCr[2] = {
+    // ITU-R BT.601
+    { 8414, 16519, 3208, -4857, -9535, 14392, 14392, -12051, -2341 },
+    // ITU-R BT.709
+    { 5983, 20127, 2032, -3298, -11094, 14392, 14392, -13072, -1320 }
+};
+
+// The luma and chroma offsets and rounding for a shift of 13 + extra bits for luma and 14 + extra bits for chroma
+#define HapCodecYCbCrLumaBias(extra) ((64 << 13) + (1 << (12 + (extra))))
+#define HapCodecYCbCrChromaBias(extra) ((512 << 14) + (1 << (13 + (extra))))
+
+// Converts a pair of pixels at p0 and p1, with red at offset r and blue at offset b
+static void HapCodecYCbCrPairFromRGBA(const uint8_t *p0, const uint8_t *p1, unsigned int r, unsigned int b, const HapCodecRGBToYCbCrCoefficients *k, unsigned int extra, int *y0, int *y1, int *cb, int *cr)
+{
+    int r_sum = p0[r] + p1[r];
+    int g_sum = p0[1] + p1[1];
+    int b_sum = p0[b] + p1[b];
+    *y0 = ((p0[r] * k->y_r) + (p0[1] * k->y_g) + (p0[b] * k->y_b) + HapCodecYCbCrLumaBias(extra)) >> (13 + extra);
+    *y1 = ((p1[r] * k->y_r) + (p1[1] * k->y_g) + (p1[b] * k->y_b) + HapCodecYCbCrLumaBias(extra)) >> (13 + extra);
+    *cb = ((r_sum * k->cb_r) + (g_sum * k->cb_g) + (b_sum * k->cb_b) + HapCodecYCbCrChromaBias(extra)) >> (14 + extra);
+    *cr = ((r_sum * k->cr_r) + (g_sum * k->cr_g) + (b_sum * k->cr_b) + HapCodecYCbCrChromaBias(extra)) >> (14 + extra);
+}
+
+static HAP_INLINE __m128i HapCodecYCbCrWeights(int16_t a, int16_t b)
+{
+    return _mm_set1_epi32((int)((uint16_t)a | ((uint32_t)(uint16_t)b << 16)));
+}
+
+/*
+ Eight pixels as HapCodecYCbCrPairFromRGBA(). *y receives the eight lumas and *c the chroma of each pair as Cb, Cr,
+ the order of 2vuy.
+ */
+static HAP_INLINE void HapCodecYCbCrPixelsFromRGBASSE2(const uint8_t *src, int bgra, const HapCodecRGBToYCbCrCoefficients *k, unsigned int extra, __m128i *y, __m128i *c)
+{
+    const __m128i low_bytes = _mm_set1_epi16(0xFF);
+    const __m128i luma_bias = _mm_set1_epi32(HapCodecYCbCrLumaBias(extra));
+    const __m128i chroma_bias = _mm_set1_epi32(HapCodecYCbCrChromaBias(extra));
+    const __m128i luma_shift = _mm_cvtsi32_si128(13 + extra);
+    const __m128i chroma_shift = _mm_cvtsi32_si128(14 + extra);
+    // Red and blue share 16-bit lanes, as do green and alpha, which is given no weight
+    const __m128i y_rb = (bgra ? HapCodecYCbCrWeights(k->y_b, k->y_r) : HapCodecYCbCrWeights(k->y_r, k->y_b));
+    const __m128i cb_rb = (bgra ? HapCodecYCbCrWeights(k->cb_b, k->cb_r) : HapCodecYCbCrWeights(k->cb_r, k->cb_b));
+    const __m128i cr_rb = (bgra ? HapCodecYCbCrWeights(k->cr_b, k->cr_r) : HapCodecYCbCrWeights(k->cr_r, k->cr_b));
+    const __m128i y_ga = HapCodecYCbCrWeights(k->y_g, 0);
+    const __m128i cb_ga = HapCodecYCbCrWeights(k->cb_g, 0);
+    const __m128i cr_ga = HapCodecYCbCrWeights(k->cr_g, 0);
+    __m128i luma[2], chroma[2];
+    int i;
+
+    for (i = 0; i < 2; i++)
+    {
+        __m128i pixels = _mm_loadu_si128((const __m128i *)(src + (i * 16)));
+        __m128i rb = _mm_and_si128(pixels, low_bytes);
+        __m128i ga = _mm_srli_epi16(pixels, 8);
+        // The sums of each pair of pixels are left in the first of them
+        __m128i rb_sum = _mm_add_epi16(rb, _mm_srli_epi64(rb, 32));
+        __m128i ga_sum = _mm_add_epi16(ga, _mm_srli_epi64(ga, 32));
+        __m128i cb, cr;
+
+        luma[i] = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rb, y_rb), _mm_madd_epi16(ga, y_ga)), luma_bias), luma_shift);
+        cb = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rb_sum, cb_rb), _mm_madd_epi16(ga_sum, cb_ga)), chroma_bias), chroma_shift);
+        cr = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(_mm_madd_epi16(rb_sum, cr_rb), _mm_madd_epi16(ga_sum, cr_ga)), chroma_bias), chroma_shift);
+        // Cb and Cr of the two pairs, from the first and third 32-bit lanes, in the low 64 bits
+        chroma[i] = _mm_shuffle_epi32(_mm_or_si128(cb, _mm_slli_epi32(cr, 16)), _MM_SHUFFLE(3, 1, 2, 0));
+    }
+    *y = _mm_packs_epi32(luma[0], luma[1]);
+    *c = _mm_unpacklo_epi64(chroma[0], chroma[1]);
+}
+
+void HapCodecYCbCrRowFromRGBA(const uint8_t *src, int bgra, unsigned long first, unsigned long count, uint8_t *dst, unsigned int pixel_format, int matrix)
+{
+    const HapCodecRGBToYCbCrCoefficients *k = &kHapCodecRGBToYCbCr[matrix == HapCodecYCbCrMatrix_ITU_R_709 ? 1 : 0];
+    unsigned int r = (bgra ? 2 : 0);
+    unsigned int b = (bgra ? 0 : 2);
+    unsigned long i = 0;
+
+    if (count == 0)
+        return;
+
+    if (pixel_format == kHapCVPixelFormat_2vuy)
+    {
+        dst += first * 2;
+        for (; count - i >= 8; i += 8)
+        {
+            __m128i y, c;
+            HapCodecYCbCrPixelsFromRGBASSE2(src + (i * 4), bgra, k, 2, &y, &c);
+            _mm_storeu_si128((__m128i *)(dst + (i * 2)), _mm_or_si128(c, _mm_slli_epi16(y, 8)));
+        }
+        for (; i < count; i += 2)
+        {
+            const uint8_t *p0 = src + (i * 4);
+            const uint8_t *p1 = (i + 1 < count ? p0 + 4 : p0);
+            int y0, y1, cb, cr;
+            HapCodecYCbCrPairFromRGBA(p0, p1, r, b, k, 2, &y0, &y1, &cb, &cr);
+            dst[(i * 2) + 0] = (uint8_t)cb;
+            dst[(i * 2) + 1] = (uint8_t)y0;
+            dst[(i * 2) + 2] = (uint8_t)cr;
+            dst[(i * 2) + 3] = (uint8_t)y1;
+        }
+    }
+    else if (pixel_format == kHapCVPixelFormat_v210)
+    {
+        dst += (first / 6) * 16;
+        while (i < count)
+        {
+            // Convert a batch of pixels eight at a time, then pack them six at a time
+            HAP_ALIGN_16 int16_t y[kHapCodecYCbCrV210BatchLength];
+            HAP_ALIGN_16 int16_t c[kHapCodecYCbCrV210BatchLength];
+            unsigned long batch = count - i < kHapCodecYCbCrV210BatchLength ? count - i : kHapCodecYCbCrV210BatchLength;
+            unsigned long padded = ((batch + 5) / 6) * 6;
+            unsigned long j;
+
+            for (j = 0; batch - j >= 8; j += 8)
+            {
+                __m128i y8, c8;
+                HapCodecYCbCrPixelsFromRGBASSE2(src + ((i + j) * 4), bgra, k, 0, &y8, &c8);
+                _mm_store_si128((__m128i *)(y + j), y8);
+                _mm_store_si128((__m128i *)(c + j), c8);
+            }
+            for (; j < batch; j += 2)
+            {
+                const uint8_t *p0 = src + ((i + j) * 4);
+                const uint8_t *p1 = (j + 1 < batch ? p0 + 4 : p0);
+                int y0, y1, cb, cr;
+                HapCodecYCbCrPairFromRGBA(p0, p1, r, b, k, 0, &y0, &y1, &cb, &cr);
+                y[j] = (int16_t)y0;
+                y[j + 1] = (int16_t)y1;
+                c[j] = (int16_t)cb;
+                c[j + 1] = (int16_t)cr;
+            }
+            for (j = (batch + 1) & ~1UL; j < padded; j += 2)
+            {
+                y[j] = y[j + 1] = y[batch - 1];
+                c[j] = c[(batch - 1) & ~1UL];
+                c[j + 1] = c[((batch - 1) & ~1UL) + 1];
+            }
+
+            for (j = 0; j < padded; j += 6)
+            {
+                const int16_t *gy = y + j;
+                const int16_t *gc = c + j;
+                // SSE2 means a little-endian host
+                __m128i words = _mm_setr_epi32((int)((uint32_t)gc[0] | ((uint32_t)gy[0] << 10) | ((uint32_t)gc[1] << 20)),
+                                               (int)((uint32_t)gy[1] | ((uint32_t)gc[2] << 10) | ((uint32_t)gy[2] << 20)),
+                                               (int)((uint32_t)gc[3] | ((uint32_t)gy[3] << 10) | ((uint32_t)gc[4] << 20)),
+                                               (int)((uint32_t)gy[4] | ((uint32_t)gc[5] << 10) | ((uint32_t)gy[5] << 20)));
+                _mm_storeu_si128((__m128i *)dst, words);
+                dst += 16;
+            }
+            i += batch;
+        }
+    }
+}
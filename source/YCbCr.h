@@ -0,0 +1,84 @@
+/*
+ YCbCr.h
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HapCodec_YCbCr_h
+#define HapCodec_YCbCr_h
+
+/*
+ Avoid a conflict with the QuickTime SDK and MSVC's non-standard stdint.h
+*/
+#if !defined(_STDINT) && !defined(_STDINT_H)
+#include <stdint.h>
+#endif
+#include <stddef.h>
+#include "PixelFormats.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ Video-range 4:2:2 Y'CbCr, kHapCVPixelFormat_2vuy or kHapCVPixelFormat_v210, to and from 8-bit RGBA.
+ */
+
+enum HapCodecYCbCrMatrix {
+    HapCodecYCbCrMatrix_ITU_R_601 = 0,
+    HapCodecYCbCrMatrix_ITU_R_709
+};
+
+/*
+ Y'CbCr carries no record of its matrix through the codec core, so the matrix follows from the frame size, as
+ is usual for untagged video: ITU-R BT.709 for HD, ITU-R BT.601 otherwise.
+ */
+#define HapCodecYCbCrMatrixForWidth(width) ((width) >= 1280 ? HapCodecYCbCrMatrix_ITU_R_709 : HapCodecYCbCrMatrix_ITU_R_601)
+
+#define HapCodecIsYCbCrPixelFormat(fmt) ((fmt) == kHapCVPixelFormat_2vuy || (fmt) == kHapCVPixelFormat_v210)
+
+/*
+ Returns the fewest bytes a row of width pixels of a Y'CbCr format occupies.
+ */
+size_t HapCodecYCbCrBytesPerRow(unsigned int pixel_format, unsigned long width);
+
+/*
+ Converts count pixels of a row of Y'CbCr, starting at pixel first, to RGBA at dst. Alpha is 255. Each pair of
+ pixels shares the chroma sampled with the first of them.
+ */
+void HapCodecYCbCrRowToRGBA(const uint8_t *src, unsigned int pixel_format, unsigned long first, unsigned long count, uint8_t *dst, int matrix);
+
+/*
+ Converts count pixels of RGBA, or BGRA if bgra is non-zero, at src to a row of Y'CbCr at dst, starting at pixel
+ first, which must begin a pair of pixels for kHapCVPixelFormat_2vuy or a group of six for kHapCVPixelFormat_v210.
+ Alpha is ignored. Each pair of pixels takes the mean of their chroma. A final incomplete pair or group is completed
+ by repeating the last pixel.
+ */
+void HapCodecYCbCrRowFromRGBA(const uint8_t *src, int bgra, unsigned long first, unsigned long count, uint8_t *dst, unsigned int pixel_format, int matrix);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
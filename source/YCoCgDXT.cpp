@@ -70,6 +70,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "YCoCgDXT.h"
+#include "YCoCgDXTSIMD.h"
+#include "DXTBlocks.h"
+#include "YCbCr.h"
 #include <string.h>
 #include <stdlib.h>
 
@@ -127,7 +130,7 @@ typedef unsigned int    dword;
 
 #define NVIDIA_G7X_HARDWARE_BUG_FIX     // keep the colors sorted as: max, min
 
-#if defined(__LITTLE_ENDIAN__) || defined(_WIN32)
+#if defined(__LITTLE_ENDIAN__) || defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
 #define EA_SYSTEM_LITTLE_ENDIAN
 #endif
 
@@ -187,6 +190,23 @@ static void ExtractBlock( const byte *inPtr, const int stride, const int widthRe
     }
 }
 
+// Hap: converts a block of RGBA or BGRA texels to CoCg_Y in place, with the same arithmetic as ConvertRGBAToCoCgAY8888()
+static void ConvertBlockToCoCg_Y( byte *colorBlock, const int input ) {
+    const int r = ( input == HapYCoCgDXT5Input_BGRA ) ? 2 : 0;
+    const int b = 2 - r;
+    
+    for ( int i = 0; i < 16; i++ ) {
+        int R = colorBlock[i*4+r];
+        int G = colorBlock[i*4+1];
+        int B = colorBlock[i*4+b];
+        int A = colorBlock[i*4+3];
+        colorBlock[i*4+0] = ( 2 * R - 2 * B + 512 ) / 4;
+        colorBlock[i*4+1] = ( 2 * G - R - B + 512 ) / 4;
+        colorBlock[i*4+2] = A;
+        colorBlock[i*4+3] = ( R + 2 * G + B ) / 4;
+    }
+}
+
 static void GetMinMaxYCoCg( byte *colorBlock, byte *minColor, byte *maxColor ) {
     minColor[0] = minColor[1] = minColor[2] = minColor[3] = 255;
     maxColor[0] = maxColor[1] = maxColor[2] = maxColor[3] = 0;
@@ -413,6 +433,132 @@ static void EmitColorIndices( const byte *colorBlock, const byte *minColor, cons
     EmitUInt( result, outData );
 }
 
+// Hap: compresses one block of CoCg_Y texels, which are scaled in place
+static void CompressYCoCgDXT5Block( byte *block, byte **outData ) {
+    byte minColor[4];
+    byte maxColor[4];
+    
+    // A simple min max extract for each color channel including alpha             
+    GetMinMaxYCoCg( block, minColor, maxColor );
+    ScaleYCoCg( block, minColor, maxColor );    // Sets the scale in the min[2] and max[2] offset
+    InsetYCoCgBBox( minColor, maxColor );
+    SelectYCoCgDiagonal( block, minColor, maxColor );
+    
+    EmitByte( maxColor[3], outData );    // Note: the luma is stored in the alpha channel
+    EmitByte( minColor[3], outData );
+    
+    EmitAlphaIndices( block, minColor[3], maxColor[3], outData );
+    
+    EmitUShort( ColorTo565( maxColor ), outData );
+    EmitUShort( ColorTo565( minColor ), outData );
+    
+    EmitColorIndices( block, minColor, maxColor, outData );
+}
+
+// Hap: the vector implementation for whole blocks, or NULL if none is available
+typedef void (*CompressYCoCgDXT5BlocksFunction)( const byte *, byte *, int, int, int );
+
+static CompressYCoCgDXT5BlocksFunction GetCompressYCoCgDXT5Blocks( void ) {
+    if ( HapCodecHasAVX2() ) {
+        return CompressYCoCgDXT5BlocksAVX2;
+    }
+    else if ( HapCodecHasSSE41() ) {
+        return CompressYCoCgDXT5BlocksSSE41;
+    }
+    return NULL;
+}
+
+// Hap: compresses CoCg_Y, or RGBA or BGRA converting each block as it goes to avoid a separate conversion pass
+static int CompressYCoCgDXT5Input( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride, const int input ) {
+    
+    int outputBytes =0;
+    
+    byte block[64];
+    
+    byte *outData = outBuf;
+    
+    int blockLineSize = stride * 4;  // 4 lines per loop
+    
+    // Hap: use a vector implementation for whole blocks where one is available
+    CompressYCoCgDXT5BlocksFunction compressBlocks = GetCompressYCoCgDXT5Blocks();
+    
+    for ( int j = 0; j < height; j += 4, inBuf +=blockLineSize ) {
+        int heightRemain = height - j;    
+        int i = 0;
+        if ( compressBlocks != NULL && heightRemain >= 4 ) {
+            int blockCount = width / 4;
+            compressBlocks( inBuf, outData, blockCount, stride, input );
+            outData += blockCount * 16;
+            i = blockCount * 4;
+        }
+        for ( ; i < width; i += 4 ) {
+            
+            // Note: Modified from orignal source so that it can handle the edge blending better with non aligned 4x textures
+            int widthRemain = width - i;
+            if ((heightRemain < 4) || (widthRemain < 4) ) {
+                ExtractBlock( inBuf + i * 4, stride, widthRemain, heightRemain,  block );  
+            }
+            else {
+                ExtractBlock( inBuf + i * 4, stride, block );
+            }
+            if ( input != HapYCoCgDXT5Input_CoCg_Y ) {
+                ConvertBlockToCoCg_Y( block, input );
+            }
+            CompressYCoCgDXT5Block( block, &outData );
+        }
+    }
+    
+    outputBytes = (int)(outData - outBuf);
+    
+    return outputBytes;
+}
+
+// Hap: the number of blocks converted from Y'CbCr at a time, so the RGBA they pass through stays in the cache
+#define YCBCR_STRIP_BLOCKS      64
+
+extern "C" int CompressYCbCrToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride, const unsigned int pixelFormat, const int matrix ) {
+    
+    byte strip[4 * YCBCR_STRIP_BLOCKS * 4 * 4];
+    const int stripStride = YCBCR_STRIP_BLOCKS * 4 * 4;
+    byte block[64];
+    
+    byte *outData = outBuf;
+    
+    CompressYCoCgDXT5BlocksFunction compressBlocks = GetCompressYCoCgDXT5Blocks();
+    
+    for ( int j = 0; j < height; j += 4 ) {
+        int heightRemain = height - j;
+        for ( int i = 0; i < width; i += YCBCR_STRIP_BLOCKS * 4 ) {
+            int count = width - i < YCBCR_STRIP_BLOCKS * 4 ? width - i : YCBCR_STRIP_BLOCKS * 4;
+            int blockCount = ( count + 3 ) / 4;
+            
+            // Convert to RGBA, replicating the last row and column as ExtractBlock() does at the edges
+            for ( int y = 0; y < 4; y++ ) {
+                byte *row = strip + y * stripStride;
+                const byte *src = inBuf + ( j + ( y < heightRemain ? y : heightRemain - 1 ) ) * stride;
+                HapCodecYCbCrRowToRGBA( src, pixelFormat, i, count, row, matrix );
+                for ( int x = count; x < blockCount * 4; x++ ) {
+                    memcpy( row + x * 4, row + ( count - 1 ) * 4, 4 );
+                }
+            }
+            
+            if ( compressBlocks != NULL ) {
+                compressBlocks( strip, outData, blockCount, stripStride, HapYCoCgDXT5Input_RGBA );
+                outData += blockCount * 16;
+            }
+            else {
+                for ( int b = 0; b < blockCount; b++ ) {
+                    ExtractBlock( strip + b * 16, stripStride, block );
+                    ConvertBlockToCoCg_Y( block, HapYCoCgDXT5Input_RGBA );
+                    CompressYCoCgDXT5Block( block, &outData );
+                }
+            }
+        }
+    }
+    
+    return (int)(outData - outBuf);
+}
+
 /*F*************************************************************************************************/
 /*!
  \Function    CompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
@@ -452,50 +598,15 @@ static void EmitColorIndices( const byte *colorBlock, const byte *minColor, cons
  */
 /*************************************************************************************************F*/
 extern "C" int CompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride) {
-    
-    int outputBytes =0;
-    
-    byte block[64];
-    byte minColor[4];
-    byte maxColor[4];
-    
-    byte *outData = outBuf;
-    
-    int blockLineSize = stride * 4;  // 4 lines per loop
-    
-    for ( int j = 0; j < height; j += 4, inBuf +=blockLineSize ) {
-        int heightRemain = height - j;    
-        for ( int i = 0; i < width; i += 4 ) {
-            
-            // Note: Modified from orignal source so that it can handle the edge blending better with non aligned 4x textures
-            int widthRemain = width - i;
-            if ((heightRemain < 4) || (widthRemain < 4) ) {
-                ExtractBlock( inBuf + i * 4, stride, widthRemain, heightRemain,  block );  
-            }
-            else {
-                ExtractBlock( inBuf + i * 4, stride, block );
-            }
-            // A simple min max extract for each color channel including alpha             
-            GetMinMaxYCoCg( block, minColor, maxColor );
-            ScaleYCoCg( block, minColor, maxColor );    // Sets the scale in the min[2] and max[2] offset
-            InsetYCoCgBBox( minColor, maxColor );
-            SelectYCoCgDiagonal( block, minColor, maxColor );
-            
-            EmitByte( maxColor[3], &outData );    // Note: the luma is stored in the alpha channel
-            EmitByte( minColor[3], &outData );
-            
-            EmitAlphaIndices( block, minColor[3], maxColor[3], &outData );
-            
-            EmitUShort( ColorTo565( maxColor ), &outData );
-            EmitUShort( ColorTo565( minColor ), &outData );
-            
-            EmitColorIndices( block, minColor, maxColor, &outData );
-        }
-    }
-    
-    outputBytes = (int)(outData - outBuf);
-    
-    return outputBytes;
+    return CompressYCoCgDXT5Input( inBuf, outBuf, width, height, stride, HapYCoCgDXT5Input_CoCg_Y );
+}
+
+extern "C" int CompressRGBAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride) {
+    return CompressYCoCgDXT5Input( inBuf, outBuf, width, height, stride, HapYCoCgDXT5Input_RGBA );
+}
+
+extern "C" int CompressBGRAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride) {
+    return CompressYCoCgDXT5Input( inBuf, outBuf, width, height, stride, HapYCoCgDXT5Input_BGRA );
 }
 
 
@@ -139,6 +139,21 @@ typedef unsigned char   byte;
 /*************************************************************************************************F*/
 int CompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride);
 
+/*
+ Hap: as CompressYCoCgDXT5() but taking RGBA or BGRA input, which is converted to YCoCg a block at a time
+ as it is compressed. The result is the same as converting with ConvertRGB_ToCoCg_Y8888() or
+ ConvertBGR_ToCoCg_Y8888() first.
+ */
+int CompressRGBAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride);
+int CompressBGRAToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height , const int stride);
+
+/*
+ Hap: as CompressYCoCgDXT5() but taking kHapCVPixelFormat_2vuy or kHapCVPixelFormat_v210 input. A strip of blocks
+ at a time is converted to RGBA with HapCodecYCbCrRowToRGBA() using matrix, a HapCodecYCbCrMatrix, and compressed
+ as CompressRGBAToYCoCgDXT5() would.
+ */
+int CompressYCbCrToYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride, const unsigned int pixelFormat, const int matrix );
+
 /*F*************************************************************************************************/
 /*!
  \Function    DeCompressYCoCgDXT5( const byte *inBuf, byte *outBuf, const int width, const int height, const int stride ) 
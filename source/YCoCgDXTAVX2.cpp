@@ -0,0 +1,275 @@
+/*
+ YCoCgDXTAVX2.cpp
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "YCoCgDXTSIMD.h"
+#include <immintrin.h>
+
+/*
+ As YCoCgDXTSSE41.cpp, but compressing two neighbouring blocks at a time, one in each 128-bit lane. Every
+ shuffle and unpack used works within lanes, so the blocks never mix.
+ */
+
+static HAP_INLINE __m256i HapYCoCgDXT5Lanes(__m128i a, __m128i b)
+{
+    return _mm256_inserti128_si256(_mm256_castsi128_si256(a), b, 1);
+}
+
+static HAP_INLINE __m256i HapYCoCgDXT5Lanes8(int a, int b)
+{
+    return HapYCoCgDXT5Lanes(_mm_set1_epi8((char)a), _mm_set1_epi8((char)b));
+}
+
+static HAP_INLINE __m256i HapYCoCgDXT5Lanes16(short a, short b)
+{
+    return HapYCoCgDXT5Lanes(_mm_set1_epi16(a), _mm_set1_epi16(b));
+}
+
+static HAP_INLINE __m256i HapYCoCgDXT5Distance(__m256i c0, __m256i c1, const short *paletteA, const short *paletteB)
+{
+    return _mm256_add_epi16(_mm256_abs_epi16(_mm256_sub_epi16(HapYCoCgDXT5Lanes16(paletteA[0], paletteB[0]), c0)),
+                            _mm256_abs_epi16(_mm256_sub_epi16(HapYCoCgDXT5Lanes16(paletteA[1], paletteB[1]), c1)));
+}
+
+static HAP_INLINE unsigned long long HapYCoCgDXT5AlphaIndices(__m128i index)
+{
+    return (unsigned long long)(unsigned int)_mm_cvtsi128_si32(index)
+         | ((unsigned long long)(unsigned int)_mm_extract_epi32(index, 1) << 12)
+         | ((unsigned long long)(unsigned int)_mm_extract_epi32(index, 2) << 24)
+         | ((unsigned long long)(unsigned int)_mm_extract_epi32(index, 3) << 36);
+}
+
+static HAP_INLINE void HapYCoCgDXT5EmitColorIndices(unsigned int colorIndices, byte *outData)
+{
+    outData[12] = colorIndices & 255;
+    outData[13] = (colorIndices >> 8) & 255;
+    outData[14] = (colorIndices >> 16) & 255;
+    outData[15] = colorIndices >> 24;
+}
+
+static HAP_INLINE __m256i HapYCoCgDXT5FloorAverage(__m256i a, __m256i b)
+{
+    return _mm256_sub_epi8(_mm256_avg_epu8(a, b), _mm256_and_si256(_mm256_xor_si256(a, b), _mm256_set1_epi8(1)));
+}
+
+// Reads the Co, Cg and Y results of HapYCoCgDXT5Min() or HapYCoCgDXT5Max() from one lane
+static HAP_INLINE unsigned int HapYCoCgDXT5Extremes(__m128i c, __m128i y)
+{
+    return ((unsigned int)_mm_cvtsi128_si32(c) & 0xFF) | (((unsigned int)_mm_extract_epi8(c, 8)) << 8) | ((unsigned int)_mm_cvtsi128_si32(y) << 24);
+}
+
+static HAP_INLINE void HapYCoCgDXT5Min(__m256i co, __m256i cg, __m256i y, unsigned int *a, unsigned int *b)
+{
+    __m256i c = _mm256_min_epu8(_mm256_unpacklo_epi64(co, cg), _mm256_unpackhi_epi64(co, cg));
+    c = _mm256_min_epu8(c, _mm256_srli_epi64(c, 32));
+    c = _mm256_min_epu8(c, _mm256_srli_epi64(c, 16));
+    c = _mm256_min_epu8(c, _mm256_srli_epi64(c, 8));
+    y = _mm256_min_epu8(y, _mm256_srli_si256(y, 8));
+    y = _mm256_min_epu8(y, _mm256_srli_si256(y, 4));
+    y = _mm256_min_epu8(y, _mm256_srli_si256(y, 2));
+    y = _mm256_min_epu8(y, _mm256_srli_si256(y, 1));
+    *a = HapYCoCgDXT5Extremes(_mm256_castsi256_si128(c), _mm256_castsi256_si128(y));
+    *b = HapYCoCgDXT5Extremes(_mm256_extracti128_si256(c, 1), _mm256_extracti128_si256(y, 1));
+}
+
+static HAP_INLINE void HapYCoCgDXT5Max(__m256i co, __m256i cg, __m256i y, unsigned int *a, unsigned int *b)
+{
+    __m256i c = _mm256_max_epu8(_mm256_unpacklo_epi64(co, cg), _mm256_unpackhi_epi64(co, cg));
+    c = _mm256_max_epu8(c, _mm256_srli_epi64(c, 32));
+    c = _mm256_max_epu8(c, _mm256_srli_epi64(c, 16));
+    c = _mm256_max_epu8(c, _mm256_srli_epi64(c, 8));
+    y = _mm256_max_epu8(y, _mm256_srli_si256(y, 8));
+    y = _mm256_max_epu8(y, _mm256_srli_si256(y, 4));
+    y = _mm256_max_epu8(y, _mm256_srli_si256(y, 2));
+    y = _mm256_max_epu8(y, _mm256_srli_si256(y, 1));
+    *a = HapYCoCgDXT5Extremes(_mm256_castsi256_si128(c), _mm256_castsi256_si128(y));
+    *b = HapYCoCgDXT5Extremes(_mm256_extracti128_si256(c, 1), _mm256_extracti128_si256(y, 1));
+}
+
+template <int Input>
+static HAP_INLINE void HapYCoCgDXT5CompressBlockPairAVX2(const byte *inBuf, byte *outData, int stride)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i planar = _mm256_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15,
+                                            0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m256i bias = _mm256_set1_epi8((char)0x80);
+    const __m256i one = _mm256_set1_epi8(1);
+    
+    __m256i r0 = _mm256_loadu_si256((const __m256i *)(inBuf));
+    __m256i r1 = _mm256_loadu_si256((const __m256i *)(inBuf + stride));
+    __m256i r2 = _mm256_loadu_si256((const __m256i *)(inBuf + stride * 2));
+    __m256i r3 = _mm256_loadu_si256((const __m256i *)(inBuf + stride * 3));
+    
+    // Transpose to one register per channel
+    r0 = _mm256_shuffle_epi8(r0, planar);
+    r1 = _mm256_shuffle_epi8(r1, planar);
+    r2 = _mm256_shuffle_epi8(r2, planar);
+    r3 = _mm256_shuffle_epi8(r3, planar);
+    __m256i t0 = _mm256_unpacklo_epi32(r0, r1);
+    __m256i t1 = _mm256_unpacklo_epi32(r2, r3);
+    __m256i t2 = _mm256_unpackhi_epi32(r0, r1);
+    __m256i t3 = _mm256_unpackhi_epi32(r2, r3);
+    __m256i p0 = _mm256_unpacklo_epi64(t0, t1);
+    __m256i p1 = _mm256_unpackhi_epi64(t0, t1);
+    __m256i p2 = _mm256_unpacklo_epi64(t2, t3);
+    __m256i p3 = _mm256_unpackhi_epi64(t2, t3);
+    
+    __m256i co, cg, y;
+    if (Input == HapYCoCgDXT5Input_CoCg_Y)
+    {
+        co = p0;
+        cg = p1;
+        y = p3;
+    }
+    else
+    {
+        // See YCoCgDXTSSE41.cpp
+        const __m256i ones = _mm256_set1_epi8((char)0xFF);
+        __m256i r = Input == HapYCoCgDXT5Input_RGBA ? p0 : p2;
+        __m256i b = Input == HapYCoCgDXT5Input_RGBA ? p2 : p0;
+        co = _mm256_avg_epu8(r, _mm256_xor_si256(b, ones));
+        cg = _mm256_avg_epu8(p1, HapYCoCgDXT5FloorAverage(_mm256_xor_si256(r, ones), _mm256_xor_si256(b, ones)));
+        y = HapYCoCgDXT5FloorAverage(HapYCoCgDXT5FloorAverage(r, b), p1);
+    }
+    
+    // GetMinMaxYCoCg()
+    unsigned int minsA, minsB, maxsA, maxsB;
+    HapYCoCgDXT5Min(co, cg, y, &minsA, &minsB);
+    HapYCoCgDXT5Max(co, cg, y, &maxsA, &maxsB);
+    byte minColorA[4] = { (byte)minsA, (byte)(minsA >> 8), 255, (byte)(minsA >> 24) };
+    byte maxColorA[4] = { (byte)maxsA, (byte)(maxsA >> 8), 0, (byte)(maxsA >> 24) };
+    byte minColorB[4] = { (byte)minsB, (byte)(minsB >> 8), 255, (byte)(minsB >> 24) };
+    byte maxColorB[4] = { (byte)maxsB, (byte)(maxsB >> 8), 0, (byte)(maxsB >> 24) };
+    
+    // ScaleYCoCg(), choosing between the unscaled, doubled and quadrupled texels for each block
+    int scaleA = HapYCoCgDXT5ScaleEndpoints(minColorA, maxColorA);
+    int scaleB = HapYCoCgDXT5ScaleEndpoints(minColorB, maxColorB);
+    if (scaleA > 1 || scaleB > 1)
+    {
+        __m256i scale2 = HapYCoCgDXT5Lanes8(scaleA > 1 ? -1 : 0, scaleB > 1 ? -1 : 0);
+        __m256i scale4 = HapYCoCgDXT5Lanes8(scaleA > 2 ? -1 : 0, scaleB > 2 ? -1 : 0);
+        __m256i co2 = _mm256_add_epi8(co, co);
+        __m256i cg2 = _mm256_add_epi8(cg, cg);
+        __m256i co4 = _mm256_add_epi8(co2, co2);
+        __m256i cg4 = _mm256_add_epi8(cg2, cg2);
+        co = _mm256_blendv_epi8(co, _mm256_xor_si256(co2, bias), scale2);
+        cg = _mm256_blendv_epi8(cg, _mm256_xor_si256(cg2, bias), scale2);
+        co = _mm256_blendv_epi8(co, _mm256_xor_si256(co4, bias), scale4);
+        cg = _mm256_blendv_epi8(cg, _mm256_xor_si256(cg4, bias), scale4);
+    }
+    
+    HapYCoCgDXT5InsetEndpoints(minColorA, maxColorA);
+    HapYCoCgDXT5InsetEndpoints(minColorB, maxColorB);
+    
+    // SelectYCoCgDiagonal()
+    __m256i mid0 = HapYCoCgDXT5Lanes8(( (int) minColorA[0] + maxColorA[0] + 1 ) >> 1, ( (int) minColorB[0] + maxColorB[0] + 1 ) >> 1);
+    __m256i mid1 = HapYCoCgDXT5Lanes8(( (int) minColorA[1] + maxColorA[1] + 1 ) >> 1, ( (int) minColorB[1] + maxColorB[1] + 1 ) >> 1);
+    __m256i side = _mm256_xor_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(co, mid0), co), _mm256_cmpeq_epi8(_mm256_max_epu8(cg, mid1), cg));
+    unsigned int sides = (unsigned int)_mm256_movemask_epi8(side);
+    HapYCoCgDXT5SelectDiagonal(minColorA, maxColorA, HapYCoCgDXT5CountBits16(sides & 0xFFFF));
+    HapYCoCgDXT5SelectDiagonal(minColorB, maxColorB, HapYCoCgDXT5CountBits16(sides >> 16));
+    
+    // EmitAlphaIndices()
+    byte thresholdsA[7];
+    byte thresholdsB[7];
+    HapYCoCgDXT5AlphaThresholds(minColorA[3], maxColorA[3], thresholdsA);
+    HapYCoCgDXT5AlphaThresholds(minColorB[3], maxColorB[3], thresholdsB);
+    __m256i count = _mm256_cmpeq_epi8(_mm256_min_epu8(y, HapYCoCgDXT5Lanes8(thresholdsA[0], thresholdsB[0])), y);
+    for (int i = 1; i < 7; i++)
+    {
+        count = _mm256_add_epi8(count, _mm256_cmpeq_epi8(_mm256_min_epu8(y, HapYCoCgDXT5Lanes8(thresholdsA[i], thresholdsB[i])), y));
+    }
+    __m256i index = _mm256_and_si256(_mm256_sub_epi8(one, count), _mm256_set1_epi8(7));
+    index = _mm256_xor_si256(index, _mm256_and_si256(_mm256_cmpgt_epi8(_mm256_set1_epi8(2), index), one));
+    index = _mm256_madd_epi16(_mm256_maddubs_epi16(index, _mm256_set1_epi16(0x0801)), _mm256_set1_epi32(0x00400001));
+    
+    HapYCoCgDXT5EmitBlockHeader(minColorA, maxColorA, HapYCoCgDXT5AlphaIndices(_mm256_castsi256_si128(index)), outData);
+    HapYCoCgDXT5EmitBlockHeader(minColorB, maxColorB, HapYCoCgDXT5AlphaIndices(_mm256_extracti128_si256(index, 1)), outData + 16);
+    
+    // EmitColorIndices()
+    short paletteA[8];
+    short paletteB[8];
+    HapYCoCgDXT5ColorPalette(minColorA, maxColorA, paletteA);
+    HapYCoCgDXT5ColorPalette(minColorB, maxColorB, paletteB);
+    __m256i indices[2];
+    for (int half = 0; half < 2; half++)
+    {
+        __m256i c0 = half == 0 ? _mm256_unpacklo_epi8(co, zero) : _mm256_unpackhi_epi8(co, zero);
+        __m256i c1 = half == 0 ? _mm256_unpacklo_epi8(cg, zero) : _mm256_unpackhi_epi8(cg, zero);
+        __m256i d0 = HapYCoCgDXT5Distance(c0, c1, paletteA + 0, paletteB + 0);
+        __m256i d1 = HapYCoCgDXT5Distance(c0, c1, paletteA + 2, paletteB + 2);
+        __m256i d2 = HapYCoCgDXT5Distance(c0, c1, paletteA + 4, paletteB + 4);
+        __m256i d3 = HapYCoCgDXT5Distance(c0, c1, paletteA + 6, paletteB + 6);
+        
+        __m256i b0 = _mm256_cmpgt_epi16(d0, d3);
+        __m256i b1 = _mm256_cmpgt_epi16(d1, d2);
+        __m256i b2 = _mm256_cmpgt_epi16(d0, d2);
+        __m256i b3 = _mm256_cmpgt_epi16(d1, d3);
+        __m256i b4 = _mm256_cmpgt_epi16(d2, d3);
+        
+        __m256i x0 = _mm256_and_si256(b1, b2);
+        __m256i x1 = _mm256_and_si256(b0, b3);
+        __m256i x2 = _mm256_and_si256(b0, b4);
+        
+        indices[half] = _mm256_or_si256(_mm256_and_si256(x2, _mm256_set1_epi16(1)), _mm256_and_si256(_mm256_or_si256(x0, x1), _mm256_set1_epi16(2)));
+    }
+    index = _mm256_packs_epi16(indices[0], indices[1]);
+    index = _mm256_madd_epi16(_mm256_maddubs_epi16(index, _mm256_set1_epi16(0x0401)), _mm256_set1_epi32(0x00100001));
+    index = _mm256_packus_epi16(_mm256_packus_epi32(index, zero), zero);
+    
+    HapYCoCgDXT5EmitColorIndices((unsigned int)_mm_cvtsi128_si32(_mm256_castsi256_si128(index)), outData);
+    HapYCoCgDXT5EmitColorIndices((unsigned int)_mm_cvtsi128_si32(_mm256_extracti128_si256(index, 1)), outData + 16);
+}
+
+template <int Input>
+static void HapYCoCgDXT5CompressBlocksAVX2(const byte *inBuf, byte *outBuf, int blockCount, int stride)
+{
+    int i;
+    for (i = 0; i + 1 < blockCount; i += 2)
+    {
+        HapYCoCgDXT5CompressBlockPairAVX2<Input>(inBuf + i * 16, outBuf + i * 16, stride);
+    }
+    if (i < blockCount)
+    {
+        CompressYCoCgDXT5BlocksSSE41(inBuf + i * 16, outBuf + i * 16, 1, stride, Input);
+    }
+}
+
+void CompressYCoCgDXT5BlocksAVX2(const byte *inBuf, byte *outBuf, int blockCount, int stride, int input)
+{
+    switch (input)
+    {
+        case HapYCoCgDXT5Input_RGBA:
+            HapYCoCgDXT5CompressBlocksAVX2<HapYCoCgDXT5Input_RGBA>(inBuf, outBuf, blockCount, stride);
+            break;
+        case HapYCoCgDXT5Input_BGRA:
+            HapYCoCgDXT5CompressBlocksAVX2<HapYCoCgDXT5Input_BGRA>(inBuf, outBuf, blockCount, stride);
+            break;
+        default:
+            HapYCoCgDXT5CompressBlocksAVX2<HapYCoCgDXT5Input_CoCg_Y>(inBuf, outBuf, blockCount, stride);
+            break;
+    }
+}
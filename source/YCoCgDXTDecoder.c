@@ -0,0 +1,111 @@
+/*
+ YCoCgDXTDecoder.c
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "YCoCgDXTDecoder.h"
+#include "HapPlatform.h"
+#include "DXTBlocks.h"
+#include "DXTDecodeSIMD.h"
+#include "ParallelLoops.h"
+#include <stdint.h>
+
+// Bands of block rows are decoded in parallel
+#define kHapCodecYCoCgDXTDecodeMaxSliceCount 30U
+
+typedef struct HapCodecYCoCgDXTDecodeTask {
+    const uint8_t   *src;
+    uint8_t         *dst;
+    unsigned int    dst_pixel_format;
+    unsigned int    dst_bytes_per_row;
+    unsigned int    width;
+    unsigned int    height;
+    unsigned int    slice_height;
+    int             has_avx2;
+} HapCodecYCoCgDXTDecodeTask;
+
+void HapCodecYCoCgDXTDecodeBlockRow(const void *src,
+                                    void *dst,
+                                    unsigned int dst_pixel_format,
+                                    unsigned int dst_bytes_per_row,
+                                    unsigned int width,
+                                    unsigned int first_row,
+                                    int has_avx2)
+{
+    unsigned int block_count = (width + 3) / 4;
+    const uint8_t *src_block = (const uint8_t *)src + ((first_row / 4) * block_count * 16);
+    uint8_t *dst_base = (uint8_t *)dst + (dst_bytes_per_row * first_row);
+    int bgra = (dst_pixel_format == 'RGBA' ? 0 : 1);
+    if (has_avx2)
+    {
+        HapCodecYCoCgDXTDecodeBlocksAVX2(src_block, dst_base, dst_bytes_per_row, block_count, bgra);
+    }
+    else
+    {
+        HapCodecYCoCgDXTDecodeBlocksSSE2(src_block, dst_base, dst_bytes_per_row, block_count, bgra);
+    }
+}
+
+static void HapCodecYCoCgDXTDecodeSlice(void *p, unsigned int index)
+{
+    HapCodecYCoCgDXTDecodeTask *task = (HapCodecYCoCgDXTDecodeTask *)p;
+    unsigned int first_row = index * task->slice_height;
+    unsigned int last_row = first_row + task->slice_height;
+    unsigned int y;
+    if (last_row > task->height)
+    {
+        last_row = task->height;
+    }
+    for (y = first_row; y < last_row; y+= 4)
+    {
+        HapCodecYCoCgDXTDecodeBlockRow(task->src, task->dst, task->dst_pixel_format, task->dst_bytes_per_row, task->width, y, task->has_avx2);
+    }
+}
+
+void HapCodecYCoCgDXTDecode(const void *src,
+                            void *dst,
+                            unsigned int dst_pixel_format,
+                            unsigned int dst_bytes_per_row,
+                            unsigned int width,
+                            unsigned int height)
+{
+    HapCodecYCoCgDXTDecodeTask task;
+    unsigned int block_rows = (height + 3) / 4;
+    unsigned int slice_count = block_rows < kHapCodecYCoCgDXTDecodeMaxSliceCount ? block_rows : kHapCodecYCoCgDXTDecodeMaxSliceCount;
+    if (slice_count == 0)
+    {
+        return;
+    }
+    task.src = (const uint8_t *)src;
+    task.dst = (uint8_t *)dst;
+    task.dst_pixel_format = dst_pixel_format;
+    task.dst_bytes_per_row = dst_bytes_per_row;
+    task.width = width;
+    task.height = height;
+    task.slice_height = ((block_rows + slice_count - 1) / slice_count) * 4;
+    task.has_avx2 = HapCodecHasAVX2();
+    slice_count = (block_rows * 4 + task.slice_height - 1) / task.slice_height;
+    HapParallelFor(HapCodecYCoCgDXTDecodeSlice, &task, slice_count);
+}
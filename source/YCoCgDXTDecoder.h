@@ -0,0 +1,56 @@
+/*
+ YCoCgDXTDecoder.h
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HapCodec_YCoCgDXTDecoder_h
+#define HapCodec_YCoCgDXTDecoder_h
+
+#include "PixelFormats.h"
+
+/*
+ Decodes a YCoCg-DXT5 texture straight to RGBA or BGRA pixels, in parallel bands of block rows. CoCg is unscaled
+ and converted to RGB as each block is decoded, so no intermediate YCoCg image is made. Whole blocks are written.
+ */
+void HapCodecYCoCgDXTDecode(const void *src,
+                            void *dst,
+                            unsigned int dst_pixel_format,
+                            unsigned int dst_bytes_per_row,
+                            unsigned int width,
+                            unsigned int height);
+
+/*
+ Decodes the row of blocks which starts at pixel row first_row. has_avx2 is the result of HapCodecHasAVX2(), for
+ callers decoding many rows to check once.
+ */
+void HapCodecYCoCgDXTDecodeBlockRow(const void *src,
+                                    void *dst,
+                                    unsigned int dst_pixel_format,
+                                    unsigned int dst_bytes_per_row,
+                                    unsigned int width,
+                                    unsigned int first_row,
+                                    int has_avx2);
+
+#endif
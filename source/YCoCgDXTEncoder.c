@@ -28,6 +28,7 @@
 #include "YCoCgDXTEncoder.h"
 #include "YCoCgDXT.h"
 #include "PixelFormats.h"
+#include "YCbCr.h"
 #include "HapPlatform.h"
 #include <stdlib.h>
 
@@ -44,14 +45,38 @@ static int HapCodecYCoCgDXTEncoderEncode(HapCodecDXTEncoderRef encoder HAP_ATTR_
                                      unsigned int width,
                                      unsigned int height)
 {
-    if (src_pixel_format != kHapCVPixelFormat_CoCgXY) return 1;
-    CompressYCoCgDXT5((const byte *)src, (byte *)dst, width, height, src_bytes_per_row);
-    return 0;
+    switch (src_pixel_format) {
+        case kHapCVPixelFormat_CoCgXY:
+            CompressYCoCgDXT5((const byte *)src, (byte *)dst, width, height, src_bytes_per_row);
+            return 0;
+        case kHapCVPixelFormat_RGBA:
+            CompressRGBAToYCoCgDXT5((const byte *)src, (byte *)dst, width, height, src_bytes_per_row);
+            return 0;
+        case kHapCVPixelFormat_BGRA:
+            CompressBGRAToYCoCgDXT5((const byte *)src, (byte *)dst, width, height, src_bytes_per_row);
+            return 0;
+        case kHapCVPixelFormat_2vuy:
+        case kHapCVPixelFormat_v210:
+            CompressYCbCrToYCoCgDXT5((const byte *)src, (byte *)dst, width, height, src_bytes_per_row,
+                                     src_pixel_format, HapCodecYCbCrMatrixForWidth(width));
+            return 0;
+        default:
+            return 1;
+    }
 }
 
-static OSType HapCodecYCoCgDXTEncoderWantedPixelFormat(HapCodecDXTEncoderRef encoder HAP_ATTR_UNUSED, OSType sourceFormat HAP_ATTR_UNUSED)
+static OSType HapCodecYCoCgDXTEncoderWantedPixelFormat(HapCodecDXTEncoderRef encoder HAP_ATTR_UNUSED, OSType sourceFormat)
 {
-    return kHapCVPixelFormat_CoCgXY;
+    // RGB and Y'CbCr are converted to YCoCg block by block as they are encoded
+    switch (sourceFormat) {
+        case kHapCVPixelFormat_RGBA:
+        case kHapCVPixelFormat_BGRA:
+        case kHapCVPixelFormat_2vuy:
+        case kHapCVPixelFormat_v210:
+            return sourceFormat;
+        default:
+            return kHapCVPixelFormat_CoCgXY;
+    }
 }
 
 #if defined(DEBUG)
@@ -0,0 +1,181 @@
+/*
+ YCoCgDXTSIMD.h
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef HapCodec_YCoCgDXTSIMD_h
+#define HapCodec_YCoCgDXTSIMD_h
+
+#include "YCoCgDXT.h"
+#include "HapPlatform.h"
+
+/*
+ Vectorised versions of CompressYCoCgDXT5(), selected at runtime. They compress blockCount whole 4x4 blocks
+ from a run along one row of blocks, and produce the same output as the scalar code. input is a
+ HapYCoCgDXT5Input; RGBA and BGRA texels are converted to CoCg_Y in registers. Edges which don't fill
+ a whole block are left to the scalar code.
+
+ The per-block endpoint arithmetic below is shared by the vector implementations and follows YCoCgDXT.cpp
+ step for step, including its byte truncation.
+ */
+
+enum HapYCoCgDXT5Input {
+    HapYCoCgDXT5Input_CoCg_Y = 0,
+    HapYCoCgDXT5Input_RGBA,
+    HapYCoCgDXT5Input_BGRA
+};
+
+void CompressYCoCgDXT5BlocksSSE41(const byte *inBuf, byte *outBuf, int blockCount, int stride, int input);
+void CompressYCoCgDXT5BlocksAVX2(const byte *inBuf, byte *outBuf, int blockCount, int stride, int input);
+
+// The number of bits set in a 16-bit mask
+static HAP_INLINE int HapYCoCgDXT5CountBits16(unsigned int v)
+{
+    v = v - ((v >> 1) & 0x5555);
+    v = (v & 0x3333) + ((v >> 2) & 0x3333);
+    v = (v + (v >> 4)) & 0x0F0F;
+    return (v + (v >> 8)) & 0x1F;
+}
+
+// Applies ScaleYCoCg() to the block's endpoints, returning the scale to be applied to its texels
+static HAP_INLINE int HapYCoCgDXT5ScaleEndpoints(byte *minColor, byte *maxColor)
+{
+    int m0 = minColor[0] - 128;
+    int m1 = minColor[1] - 128;
+    int m2 = maxColor[0] - 128;
+    int m3 = maxColor[1] - 128;
+    
+    m0 = m0 >= 0 ? m0 : -m0;
+    m1 = m1 >= 0 ? m1 : -m1;
+    m2 = m2 >= 0 ? m2 : -m2;
+    m3 = m3 >= 0 ? m3 : -m3;
+    
+    if ( m1 > m0 ) m0 = m1;
+    if ( m3 > m2 ) m2 = m3;
+    if ( m2 > m0 ) m0 = m2;
+    
+    int scale = 1 + ( m0 <= 128 / 2 - 1 ? 1 : 0 ) + ( m0 <= 128 / 4 - 1 ? 2 : 0 );
+    
+    minColor[0] = ( minColor[0] - 128 ) * scale + 128;
+    minColor[1] = ( minColor[1] - 128 ) * scale + 128;
+    minColor[2] = ( scale - 1 ) << 3;
+    
+    maxColor[0] = ( maxColor[0] - 128 ) * scale + 128;
+    maxColor[1] = ( maxColor[1] - 128 ) * scale + 128;
+    maxColor[2] = ( scale - 1 ) << 3;
+    
+    return scale;
+}
+
+// InsetYCoCgBBox()
+static HAP_INLINE void HapYCoCgDXT5InsetEndpoints(byte *minColor, byte *maxColor)
+{
+    int inset0 = ( maxColor[0] - minColor[0] ) - ((1<<(4-1))-1);
+    int inset1 = ( maxColor[1] - minColor[1] ) - ((1<<(4-1))-1);
+    int inset3 = ( maxColor[3] - minColor[3] ) - ((1<<(5-1))-1);
+    
+    int mini0 = ( ( minColor[0] << 4 ) + inset0 ) >> 4;
+    int mini1 = ( ( minColor[1] << 4 ) + inset1 ) >> 4;
+    int mini3 = ( ( minColor[3] << 5 ) + inset3 ) >> 5;
+    
+    int maxi0 = ( ( maxColor[0] << 4 ) - inset0 ) >> 4;
+    int maxi1 = ( ( maxColor[1] << 4 ) - inset1 ) >> 4;
+    int maxi3 = ( ( maxColor[3] << 5 ) - inset3 ) >> 5;
+    
+    mini0 = ( mini0 >= 0 ) ? mini0 : 0;
+    mini1 = ( mini1 >= 0 ) ? mini1 : 0;
+    mini3 = ( mini3 >= 0 ) ? mini3 : 0;
+    
+    maxi0 = ( maxi0 <= 255 ) ? maxi0 : 255;
+    maxi1 = ( maxi1 <= 255 ) ? maxi1 : 255;
+    maxi3 = ( maxi3 <= 255 ) ? maxi3 : 255;
+    
+    minColor[0] = ( mini0 & 0xF8 ) | ( mini0 >> 5 );
+    minColor[1] = ( mini1 & 0xFC ) | ( mini1 >> 6 );
+    minColor[3] = mini3;
+    
+    maxColor[0] = ( maxi0 & 0xF8 ) | ( maxi0 >> 5 );
+    maxColor[1] = ( maxi1 & 0xFC ) | ( maxi1 >> 6 );
+    maxColor[3] = maxi3;
+}
+
+// SelectYCoCgDiagonal(), given the number of texels on the off-diagonal
+static HAP_INLINE void HapYCoCgDXT5SelectDiagonal(byte *minColor, byte *maxColor, int side)
+{
+    // NVIDIA_G7X_HARDWARE_BUG_FIX
+    if ( side > 8 && minColor[0] != maxColor[0] ) {
+        byte c = minColor[1];
+        minColor[1] = maxColor[1];
+        maxColor[1] = c;
+    }
+}
+
+// The thresholds used by EmitAlphaIndices()
+static HAP_INLINE void HapYCoCgDXT5AlphaThresholds(byte minAlpha, byte maxAlpha, byte *thresholds)
+{
+    byte mid = ( maxAlpha - minAlpha ) / ( 2 * 7 );
+    
+    thresholds[0] = minAlpha + mid;
+    thresholds[1] = ( 6 * maxAlpha + 1 * minAlpha ) / 7 + mid;
+    thresholds[2] = ( 5 * maxAlpha + 2 * minAlpha ) / 7 + mid;
+    thresholds[3] = ( 4 * maxAlpha + 3 * minAlpha ) / 7 + mid;
+    thresholds[4] = ( 3 * maxAlpha + 4 * minAlpha ) / 7 + mid;
+    thresholds[5] = ( 2 * maxAlpha + 5 * minAlpha ) / 7 + mid;
+    thresholds[6] = ( 1 * maxAlpha + 6 * minAlpha ) / 7 + mid;
+}
+
+// The Co and Cg of the four palette entries used by EmitColorIndices()
+static HAP_INLINE void HapYCoCgDXT5ColorPalette(const byte *minColor, const byte *maxColor, short *palette)
+{
+    palette[0] = ( maxColor[0] & 0xF8 ) | ( maxColor[0] >> 5 );
+    palette[1] = ( maxColor[1] & 0xFC ) | ( maxColor[1] >> 6 );
+    palette[2] = ( minColor[0] & 0xF8 ) | ( minColor[0] >> 5 );
+    palette[3] = ( minColor[1] & 0xFC ) | ( minColor[1] >> 6 );
+    palette[4] = ( 2 * palette[0] + 1 * palette[2] ) / 3;
+    palette[5] = ( 2 * palette[1] + 1 * palette[3] ) / 3;
+    palette[6] = ( 1 * palette[0] + 2 * palette[2] ) / 3;
+    palette[7] = ( 1 * palette[1] + 2 * palette[3] ) / 3;
+}
+
+// Writes the luma endpoints, the packed luma indices and the colour endpoints: everything up to the colour indices
+static HAP_INLINE void HapYCoCgDXT5EmitBlockHeader(const byte *minColor, const byte *maxColor, unsigned long long alphaIndices, byte *outData)
+{
+    int i;
+    unsigned int maxColor565 = ( ( maxColor[ 0 ] >> 3 ) << 11 ) | ( ( maxColor[ 1 ] >> 2 ) << 5 ) | ( maxColor[ 2 ] >> 3 );
+    unsigned int minColor565 = ( ( minColor[ 0 ] >> 3 ) << 11 ) | ( ( minColor[ 1 ] >> 2 ) << 5 ) | ( minColor[ 2 ] >> 3 );
+    
+    outData[0] = maxColor[3];
+    outData[1] = minColor[3];
+    for (i = 0; i < 6; i++)
+    {
+        outData[2 + i] = (byte)(alphaIndices >> (i * 8));
+    }
+    outData[8] = maxColor565 & 255;
+    outData[9] = maxColor565 >> 8;
+    outData[10] = minColor565 & 255;
+    outData[11] = minColor565 >> 8;
+}
+
+#endif
@@ -0,0 +1,226 @@
+/*
+ YCoCgDXTSSE41.cpp
+ Hap Codec
+
+ Copyright (c) 2012-2013, Tom Butterworth and Vidvox LLC. All rights reserved. 
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+ 
+ * Redistributions of source code must retain the above copyright
+ notice, this list of conditions and the following disclaimer.
+ 
+ * Redistributions in binary form must reproduce the above copyright
+ notice, this list of conditions and the following disclaimer in the
+ documentation and/or other materials provided with the distribution.
+ 
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDERS BE LIABLE FOR ANY
+ DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "YCoCgDXTSIMD.h"
+#include <smmintrin.h>
+
+/*
+ Each block is transposed so that its 16 Co, Cg and Y values each occupy one register (converting from RGB
+ first if needed), and the steps of CompressYCoCgDXT5() are then applied to all 16 texels at once.
+ */
+
+// (a + b) / 2 rounded down, where _mm_avg_epu8() rounds up
+static HAP_INLINE __m128i HapYCoCgDXT5FloorAverage(__m128i a, __m128i b)
+{
+    return _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+}
+
+// Reduces 16 texels of Co, Cg and Y to their minima, in bytes 0, 1 and 3 as GetMinMaxYCoCg() would
+static HAP_INLINE unsigned int HapYCoCgDXT5Min(__m128i co, __m128i cg, __m128i y)
+{
+    __m128i c = _mm_min_epu8(_mm_unpacklo_epi64(co, cg), _mm_unpackhi_epi64(co, cg));
+    c = _mm_min_epu8(c, _mm_srli_epi64(c, 32));
+    c = _mm_min_epu8(c, _mm_srli_epi64(c, 16));
+    c = _mm_min_epu8(c, _mm_srli_epi64(c, 8));
+    y = _mm_min_epu8(y, _mm_srli_si128(y, 8));
+    y = _mm_min_epu8(y, _mm_srli_si128(y, 4));
+    y = _mm_min_epu8(y, _mm_srli_si128(y, 2));
+    y = _mm_min_epu8(y, _mm_srli_si128(y, 1));
+    return ((unsigned int)_mm_cvtsi128_si32(c) & 0xFF) | (((unsigned int)_mm_extract_epi8(c, 8)) << 8) | ((unsigned int)_mm_cvtsi128_si32(y) << 24);
+}
+
+static HAP_INLINE unsigned int HapYCoCgDXT5Max(__m128i co, __m128i cg, __m128i y)
+{
+    __m128i c = _mm_max_epu8(_mm_unpacklo_epi64(co, cg), _mm_unpackhi_epi64(co, cg));
+    c = _mm_max_epu8(c, _mm_srli_epi64(c, 32));
+    c = _mm_max_epu8(c, _mm_srli_epi64(c, 16));
+    c = _mm_max_epu8(c, _mm_srli_epi64(c, 8));
+    y = _mm_max_epu8(y, _mm_srli_si128(y, 8));
+    y = _mm_max_epu8(y, _mm_srli_si128(y, 4));
+    y = _mm_max_epu8(y, _mm_srli_si128(y, 2));
+    y = _mm_max_epu8(y, _mm_srli_si128(y, 1));
+    return ((unsigned int)_mm_cvtsi128_si32(c) & 0xFF) | (((unsigned int)_mm_extract_epi8(c, 8)) << 8) | ((unsigned int)_mm_cvtsi128_si32(y) << 24);
+}
+
+template <int Input>
+static HAP_INLINE void HapYCoCgDXT5CompressBlockSSE41(const byte *inBuf, byte *outData, int stride)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i planar = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+    const __m128i bias = _mm_set1_epi8((char)0x80);
+    const __m128i one = _mm_set1_epi8(1);
+    
+    __m128i r0 = _mm_loadu_si128((const __m128i *)(inBuf));
+    __m128i r1 = _mm_loadu_si128((const __m128i *)(inBuf + stride));
+    __m128i r2 = _mm_loadu_si128((const __m128i *)(inBuf + stride * 2));
+    __m128i r3 = _mm_loadu_si128((const __m128i *)(inBuf + stride * 3));
+    
+    // Transpose to one register per channel, texels in the same order as the scalar code's block
+    r0 = _mm_shuffle_epi8(r0, planar);
+    r1 = _mm_shuffle_epi8(r1, planar);
+    r2 = _mm_shuffle_epi8(r2, planar);
+    r3 = _mm_shuffle_epi8(r3, planar);
+    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+    __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+    __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+    __m128i p0 = _mm_unpacklo_epi64(t0, t1);
+    __m128i p1 = _mm_unpackhi_epi64(t0, t1);
+    __m128i p2 = _mm_unpacklo_epi64(t2, t3);
+    __m128i p3 = _mm_unpackhi_epi64(t2, t3);
+    
+    __m128i co, cg, y;
+    if (Input == HapYCoCgDXT5Input_CoCg_Y)
+    {
+        co = p0;
+        cg = p1;
+        y = p3;
+    }
+    else
+    {
+        // ConvertRGBAToCoCgAY8888() in 8 bits:
+        // Co = (2R - 2B + 512) / 4 = avg(R, ~B)
+        // Cg = (2G - R - B + 512) / 4 = avg(G, floor_avg(~R, ~B))
+        // Y = (R + 2G + B) / 4 = floor_avg(floor_avg(R, B), G)
+        const __m128i ones = _mm_set1_epi8((char)0xFF);
+        __m128i r = Input == HapYCoCgDXT5Input_RGBA ? p0 : p2;
+        __m128i b = Input == HapYCoCgDXT5Input_RGBA ? p2 : p0;
+        co = _mm_avg_epu8(r, _mm_xor_si128(b, ones));
+        cg = _mm_avg_epu8(p1, HapYCoCgDXT5FloorAverage(_mm_xor_si128(r, ones), _mm_xor_si128(b, ones)));
+        y = HapYCoCgDXT5FloorAverage(HapYCoCgDXT5FloorAverage(r, b), p1);
+    }
+    
+    // GetMinMaxYCoCg()
+    unsigned int mins = HapYCoCgDXT5Min(co, cg, y);
+    unsigned int maxs = HapYCoCgDXT5Max(co, cg, y);
+    byte minColor[4] = { (byte)mins, (byte)(mins >> 8), 255, (byte)(mins >> 24) };
+    byte maxColor[4] = { (byte)maxs, (byte)(maxs >> 8), 0, (byte)(maxs >> 24) };
+    
+    // ScaleYCoCg(): (c - 128) * scale + 128 is c * scale + 128 in 8 bits for scales of 2 and 4
+    int scale = HapYCoCgDXT5ScaleEndpoints(minColor, maxColor);
+    if (scale > 1)
+    {
+        co = _mm_add_epi8(co, co);
+        cg = _mm_add_epi8(cg, cg);
+        if (scale > 2)
+        {
+            co = _mm_add_epi8(co, co);
+            cg = _mm_add_epi8(cg, cg);
+        }
+        co = _mm_xor_si128(co, bias);
+        cg = _mm_xor_si128(cg, bias);
+    }
+    
+    HapYCoCgDXT5InsetEndpoints(minColor, maxColor);
+    
+    // SelectYCoCgDiagonal()
+    __m128i mid0 = _mm_set1_epi8((char)(( (int) minColor[0] + maxColor[0] + 1 ) >> 1));
+    __m128i mid1 = _mm_set1_epi8((char)(( (int) minColor[1] + maxColor[1] + 1 ) >> 1));
+    __m128i side = _mm_xor_si128(_mm_cmpeq_epi8(_mm_max_epu8(co, mid0), co), _mm_cmpeq_epi8(_mm_max_epu8(cg, mid1), cg));
+    HapYCoCgDXT5SelectDiagonal(minColor, maxColor, HapYCoCgDXT5CountBits16((unsigned int)_mm_movemask_epi8(side)));
+    
+    // EmitAlphaIndices(): count the thresholds each texel is at or below
+    byte thresholds[7];
+    HapYCoCgDXT5AlphaThresholds(minColor[3], maxColor[3], thresholds);
+    __m128i count = _mm_cmpeq_epi8(_mm_min_epu8(y, _mm_set1_epi8((char)thresholds[0])), y);
+    for (int i = 1; i < 7; i++)
+    {
+        count = _mm_add_epi8(count, _mm_cmpeq_epi8(_mm_min_epu8(y, _mm_set1_epi8((char)thresholds[i])), y));
+    }
+    __m128i index = _mm_and_si128(_mm_sub_epi8(one, count), _mm_set1_epi8(7));
+    index = _mm_xor_si128(index, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(2), index), one));
+    // Pack 3-bit indices: pairs into 6 bits, then 4 texels into 12 bits
+    index = _mm_madd_epi16(_mm_maddubs_epi16(index, _mm_set1_epi16(0x0801)), _mm_set1_epi32(0x00400001));
+    unsigned long long alphaIndices = (unsigned long long)(unsigned int)_mm_cvtsi128_si32(index)
+                                    | ((unsigned long long)(unsigned int)_mm_extract_epi32(index, 1) << 12)
+                                    | ((unsigned long long)(unsigned int)_mm_extract_epi32(index, 2) << 24)
+                                    | ((unsigned long long)(unsigned int)_mm_extract_epi32(index, 3) << 36);
+    
+    HapYCoCgDXT5EmitBlockHeader(minColor, maxColor, alphaIndices, outData);
+    
+    // EmitColorIndices(): distances need 16 bits
+    short palette[8];
+    HapYCoCgDXT5ColorPalette(minColor, maxColor, palette);
+    __m128i indices[2];
+    for (int half = 0; half < 2; half++)
+    {
+        __m128i c0 = half == 0 ? _mm_unpacklo_epi8(co, zero) : _mm_unpackhi_epi8(co, zero);
+        __m128i c1 = half == 0 ? _mm_unpacklo_epi8(cg, zero) : _mm_unpackhi_epi8(cg, zero);
+        __m128i d0 = _mm_add_epi16(_mm_abs_epi16(_mm_sub_epi16(_mm_set1_epi16(palette[0]), c0)), _mm_abs_epi16(_mm_sub_epi16(_mm_set1_epi16(palette[1]), c1)));
+        __m128i d1 = _mm_add_epi16(_mm_abs_epi16(_mm_sub_epi16(_mm_set1_epi16(palette[2]), c0)), _mm_abs_epi16(_mm_sub_epi16(_mm_set1_epi16(palette[3]), c1)));
+        __m128i d2 = _mm_add_epi16(_mm_abs_epi16(_mm_sub_epi16(_mm_set1_epi16(palette[4]), c0)), _mm_abs_epi16(_mm_sub_epi16(_mm_set1_epi16(palette[5]), c1)));
+        __m128i d3 = _mm_add_epi16(_mm_abs_epi16(_mm_sub_epi16(_mm_set1_epi16(palette[6]), c0)), _mm_abs_epi16(_mm_sub_epi16(_mm_set1_epi16(palette[7]), c1)));
+        
+        __m128i b0 = _mm_cmpgt_epi16(d0, d3);
+        __m128i b1 = _mm_cmpgt_epi16(d1, d2);
+        __m128i b2 = _mm_cmpgt_epi16(d0, d2);
+        __m128i b3 = _mm_cmpgt_epi16(d1, d3);
+        __m128i b4 = _mm_cmpgt_epi16(d2, d3);
+        
+        __m128i x0 = _mm_and_si128(b1, b2);
+        __m128i x1 = _mm_and_si128(b0, b3);
+        __m128i x2 = _mm_and_si128(b0, b4);
+        
+        indices[half] = _mm_or_si128(_mm_and_si128(x2, _mm_set1_epi16(1)), _mm_and_si128(_mm_or_si128(x0, x1), _mm_set1_epi16(2)));
+    }
+    // Pack 2-bit indices: pairs into 4 bits, then 4 texels into each byte
+    index = _mm_packs_epi16(indices[0], indices[1]);
+    index = _mm_madd_epi16(_mm_maddubs_epi16(index, _mm_set1_epi16(0x0401)), _mm_set1_epi32(0x00100001));
+    index = _mm_packus_epi16(_mm_packus_epi32(index, zero), zero);
+    unsigned int colorIndices = (unsigned int)_mm_cvtsi128_si32(index);
+    
+    outData[12] = colorIndices & 255;
+    outData[13] = (colorIndices >> 8) & 255;
+    outData[14] = (colorIndices >> 16) & 255;
+    outData[15] = colorIndices >> 24;
+}
+
+void CompressYCoCgDXT5BlocksSSE41(const byte *inBuf, byte *outBuf, int blockCount, int stride, int input)
+{
+    int i;
+    switch (input)
+    {
+        case HapYCoCgDXT5Input_RGBA:
+            for (i = 0; i < blockCount; i++)
+            {
+                HapYCoCgDXT5CompressBlockSSE41<HapYCoCgDXT5Input_RGBA>(inBuf + i * 16, outBuf + i * 16, stride);
+            }
+            break;
+        case HapYCoCgDXT5Input_BGRA:
+            for (i = 0; i < blockCount; i++)
+            {
+                HapYCoCgDXT5CompressBlockSSE41<HapYCoCgDXT5Input_BGRA>(inBuf + i * 16, outBuf + i * 16, stride);
+            }
+            break;
+        default:
+            for (i = 0; i < blockCount; i++)
+            {
+                HapYCoCgDXT5CompressBlockSSE41<HapYCoCgDXT5Input_CoCg_Y>(inBuf + i * 16, outBuf + i * 16, stride);
+            }
+            break;
+    }
+}